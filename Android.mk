@@ -11,6 +11,10 @@ LOCAL_ARM_MODE := arm
 LOCAL_SRC_FILES := \
 		memmgr.c \
 		tilermgr.c \
+		trace.c \
+		record.c \
+		blit.c \
+		rowpool.c \
 
 
 LOCAL_C_INCLUDES += \
@@ -26,7 +30,7 @@ include $(BUILD_SHARED_LIBRARY)
 include $(CLEAR_VARS)
 LOCAL_PRELINK_MODULE := false
 LOCAL_ARM_MODE := arm
-LOCAL_SRC_FILES := memmgr_test.c testlib.c
+LOCAL_SRC_FILES := memmgr_test.c testlib.c fill_utils.c
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH)/ \
 
@@ -50,7 +54,7 @@ include $(BUILD_EXECUTABLE)
 include $(CLEAR_VARS)
 LOCAL_PRELINK_MODULE := false
 LOCAL_ARM_MODE := arm
-LOCAL_SRC_FILES := tiler_ptest.c
+LOCAL_SRC_FILES := tiler_ptest.c fill_utils.c
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH)/ \
 
@@ -59,4 +63,39 @@ LOCAL_MODULE    := tiler_ptest
 LOCAL_MODULE_TAGS := optional tests
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+LOCAL_PRELINK_MODULE := false
+LOCAL_ARM_MODE := arm
+LOCAL_SRC_FILES := memmgr_bench.c benchlib.c
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/ \
+
+LOCAL_SHARED_LIBRARIES := libtimemmgr
+LOCAL_MODULE    := memmgr_bench
+LOCAL_MODULE_TAGS := optional tests
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PRELINK_MODULE := false
+LOCAL_ARM_MODE := arm
+LOCAL_SRC_FILES := memmgr_replay.c benchlib.c
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/ \
+
+LOCAL_SHARED_LIBRARIES := libtimemmgr
+LOCAL_MODULE    := memmgr_replay
+LOCAL_MODULE_TAGS := optional tests
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PRELINK_MODULE := false
+LOCAL_ARM_MODE := arm
+LOCAL_SRC_FILES := tiler_sim.c benchlib.c
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/ \
+
+LOCAL_MODULE    := tiler_sim
+LOCAL_MODULE_TAGS := optional tests
+include $(BUILD_EXECUTABLE)
+
 endif
@@ -0,0 +1,170 @@
+# Use this script to compare MemMgr benchmark results against a baseline and
+# to catch performance regressions.  You can use either Python 2.6 or 3.1
+#
+# Benchmark results are the JSON reports written by memmgr_bench,
+# memmgr_replay or tiler_sim with the -o option.  Benchmarks are noisy, so
+# run them several times on both the baseline and the new build, e.g.
+#
+#     for i in 1 2 3 4 5; do memmgr_bench -o base$i.json; done
+#     ... install the new build ...
+#     for i in 1 2 3 4 5; do memmgr_bench -o new$i.json; done
+#
+# Usage:
+#     python bench_compare.py [options] -b base1.json -b base2.json ...
+#                             new1.json new2.json ...
+#
+# Options:
+#     -b <file>        baseline report (can be repeated)
+#     -t <percent>     throughput regression threshold (default: 5)
+#     -l <percent>     latency regression threshold (default: 10)
+#     -f md|csv        output format (default: md)
+#     -a               list all cases, not only the changed ones
+#
+# Each case (suite, case name and thread count) is summarized by the median
+# of its runs, and a 95% confidence interval of the median from the order
+# statistics of the runs (the full range if there are less than 6 runs).  A
+# metric regresses if its median is worse than the baseline median by more
+# than the threshold, and the confidence intervals do not overlap.
+#
+# The exit status is 1 if there were regressions, 0 otherwise.
+
+import sys, json, getopt
+
+# metric, display name, TRUE if higher is better
+METRICS = [('ops_per_sec', 'ops/s', True),
+           ('p50_ns', 'p50', False),
+           ('p99_ns', 'p99', False),
+           ('p999_ns', 'p999', False)]
+
+def usage():
+    print('usage: python bench_compare.py [-t percent] [-l percent] '
+          '[-f md|csv] [-a] -b baseline.json... new.json...')
+    sys.exit(2)
+
+def read_runs(paths):
+    """Returns the values of each metric of each case over a set of runs."""
+    cases = {}
+    for path in paths:
+        try:
+            report = json.load(open(path))
+        except (IOError, ValueError):
+            print('%s is not a benchmark report' % path)
+            sys.exit(2)
+        for r in report.get('results', []):
+            key = (r['suite'], r['case'], r['threads'])
+            vals = cases.setdefault(key, {})
+            for m, name, higher in METRICS:
+                if m in r:
+                    vals.setdefault(m, []).append(float(r[m]))
+    return cases
+
+def binom_cdf(k, n):
+    """Returns P(X <= k) for X ~ Binomial(n, 1/2)."""
+    c, total = 1, 0
+    for i in range(k + 1):
+        total += c
+        c = c * (n - i) // (i + 1)
+    return float(total) / 2 ** n
+
+def summarize(vals):
+    """Returns the median and the 95% confidence interval of the median."""
+    vals = sorted(vals)
+    n = len(vals)
+    median = (vals[(n - 1) // 2] + vals[n // 2]) / 2.0
+    # [vals[j], vals[n - 1 - j]] covers the median with 1 - 2 * P(X <= j)
+    j = 0
+    while j + 1 < (n + 1) // 2 and 1 - 2 * binom_cdf(j + 1, n) >= 0.95:
+        j += 1
+    return median, vals[j], vals[n - 1 - j]
+
+def compare(base, new, tput_pct, lat_pct):
+    """Compares the cases of two sets of runs.  Returns a list of
+    (key, metric, base summary, new summary, change %, status) rows."""
+    rows = []
+    for key in sorted(set(base) | set(new)):
+        for m, name, higher in METRICS:
+            b, n = base.get(key, {}).get(m), new.get(key, {}).get(m)
+            if not b or not n:
+                if b or n:
+                    rows.append((key, name, b and summarize(b),
+                                 n and summarize(n), None,
+                                 b and 'missing' or 'new'))
+                continue
+            bs, ns = summarize(b), summarize(n)
+            change = bs[0] and 100.0 * (ns[0] - bs[0]) / bs[0] or 0.0
+            worse = higher and -change or change
+            limit = higher and tput_pct or lat_pct
+            overlap = ns[1] <= bs[2] and bs[1] <= ns[2]
+            if abs(change) <= limit or overlap:
+                status = abs(change) > limit and 'noise' or 'ok'
+            else:
+                status = worse > 0 and 'REGRESSION' or 'improved'
+            rows.append((key, name, bs, ns, change, status))
+    return rows
+
+def fmt_val(s):
+    if not s:
+        return '-'
+    median, lo, hi = s
+    if lo == hi:
+        return '%.6g' % median
+    return '%.6g [%.6g, %.6g]' % (median, lo, hi)
+
+def print_rows(rows, fmt, show_all):
+    header = ['suite', 'case', 'threads', 'metric', 'baseline', 'new',
+              'change', 'status']
+    if fmt == 'csv':
+        print(','.join(header + ['base_lo', 'base_hi', 'new_lo', 'new_hi']))
+    else:
+        print('| ' + ' | '.join(header) + ' |')
+        print('|' + '---|' * len(header))
+    for key, name, bs, ns, change, status in rows:
+        if not show_all and status in ('ok', 'noise'):
+            continue
+        suite, case, threads = key
+        ch = change is not None and '%+.1f%%' % change or '-'
+        if fmt == 'csv':
+            cols = [suite, case, str(threads), name,
+                    bs and '%.6g' % bs[0] or '', ns and '%.6g' % ns[0] or '',
+                    change is not None and '%.2f' % change or '', status]
+            for s in (bs, ns):
+                cols += s and ['%.6g' % s[1], '%.6g' % s[2]] or ['', '']
+            print(','.join(['"%s"' % c if ',' in c else c for c in cols]))
+        else:
+            print('| %s | %s | %s | %s | %s | %s | %s | %s |' %
+                  (suite, case, threads, name, fmt_val(bs), fmt_val(ns), ch,
+                   status == 'REGRESSION' and '**REGRESSION**' or status))
+
+try:
+    opts, files = getopt.getopt(sys.argv[1:], 'b:t:l:f:a')
+except getopt.GetoptError:
+    usage()
+
+baselines, tput_pct, lat_pct, fmt, show_all = [], 5.0, 10.0, 'md', False
+for opt, val in opts:
+    if opt == '-b':
+        baselines.append(val)
+    elif opt == '-t':
+        tput_pct = float(val)
+    elif opt == '-l':
+        lat_pct = float(val)
+    elif opt == '-f':
+        if val not in ('md', 'csv'):
+            usage()
+        fmt = val
+    elif opt == '-a':
+        show_all = True
+if not baselines or not files:
+    usage()
+
+base, new = read_runs(baselines), read_runs(files)
+rows = compare(base, new, tput_pct, lat_pct)
+print_rows(rows, fmt, show_all)
+
+regressions = len([r for r in rows if r[5] == 'REGRESSION'])
+if fmt == 'md':
+    print('\n%d cases compared (%d baseline, %d new runs): %d regressions, '
+          '%d improvements' % (len(set(base) | set(new)), len(baselines),
+                               len(files), regressions,
+                               len([r for r in rows if r[5] == 'improved'])))
+sys.exit(regressions and 1 or 0)
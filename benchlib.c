@@ -0,0 +1,276 @@
+/*
+ *  benchlib.c
+ *
+ *  Benchmark library.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "benchlib.h"
+
+#include <utils.h>
+#include <debug_utils.h>
+
+static uint32_t iterations = 0;        /* 0: use case default */
+static BenchLib_Result *results = NULL;
+static int num_results = 0, max_results = 0;
+
+uint64_t BenchLib_Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint32_t BenchLib_Iterations(uint32_t def)
+{
+    return iterations ? iterations : def;
+}
+
+int BenchLib_InitSamples(BenchLib_Samples *s, uint32_t max)
+{
+    s->num = 0;
+    s->max = max;
+    ALLOCN(s->ns, max ? max : 1);
+    return s->ns == NULL;
+}
+
+void BenchLib_FreeSamples(BenchLib_Samples *s)
+{
+    FREE(s->ns);
+    s->num = s->max = 0;
+}
+
+int BenchLib_MergeSamples(BenchLib_Samples *dst, BenchLib_Samples *src)
+{
+    if (dst->num + src->num > dst->max)
+    {
+        uint64_t *ns = realloc(dst->ns, sizeof(*ns) * (dst->num + src->num));
+        if (!ns) return 1;
+        dst->ns = ns;
+        dst->max = dst->num + src->num;
+    }
+    memcpy(dst->ns + dst->num, src->ns, sizeof(*src->ns) * src->num);
+    dst->num += src->num;
+    return 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Returns a percentile of sorted samples using the nearest-rank
+ * method.
+ *
+ * @param s      Pointer to the sorted samples
+ * @param perm   Percentile in 1/1000-s
+ *
+ * @return the percentile, or 0 if there are no samples
+ */
+static uint64_t percentile(BenchLib_Samples *s, uint32_t perm)
+{
+    uint64_t rank = ((uint64_t) s->num * perm + 999) / 1000;
+    if (!s->num) return 0;
+    return s->ns[rank ? rank - 1 : 0];
+}
+
+BenchLib_Result *BenchLib_Report(const char *suite, const char *name,
+                                 int threads, BenchLib_Samples *s,
+                                 uint64_t elapsed_ns)
+{
+    if (num_results == max_results)
+    {
+        BenchLib_Result *r = realloc(results, sizeof(*r) * (max_results + 64));
+        if (!r) return NULL;
+        results = r;
+        max_results += 64;
+    }
+
+    BenchLib_Result *res = results + num_results++;
+    ZERO(*res);
+    res->suite = suite;
+    strncpy(res->name, name, sizeof(res->name) - 1);
+    res->threads = threads;
+    res->ops = s->num;
+    res->elapsed_ns = elapsed_ns;
+    res->ops_per_sec = elapsed_ns ? s->num * 1e9 / elapsed_ns : 0;
+
+    qsort(s->ns, s->num, sizeof(*s->ns), cmp_u64);
+    res->min_ns = s->num ? s->ns[0] : 0;
+    res->p50_ns = percentile(s, 500);
+    res->p99_ns = percentile(s, 990);
+    res->p999_ns = percentile(s, 999);
+    res->max_ns = s->num ? s->ns[s->num - 1] : 0;
+
+    printf("%-8s %-28s %2dT %7u ops %10.0f ops/s  p50 %8llu  p99 %8llu  "
+           "p999 %8llu  max %8llu ns\n", suite, res->name, threads, res->ops,
+           res->ops_per_sec, (unsigned long long) res->p50_ns,
+           (unsigned long long) res->p99_ns, (unsigned long long) res->p999_ns,
+           (unsigned long long) res->max_ns);
+    fflush(stdout);
+    return res;
+}
+
+void BenchLib_AddMetric(BenchLib_Result *res, const char *key, double val)
+{
+    printf("%-8s %-28s     %s: %.0f\n", res ? res->suite : "", "", key, val);
+    fflush(stdout);
+    if (res && res->num_metrics < BENCHLIB_MAX_METRICS)
+    {
+        res->metric_key[res->num_metrics] = key;
+        res->metric_val[res->num_metrics++] = val;
+    }
+}
+
+int BenchLib_WriteReport(const char *path, const char *prog,
+                         const char *backend)
+{
+    int ix, m;
+    const char *base = strrchr(prog, '/');
+    FILE *fp = strcmp(path, "-") ? fopen(path, "w") : stdout;
+
+    if (!fp)
+    {
+        fprintf(stderr, "could not open %s\n", path);
+        return 1;
+    }
+
+    fprintf(fp, "{\n  \"benchmark\": \"%s\",\n  \"backend\": \"%s\",\n"
+            "  \"iterations\": %u,\n  \"results\": [", base ? base + 1 : prog,
+            backend, iterations);
+    for (ix = 0; ix < num_results; ix++)
+    {
+        BenchLib_Result *r = results + ix;
+        fprintf(fp, "%s\n    { \"suite\": \"%s\", \"case\": \"%s\", "
+                "\"threads\": %d, \"ops\": %u, \"elapsed_ns\": %llu, "
+                "\"ops_per_sec\": %.1f, \"min_ns\": %llu, \"p50_ns\": %llu, "
+                "\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu",
+                ix ? "," : "", r->suite, r->name, r->threads, r->ops,
+                (unsigned long long) r->elapsed_ns, r->ops_per_sec,
+                (unsigned long long) r->min_ns, (unsigned long long) r->p50_ns,
+                (unsigned long long) r->p99_ns, (unsigned long long) r->p999_ns,
+                (unsigned long long) r->max_ns);
+        for (m = 0; m < r->num_metrics; m++)
+        {
+            fprintf(fp, ", \"%s\": %.1f", r->metric_key[m], r->metric_val[m]);
+        }
+        fprintf(fp, " }");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    fflush(fp);
+    return fp != stdout && fclose(fp);
+}
+
+int BenchLib_Run(int argc, char **argv, BenchLib_Suite suites[],
+                 const char *backend)
+{
+    const char *json = NULL;
+    int ix, arg, failed = 0, run = 0;
+
+    /* parse options */
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (!strcmp(argv[arg], "-n") && arg + 1 < argc &&
+            atoi(argv[arg + 1]) > 0)
+        {
+            iterations = atoi(argv[++arg]);
+        }
+        else if (!strcmp(argv[arg], "-o") && arg + 1 < argc)
+        {
+            json = argv[++arg];
+        }
+        else break;
+    }
+
+    /* suite list */
+    if (arg + 1 == argc && !strcmp(argv[arg], "list"))
+    {
+        for (ix = 0; suites[ix].name; ix++)
+        {
+            printf("%-8s - %s\n", suites[ix].name, suites[ix].desc);
+        }
+        return -1;
+    }
+
+    /* check suite names */
+    for (ix = arg; ix < argc; ix++)
+    {
+        int s;
+        for (s = 0; suites[s].name && strcmp(suites[s].name, argv[ix]); s++);
+        if (!suites[s].name) break;
+    }
+    if (ix < argc)
+    {
+        fprintf(stderr, "Usage: %s [-n iterations] [-o json_file] [<suites>], where\n"
+          "   -n:      number of iterations for each case\n"
+          "   -o:      write JSON report into file (- for stdout)\n"
+          "   list:    list suites\n"
+          "   empty:   run all suites\n", argv[0]);
+        fflush(stderr);
+        return -1;
+    }
+
+    /* run suites */
+    for (ix = 0; suites[ix].name; ix++)
+    {
+        int a;
+        for (a = arg; a < argc && strcmp(suites[ix].name, argv[a]); a++);
+        if (arg < argc && a == argc) continue;
+
+        printf("SUITE %s - %s\n", suites[ix].name, suites[ix].desc);
+        fflush(stdout);
+        run++;
+        if (suites[ix].fn())
+        {
+            printf("==> SUITE FAIL\n");
+            failed++;
+        }
+        fflush(stdout);
+    }
+    printf("SUITES FAILED: %d, RUN: %d\n", failed, run);
+
+    /* write report */
+    if (json && BenchLib_WriteReport(json, argv[0], backend)) failed++;
+    fflush(stdout);
+
+    FREE(results);
+    num_results = max_results = 0;
+    return failed;
+}
@@ -0,0 +1,192 @@
+/*
+ *  benchlib.h
+ *
+ *  Benchmark library API.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BENCHLIB_H_
+#define _BENCHLIB_H_
+
+#include <stdint.h>
+#include "utils.h"
+
+/* maximum number of extra metrics per result */
+#define BENCHLIB_MAX_METRICS 8
+
+/**
+ * Latency samples of a benchmark case.  Each sample is the
+ * latency of one operation in nanoseconds.
+ */
+struct BenchLib_Samples {
+    uint64_t *ns;       /* sample array */
+    uint32_t  num;      /* number of samples collected */
+    uint32_t  max;      /* size of sample array */
+};
+
+typedef struct BenchLib_Samples BenchLib_Samples;
+
+/**
+ * Summary of a benchmark case.  Latency percentiles use the
+ * nearest-rank method.
+ */
+struct BenchLib_Result {
+    const char *suite;      /* suite name */
+    char        name[64];   /* case name */
+    int         threads;    /* number of threads used */
+    uint32_t    ops;        /* number of operations */
+    uint64_t    elapsed_ns; /* wall clock time of the case */
+    double      ops_per_sec;
+    uint64_t    min_ns, p50_ns, p99_ns, p999_ns, max_ns;
+    int         num_metrics;
+    const char *metric_key[BENCHLIB_MAX_METRICS];
+    double      metric_val[BENCHLIB_MAX_METRICS];
+};
+
+typedef struct BenchLib_Result BenchLib_Result;
+
+/**
+ * Benchmark suite specification.  The suite list passed to
+ * BenchLib_Run() is terminated by an entry with a NULL name.
+ */
+struct BenchLib_Suite {
+    const char *name;       /* suite name used on the command line */
+    const char *desc;       /* suite description */
+    int (*fn)();            /* suite function, returns 0 on success */
+};
+
+typedef struct BenchLib_Suite BenchLib_Suite;
+
+/**
+ * Returns the current monotonic time.
+ *
+ * @return time in nanoseconds
+ */
+uint64_t BenchLib_Now();
+
+/**
+ * Returns the number of iterations to run for a case: the
+ * value given with -n on the command line, or the default.
+ *
+ * @param def   Default number of iterations for the case
+ *
+ * @return number of iterations
+ */
+uint32_t BenchLib_Iterations(uint32_t def);
+
+/**
+ * Allocates a sample array.
+ *
+ * @param s      Pointer to the samples
+ * @param max    Maximum number of samples
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int BenchLib_InitSamples(BenchLib_Samples *s, uint32_t max);
+
+/**
+ * Frees a sample array.
+ *
+ * @param s      Pointer to the samples
+ */
+void BenchLib_FreeSamples(BenchLib_Samples *s);
+
+/* adds a sample if there is room for it */
+#define BenchLib_AddSample(s, val) \
+    S_ { if ((s)->num < (s)->max) (s)->ns[(s)->num++] = (val); } _S
+
+/**
+ * Appends samples to another sample array, e.g. to combine the
+ * samples of worker threads.
+ *
+ * @param dst    Pointer to the destination samples
+ * @param src    Pointer to the samples to append
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int BenchLib_MergeSamples(BenchLib_Samples *dst, BenchLib_Samples *src);
+
+/**
+ * Summarizes a benchmark case, prints the summary and records it
+ * for the JSON report.  The samples are sorted as a side effect.
+ *
+ * @param suite      Suite name (must be a literal)
+ * @param name       Case name
+ * @param threads    Number of threads used
+ * @param s          Pointer to the samples
+ * @param elapsed_ns Wall clock time of the case
+ *
+ * @return pointer to the recorded result, or NULL on memory
+ *         allocation failure.
+ */
+BenchLib_Result *BenchLib_Report(const char *suite, const char *name,
+                                 int threads, BenchLib_Samples *s,
+                                 uint64_t elapsed_ns);
+
+/**
+ * Adds an extra metric to a result, and prints it.
+ *
+ * @param res    Pointer to the result (may be NULL)
+ * @param key    Metric name (must be a literal)
+ * @param val    Metric value
+ */
+void BenchLib_AddMetric(BenchLib_Result *res, const char *key, double val);
+
+/**
+ * Writes the recorded results into a JSON report.
+ *
+ * @param path      Path to the report, or "-" for stdout
+ * @param prog      Program name (argv[0])
+ * @param backend   Backend name recorded in the report
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int BenchLib_WriteReport(const char *path, const char *prog,
+                         const char *backend);
+
+/**
+ * Parses argument list, prints usage on error, lists suites,
+ * runs the selected suites and writes the JSON report.
+ * <p>
+ * Usage: prog [-n iterations] [-o json_file] [list | suite...]
+ *
+ * @param argc      Number of arguments
+ * @param argv      Argument array
+ * @param suites    Suite list
+ * @param backend   Backend name recorded in the report
+ *
+ * @return # of suites failed, 0 on success, -1 if no suites
+ *         were run because of an error or a list request.
+ */
+int BenchLib_Run(int argc, char **argv, BenchLib_Suite suites[],
+                 const char *backend);
+
+#endif
@@ -0,0 +1,293 @@
+/*
+ *  blit.c
+ *
+ *  Stride-aware 2D copy and fill kernels used by the Memory Allocator.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "utils.h"
+#include "blit.h"
+#include "rowpool.h"
+
+#define BLIT_MAX_THREADS 4
+#define BLIT_PAR_MIN     (2 << 20)    /* min. region size to split */
+#define BLIT_PAR_PART    (512 << 10)  /* min. bytes per thread */
+#define BLIT_ROW         (64 << 10)   /* row size for contiguous regions */
+
+/**
+ * Copies a row.
+ *
+ * @param d       Destination
+ * @param s       Source
+ * @param n       Number of bytes
+ * @param stream  Use streaming stores
+ */
+static void copy_row(uint8_t *d, const uint8_t *s, bytes_t n, int stream)
+{
+#if defined(__SSE2__)
+    if (stream && n >= 64)
+    {
+        /* streaming stores must be 16-byte aligned */
+        bytes_t head = (16 - ((uintptr_t) d & 15)) & 15;
+        memcpy(d, s, head);
+        d += head;
+        s += head;
+        n -= head;
+        for (; n >= 64; n -= 64, d += 64, s += 64)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *) s);
+            __m128i b = _mm_loadu_si128((const __m128i *) (s + 16));
+            __m128i c = _mm_loadu_si128((const __m128i *) (s + 32));
+            __m128i e = _mm_loadu_si128((const __m128i *) (s + 48));
+            _mm_stream_si128((__m128i *) d, a);
+            _mm_stream_si128((__m128i *) (d + 16), b);
+            _mm_stream_si128((__m128i *) (d + 32), c);
+            _mm_stream_si128((__m128i *) (d + 48), e);
+        }
+    }
+#elif defined(__ARM_NEON__)
+    if (stream && n >= 64)
+    {
+        /* write whole 64-byte bursts */
+        bytes_t head = (16 - ((uintptr_t) d & 15)) & 15;
+        memcpy(d, s, head);
+        d += head;
+        s += head;
+        n -= head;
+        for (; n >= 64; n -= 64, d += 64, s += 64)
+        {
+            uint8x16_t a = vld1q_u8(s);
+            uint8x16_t b = vld1q_u8(s + 16);
+            uint8x16_t c = vld1q_u8(s + 32);
+            uint8x16_t e = vld1q_u8(s + 48);
+            vst1q_u8(d, a);
+            vst1q_u8(d + 16, b);
+            vst1q_u8(d + 32, c);
+            vst1q_u8(d + 48, e);
+        }
+    }
+#endif
+    memcpy(d, s, n);
+}
+
+/**
+ * Fills a row with a repeated 4-byte pattern.
+ *
+ * @param d       Destination
+ * @param pat     Pattern bytes repeated 5 times, so that pat + i
+ *                is the pattern at offset i in the row
+ * @param n       Number of bytes
+ * @param stream  Use streaming stores
+ */
+static void fill_row(uint8_t *d, const uint8_t *pat, bytes_t n, int stream)
+{
+    bytes_t k = 0, head = (16 - ((uintptr_t) d & 15)) & 15;
+    if (head > n) head = n;
+    for (; k < head; k++) d[k] = pat[k & 3];
+
+#if defined(__SSE2__)
+    __m128i v = _mm_loadu_si128((const __m128i *) (pat + (k & 3)));
+    for (; stream && k + 64 <= n; k += 64)
+    {
+        _mm_stream_si128((__m128i *) (d + k), v);
+        _mm_stream_si128((__m128i *) (d + k + 16), v);
+        _mm_stream_si128((__m128i *) (d + k + 32), v);
+        _mm_stream_si128((__m128i *) (d + k + 48), v);
+    }
+    for (; k + 64 <= n; k += 64)
+    {
+        _mm_store_si128((__m128i *) (d + k), v);
+        _mm_store_si128((__m128i *) (d + k + 16), v);
+        _mm_store_si128((__m128i *) (d + k + 32), v);
+        _mm_store_si128((__m128i *) (d + k + 48), v);
+    }
+    for (; k + 16 <= n; k += 16) _mm_store_si128((__m128i *) (d + k), v);
+#elif defined(__ARM_NEON__)
+    uint8x16_t v = vld1q_u8(pat + (k & 3));
+    for (; k + 64 <= n; k += 64)
+    {
+        vst1q_u8(d + k, v);
+        vst1q_u8(d + k + 16, v);
+        vst1q_u8(d + k + 32, v);
+        vst1q_u8(d + k + 48, v);
+    }
+    for (; k + 16 <= n; k += 16) vst1q_u8(d + k, v);
+#else
+    if (pat[0] == pat[1] && pat[0] == pat[2] && pat[0] == pat[3])
+    {
+        memset(d + k, pat[0], n - k);
+        return;
+    }
+    uint32_t w;
+    memcpy(&w, pat + (k & 3), sizeof(w));
+    for (; k + 4 <= n; k += 4) *(uint32_t *) (d + k) = w;
+#endif
+    for (; k < n; k++) d[k] = pat[k & 3];
+}
+
+/* copy or fill job */
+struct blit_job {
+    uint8_t *dst;
+    const uint8_t *src;         /* NULL for fills */
+    bytes_t dst_stride, src_stride, width;
+    uint8_t pat[20];            /* fill pattern, repeated */
+    int stream;
+};
+
+/* copies or fills rows [r0, r1) of a job */
+static void copy_rows(struct blit_job *job, bytes_t r0, bytes_t r1)
+{
+    bytes_t r;
+    for (r = r0; r < r1; r++)
+    {
+        if (job->src)
+            copy_row(job->dst + r * job->dst_stride,
+                     job->src + r * job->src_stride, job->width, job->stream);
+        else
+            fill_row(job->dst + r * job->dst_stride, job->pat, job->width,
+                     job->stream);
+    }
+#if defined(__SSE2__)
+    /* make the streaming stores of this thread visible */
+    if (job->stream) _mm_sfence();
+#endif
+}
+
+/* copies or fills the rows of a part of a job */
+static void copy_part(void *arg, int part, bytes_t r0, bytes_t r1)
+{
+    (void) part;
+    copy_rows((struct blit_job *) arg, r0, r1);
+}
+
+/**
+ * Returns the number of threads to split large regions among.
+ * Copies run on the calling thread only, unless
+ * MEMMGR_COPY_THREADS is set (at most BLIT_MAX_THREADS).
+ */
+static int copy_threads()
+{
+    static int threads = 0;
+    if (!threads)
+    {
+        const char *env = getenv("MEMMGR_COPY_THREADS");
+        long n = env ? atol(env) : 1;
+        threads = n < 1 ? 1 : n > BLIT_MAX_THREADS ? BLIT_MAX_THREADS : n;
+    }
+    return threads;
+}
+
+/**
+ * Copies or fills the rows of a job, splitting the rows of large
+ * regions among the threads of the row pool.
+ *
+ * @param job      Pointer to the job
+ * @param height   Number of rows
+ * @param tail     Width of an extra last row (0 if none)
+ */
+static void run(struct blit_job *job, bytes_t height, bytes_t tail)
+{
+    int parts = job->width * height / BLIT_PAR_PART;
+
+    if (job->width * height < BLIT_PAR_MIN) parts = 1;
+    if (parts > copy_threads()) parts = copy_threads();
+    RowPool_Run(copy_part, job, height, parts);
+
+    /* remainder of a contiguous region */
+    if (tail)
+    {
+        job->width = tail;
+        copy_rows(job, height, height + 1);
+    }
+}
+
+void Blit_Copy2D(void *dst, bytes_t dst_stride, const void *src,
+                 bytes_t src_stride, bytes_t width, bytes_t height,
+                 int stream)
+{
+    struct blit_job job;
+    bytes_t tail = 0;
+
+    /* copy contiguous regions in BLIT_ROW sized rows */
+    if (height == 1 || (width == dst_stride && width == src_stride))
+    {
+        tail = width * height;
+        width = dst_stride = src_stride = BLIT_ROW;
+        height = tail / BLIT_ROW;
+        tail %= BLIT_ROW;
+    }
+    job.dst = dst;
+    job.src = src;
+    job.dst_stride = dst_stride;
+    job.src_stride = src_stride;
+    job.width = width;
+    job.stream = stream;
+    run(&job, height, tail);
+}
+
+void Blit_Fill2D(void *dst, bytes_t dst_stride, uint32_t pattern,
+                 bytes_t width, bytes_t height, int stream)
+{
+    struct blit_job job;
+    bytes_t tail = 0;
+    int ix;
+
+    /* fill contiguous regions in BLIT_ROW sized rows, if that keeps
+       the pattern aligned to the row starts */
+    if (height == 1 || (width == dst_stride && !(width & 3)))
+    {
+        tail = width * height;
+        width = dst_stride = BLIT_ROW;
+        height = tail / BLIT_ROW;
+        tail %= BLIT_ROW;
+    }
+    job.dst = dst;
+    job.src = NULL;
+    job.dst_stride = dst_stride;
+    job.src_stride = 0;
+    job.width = width;
+    job.stream = stream;
+    for (ix = 0; ix < sizeof(job.pat); ix += sizeof(pattern))
+    {
+        memcpy(job.pat + ix, &pattern, sizeof(pattern));
+    }
+    run(&job, height, tail);
+}
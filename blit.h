@@ -0,0 +1,84 @@
+/*
+ *  blit.h
+ *
+ *  Stride-aware 2D copy and fill kernels used by the Memory Allocator.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _BLIT_H_
+#define _BLIT_H_
+
+#include "mem_types.h"
+
+/**
+ * Copies a 2D region between two buffers row by row.  Rows are
+ * copied 64 bytes at a time using SSE2 or NEON if available.
+ * <p>
+ * If stream is set, the copy uses non-temporal stores on SSE2,
+ * and 16-byte aligned 64-byte bursts on NEON.  This avoids
+ * reading the destination into the cache, and fills whole write
+ * combining buffers, which is much faster for the non-cacheable
+ * 2D tiler mappings.
+ * <p>
+ * The copy runs on the calling thread, unless MEMMGR_COPY_THREADS
+ * is set (at most 4), in which case the rows of large regions
+ * (2MB or more) are split among that many threads of the row
+ * pool.
+ *
+ * @param dst          Pointer to the first destination row
+ * @param dst_stride   Destination stride in bytes
+ * @param src          Pointer to the first source row
+ * @param src_stride   Source stride in bytes
+ * @param width        Row width in bytes
+ * @param height       Number of rows
+ * @param stream       Use streaming stores
+ */
+void Blit_Copy2D(void *dst, bytes_t dst_stride, const void *src,
+                 bytes_t src_stride, bytes_t width, bytes_t height,
+                 int stream);
+
+/**
+ * Fills a 2D region with a 32-bit pattern, skipping the stride
+ * padding.  Each row is filled as if the pattern were stored at
+ * every 4 bytes from the start of the row, so the last pattern
+ * of a row may be partial.  Stores are done as by Blit_Copy2D.
+ *
+ * @param dst          Pointer to the first row
+ * @param dst_stride   Stride in bytes
+ * @param pattern      Pattern (in native byte order)
+ * @param width        Row width in bytes
+ * @param height       Number of rows
+ * @param stream       Use streaming stores
+ */
+void Blit_Fill2D(void *dst, bytes_t dst_stride, uint32_t pattern,
+                 bytes_t width, bytes_t height, int stream);
+
+#endif
@@ -40,6 +40,14 @@
 /*#define __DEBUG_ENTRY__*/
 /*#define __DEBUG_ASSERT__*/
 
+/* __DEBUG_TRACE__ supersedes __DEBUG__ and __DEBUG_ENTRY__: trace points are
+   compiled in, and are enabled and disabled at runtime (see trace_utils.h) */
+/*#define __DEBUG_TRACE__*/
+
+#ifdef __DEBUG_TRACE__
+#include "trace_utils.h"
+#endif
+
 /* ---------- Generic Debug Print Macros ---------- */
 
 /**
@@ -49,15 +57,23 @@
  *    DP("val is %d", 15);
  *    ==> val is 5 at test.c:56:main()
  */
-/* debug print (fmt must be a literal); adds new-line. */
-#ifdef __DEBUG__
-#define P(fmt, ...) S_ { fprintf(stdout, fmt "\n", ##__VA_ARGS__); fflush(stdout); } _S
+/* trace point of a category (fmt must be a literal); adds new-line. */
+#if defined(__DEBUG_TRACE__)
+#define TP(cat, fmt, ...) S_ { if (TRACE_ON(cat)) __internal__Trace_Log(cat, fmt, ##__VA_ARGS__); } _S
+#elif defined(__DEBUG__)
+#define TP(cat, fmt, ...) S_ { fprintf(stdout, fmt "\n", ##__VA_ARGS__); fflush(stdout); } _S
 #else
-#define P(fmt, ...)
+#define TP(cat, fmt, ...)
 #endif
 
+/* trace point with context information (fmt must be a literal) */
+#define TDP(cat, fmt, ...) TP(cat, fmt " at %s(" __FILE__ ":%d)", ##__VA_ARGS__, __FUNCTION__, __LINE__)
+
+/* debug print (fmt must be a literal); adds new-line. */
+#define P(fmt, ...) TP(TRACE_PRINT, fmt, ##__VA_ARGS__)
+
 /* debug print with context information (fmt must be a literal) */
-#define DP(fmt, ...) P(fmt " at %s(" __FILE__ ":%d)", ##__VA_ARGS__, __FUNCTION__, __LINE__)
+#define DP(fmt, ...) TDP(TRACE_PRINT, fmt, ##__VA_ARGS__)
 
 /* ---------- Program Flow Debug Macros ---------- */
 
@@ -89,15 +105,15 @@
  *    out main(test.c:14)
  */
 
-#ifdef __DEBUG_ENTRY__
+#if defined(__DEBUG_ENTRY__) || defined(__DEBUG_TRACE__)
 /* function entry */
-#define IN P("in %s(" __FILE__ ":%d)", __FUNCTION__, __LINE__)
+#define IN TP(TRACE_FLOW, "in %s(" __FILE__ ":%d)", __FUNCTION__, __LINE__)
 /* function exit */
-#define OUT P("out %s(" __FILE__ ":%d)", __FUNCTION__, __LINE__)
+#define OUT TP(TRACE_FLOW, "out %s(" __FILE__ ":%d)", __FUNCTION__, __LINE__)
 /* function abort (return;)  Use as { RET; return; } */
-#define RET DP("out() ")
+#define RET TDP(TRACE_FLOW, "out() ")
 /* generic function return */
-#define R(val,type,fmt) E_ { type __val__ = (type) val; DP("out(" fmt ")", __val__); __val__; } _E
+#define R(val,type,fmt) E_ { type __val__ = (type) val; TDP(TRACE_FLOW, "out(" fmt ")", __val__); __val__; } _E
 #else
 #define IN
 #define OUT
@@ -131,12 +147,12 @@
 #ifdef __DEBUG_ASSERT__
 #define A(exp,cmp,val,type,fmt) E_ { \
     type __exp__ = (type) (exp); type __val__ = (type) (val); \
-    if (!(__exp__ cmp __val__)) DP("assert: %s (=" fmt ") !" #cmp " " fmt, #exp, __exp__, __val__); \
+    if (!(__exp__ cmp __val__)) TDP(TRACE_ASSERT, "assert: %s (=" fmt ") !" #cmp " " fmt, #exp, __exp__, __val__); \
     __exp__; \
 } _E
 #define CHK(exp,cmp,val,type,fmt) S_ { \
     type __exp__ = (type) (exp); type __val__ = (type) (val); \
-    if (!(__exp__ cmp __val__)) DP("assert: %s (=" fmt ") !" #cmp " " fmt, #exp, __exp__, __val__); \
+    if (!(__exp__ cmp __val__)) TDP(TRACE_ASSERT, "assert: %s (=" fmt ") !" #cmp " " fmt, #exp, __exp__, __val__); \
 } _S
 #else
 #define A(exp,cmp,val,type,fmt) (exp)
@@ -155,7 +171,7 @@
 #ifdef __DEBUG_ASSERT__
 #define NOT(exp,cmp,val,type,fmt) E_ { \
     type __exp__ = (type) (exp); type __val__ = (type) (val); \
-    if (!(__exp__ cmp __val__)) DP("assert: %s (=" fmt ") !" #cmp " " fmt, #exp, __exp__, __val__); \
+    if (!(__exp__ cmp __val__)) TDP(TRACE_ASSERT, "assert: %s (=" fmt ") !" #cmp " " fmt, #exp, __exp__, __val__); \
     !(__exp__ cmp __val__); \
 } _E
 #else
@@ -0,0 +1,350 @@
+/*
+ *  fill_utils.c
+ *
+ *  Fill pattern utility functions for the MemMgr tests.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "utils.h"
+#include "fill_utils.h"
+#include "rowpool.h"
+
+/* hash constants */
+#define FILL_C1      0x7FEB352D
+#define FILL_C2      0x846CA68B
+#define FILL_GOLDEN  0x9E3779B9
+
+/* parallel fill/verify */
+#define FILL_MAX_THREADS   8
+#define FILL_PAR_MIN       (1 << 20)    /* min. buffer size to split */
+#define FILL_PAR_PART      (256 << 10)  /* min. bytes per thread */
+#define FILL_1D_ROW        4096         /* row size for splitting 1D buffers */
+
+/* invertible 32-bit hash */
+static __inline__ uint32_t mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= FILL_C1;
+    x ^= x >> 15;
+    x *= FILL_C2;
+    x ^= x >> 16;
+    return x;
+}
+
+#if defined(__SSE2__)
+/* SSE2 has no 32-bit lane multiply, so combine two 32x32->64 ones */
+static __inline__ __m128i mullo(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/* mixes 4 words */
+static __inline__ __m128i mix4(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+    x = mullo(x, _mm_set1_epi32(FILL_C1));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+    x = mullo(x, _mm_set1_epi32(FILL_C2));
+    return _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+}
+#elif defined(__ARM_NEON__)
+/* mixes 4 words */
+static __inline__ uint32x4_t mix4(uint32x4_t x)
+{
+    x = veorq_u32(x, vshrq_n_u32(x, 16));
+    x = vmulq_u32(x, vdupq_n_u32(FILL_C1));
+    x = veorq_u32(x, vshrq_n_u32(x, 15));
+    x = vmulq_u32(x, vdupq_n_u32(FILL_C2));
+    return veorq_u32(x, vshrq_n_u32(x, 16));
+}
+#endif
+
+/**
+ * Fills or verifies words of a row.
+ *
+ * @param p      Pointer to the first word (32-bit aligned)
+ * @param idx    Index of the first word within the buffer
+ * @param n      Number of words
+ * @param mul    Pattern multiplier
+ * @param add    Pattern addend
+ * @param check  TRUE to verify, FALSE to fill
+ *
+ * @return number of leading words that match (n if all)
+ */
+static uint32_t do_row(uint32_t *p, uint32_t idx, uint32_t n, uint32_t mul,
+                       uint32_t add, int check)
+{
+    uint32_t i = 0;
+
+    /* i * mul + add is linear, so only the mix is done per word */
+#if defined(__SSE2__)
+    __m128i lin = _mm_add_epi32(mullo(_mm_add_epi32(_mm_set1_epi32(idx),
+                                                    _mm_set_epi32(3, 2, 1, 0)),
+                                      _mm_set1_epi32(mul)),
+                                _mm_set1_epi32(add));
+    __m128i step = _mm_set1_epi32(mul * 4);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = mix4(lin);
+        if (!check) _mm_storeu_si128((__m128i *) (p + i), x);
+        else if (_mm_movemask_epi8(_mm_cmpeq_epi32(
+                     _mm_loadu_si128((__m128i *) (p + i)), x)) != 0xFFFF) break;
+        lin = _mm_add_epi32(lin, step);
+    }
+#elif defined(__ARM_NEON__)
+    static const uint32_t lanes[4] = { 0, 1, 2, 3 };
+    uint32x4_t lin = vmlaq_u32(vdupq_n_u32(add),
+                               vaddq_u32(vdupq_n_u32(idx), vld1q_u32(lanes)),
+                               vdupq_n_u32(mul));
+    uint32x4_t step = vdupq_n_u32(mul * 4);
+    for (; i + 4 <= n; i += 4)
+    {
+        uint32x4_t x = mix4(lin);
+        if (!check) vst1q_u32(p + i, x);
+        else
+        {
+            uint32x4_t eq = vceqq_u32(vld1q_u32(p + i), x);
+            uint32x2_t m = vand_u32(vget_low_u32(eq), vget_high_u32(eq));
+            if ((vget_lane_u32(m, 0) & vget_lane_u32(m, 1)) != 0xFFFFFFFF) break;
+        }
+        lin = vaddq_u32(lin, step);
+    }
+#endif
+
+    /* remaining words, or the words of a mismatching vector */
+    for (; i < n; i++)
+    {
+        uint32_t v = mix((idx + i) * mul + add);
+        if (!check) p[i] = v;
+        else if (p[i] != v) break;
+    }
+    return i;
+}
+
+/* returns the multiplier and addend of the pattern of a seed */
+static void get_key(uint32_t seed, uint32_t *mul, uint32_t *add)
+{
+    *mul = mix(seed ^ FILL_GOLDEN) | 1;
+    *add = mix(seed + FILL_GOLDEN);
+}
+
+/**
+ * Fills or verifies a range of rows of a buffer.
+ *
+ * @param r0     First row
+ * @param r1     Row after the last row
+ *
+ * @return 0 if all rows match, non-0 otherwise
+ */
+static int do_rows(uint32_t mul, uint32_t add, void *ptr, bytes_t width,
+                   bytes_t r0, bytes_t r1, bytes_t stride, bytes_t *row,
+                   bytes_t *col, int check)
+{
+    uint32_t r, n, i, idx, v;
+    int bad;
+
+    for (r = r0; r < r1; r++)
+    {
+        uint8_t *p = (uint8_t *) ptr + r * stride;
+        idx = r * ((stride + 3) >> 2);
+        n = width >> 2;
+
+        if (!((uintptr_t) p & 3))
+        {
+            i = do_row((uint32_t *) p, idx, n, mul, add, check);
+        }
+        else
+        {
+            /* unaligned rows are rare, do them by word */
+            for (i = 0; i < n; i++)
+            {
+                uint32_t w;
+                v = mix((idx + i) * mul + add);
+                if (!check) memcpy(p + i * 4, &v, 4);
+                else if (memcpy(&w, p + i * 4, 4), w != v) break;
+            }
+        }
+
+        /* partial last word */
+        bad = i != n;
+        if (!bad && (width & 3))
+        {
+            v = mix((idx + n) * mul + add);
+            if (!check) memcpy(p + n * 4, &v, width & 3);
+            else bad = memcmp(p + n * 4, &v, width & 3) != 0;
+        }
+        if (check && bad)
+        {
+            *row = r;
+            *col = i * 4;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* a range of rows processed by one thread */
+struct fill_part {
+    int res;            /* result */
+    bytes_t row, col;   /* first mismatch */
+};
+
+/* fill or check job */
+struct fill_job {
+    uint32_t mul, add;
+    void *ptr;
+    bytes_t width, stride;
+    int check;
+    struct fill_part parts[ROWPOOL_MAX_THREADS];
+};
+
+/* fills or verifies the rows of a part of a job */
+static void fill_part(void *arg, int part, bytes_t r0, bytes_t r1)
+{
+    struct fill_job *job = (struct fill_job *) arg;
+    struct fill_part *p = job->parts + part;
+    p->res = do_rows(job->mul, job->add, job->ptr, job->width, r0, r1,
+                     job->stride, &p->row, &p->col, job->check);
+}
+
+/**
+ * Returns the number of threads to split large buffers among: the
+ * number of online CPUs (at most FILL_MAX_THREADS), or
+ * MEMMGR_FILL_THREADS if set.
+ */
+static int fill_threads()
+{
+    static int threads = 0;
+    if (!threads)
+    {
+        const char *env = getenv("MEMMGR_FILL_THREADS");
+        long n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n < 1 ? 1 : n > FILL_MAX_THREADS ? FILL_MAX_THREADS : n;
+    }
+    return threads;
+}
+
+/**
+ * Fills or verifies the rows of a buffer, splitting the rows of
+ * large buffers among the threads of the pool.  If multiple rows
+ * mismatch, the first one is returned regardless of the order in
+ * which the threads finish.
+ *
+ * @return 0 if all rows match, non-0 otherwise
+ */
+static int run(uint32_t seed, void *ptr, bytes_t width, bytes_t height,
+               bytes_t stride, bytes_t *row, bytes_t *col, int check)
+{
+    struct fill_job job;
+    bytes_t r = 0, c = 0, tail = 0, rows_1d = 0;
+    int i, res = 0, parts;
+    get_key(seed, &job.mul, &job.add);
+
+    /* split contiguous 1D buffers into rows; the words keep their index */
+    if (height == 1 && width == stride && !(width & 3) && width >= FILL_PAR_MIN)
+    {
+        rows_1d = width / FILL_1D_ROW;
+        tail = width % FILL_1D_ROW;
+        width = stride = FILL_1D_ROW;
+        height = rows_1d;
+    }
+
+    job.ptr = ptr;
+    job.width = width;
+    job.stride = stride;
+    job.check = check;
+    parts = width * height / FILL_PAR_PART;
+    if (width * height < FILL_PAR_MIN) parts = 1;
+    if (parts > fill_threads()) parts = fill_threads();
+    parts = RowPool_Run(fill_part, &job, height, parts);
+
+    /* parts are in row order, so the first failing part has the first mismatch */
+    for (i = 0; i < parts && !res; i++)
+    {
+        res = job.parts[i].res;
+        r = job.parts[i].row;
+        c = job.parts[i].col;
+    }
+
+    /* 1D tail is the last row of the split buffer */
+    if (!res && tail)
+    {
+        res = do_rows(job.mul, job.add, ptr, tail, rows_1d, rows_1d + 1,
+                      FILL_1D_ROW, &r, &c, check);
+    }
+    if (res && rows_1d)
+    {
+        c += r * FILL_1D_ROW;
+        r = 0;
+    }
+    if (res && row) *row = r;
+    if (res && col) *col = c;
+    return res;
+}
+
+enum fill_mode FillUtils_Mode()
+{
+    static int mode = -1;
+    if (mode < 0)
+    {
+        const char *env = getenv("MEMMGR_FILL");
+        mode = env && !strcmp(env, "hash") ? FILL_MODE_HASH : FILL_MODE_SERIAL;
+    }
+    return (enum fill_mode) mode;
+}
+
+void FillUtils_Fill(uint32_t seed, void *ptr, bytes_t width, bytes_t height,
+                    bytes_t stride)
+{
+    run(seed, ptr, width, height, stride, NULL, NULL, 0);
+}
+
+int FillUtils_Check(uint32_t seed, void *ptr, bytes_t width, bytes_t height,
+                    bytes_t stride, bytes_t *row, bytes_t *col)
+{
+    return run(seed, ptr, width, height, stride, row, col, 1);
+}
@@ -0,0 +1,113 @@
+/*
+ *  fill_utils.h
+ *
+ *  Fill pattern utility functions for the MemMgr tests.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _FILL_UTILS_H_
+#define _FILL_UTILS_H_
+
+#include <stdint.h>
+#include "mem_types.h"
+
+/**
+ * Fill patterns used by the tests to detect memory corruption
+ * and overlapping buffers.
+ * <p>
+ * The serial pattern is the delta/step recurrence of fill_mem in
+ * the tests.  It is strictly sequential, so it is verified one
+ * value at a time.
+ * <p>
+ * The hash pattern is a closed form function of the seed and the
+ * offset of each 32-bit word within the buffer:
+ * <pre>
+ *     V(i) = mix(i * M(seed) + A(seed))
+ * </pre>
+ * where mix is an invertible 32-bit hash, and M(seed) is odd.
+ * Since mix is invertible, a run of 2 or more words of another
+ * region can only match if its M is the same, i.e. if it was
+ * filled with the same seed from the same offset.  Any single
+ * word matches with a probability of 2^-32.  As each word is
+ * independent, rows are filled and verified 4 words at a time
+ * using SSE2 or NEON if available, and stride padding is
+ * skipped.  The rows of buffers of 1MB or more are also split
+ * among a small pool of threads (one per CPU, at most 8, or
+ * MEMMGR_FILL_THREADS).  The first mismatching row is reported
+ * regardless of which thread finds it first.
+ * <p>
+ * The pattern used by the tests is selected by the MEMMGR_FILL
+ * environment variable ("serial" or "hash"), and defaults to
+ * serial.
+ */
+enum fill_mode {
+    FILL_MODE_SERIAL,
+    FILL_MODE_HASH
+};
+
+/**
+ * Returns the fill pattern selected for the tests.
+ *
+ * @return FILL_MODE_SERIAL or FILL_MODE_HASH
+ */
+enum fill_mode FillUtils_Mode();
+
+/**
+ * Fills the rows of a buffer with the hash pattern.
+ *
+ * @param seed     Pattern seed
+ * @param ptr      Pointer to the first row
+ * @param width    Row width in bytes
+ * @param height   Number of rows
+ * @param stride   Row stride in bytes
+ */
+void FillUtils_Fill(uint32_t seed, void *ptr, bytes_t width, bytes_t height,
+                    bytes_t stride);
+
+/**
+ * Verifies that the rows of a buffer contain the hash pattern.
+ *
+ * @param seed     Pattern seed
+ * @param ptr      Pointer to the first row
+ * @param width    Row width in bytes
+ * @param height   Number of rows
+ * @param stride   Row stride in bytes
+ * @param row      Pointer to where to store the row of the first
+ *                 mismatch (may be NULL)
+ * @param col      Pointer to where to store the byte offset of
+ *                 the first mismatch within its row (may be NULL)
+ *
+ * @return 0 if the pattern matches, non-0 otherwise
+ */
+int FillUtils_Check(uint32_t seed, void *ptr, bytes_t width, bytes_t height,
+                    bytes_t stride, bytes_t *row, bytes_t *col);
+
+#endif
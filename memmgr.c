@@ -33,6 +33,9 @@
  *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -43,35 +46,72 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
 
 #define BUF_ALLOCED 1
 #define BUF_MAPPED  2
 #define BUF_ANY     ~0
 
+/* copies of at least this size (about the L2 size) use streaming stores */
+#define COPY_STREAM_MIN (1024 * 1024)
+
+/* data cache line size if the kernel does not report it (Cortex-A9) */
+#define CACHE_LINE 32
+#define CACHE_LINE_PATH "/sys/devices/system/cpu/cpu0/cache/index0/coherency_line_size"
+
+/* cache maintenance operations */
+#define CACHE_CLEAN      1
+#define CACHE_INVALIDATE 2
+#define CACHE_FLUSH      3
+
+/* tiler address bits of view orientation and container mode */
+#define TILER_ORIENT_SHIFT 29
+#define TILER_MODE_MASK    0x18000000
+#define TILER_ADDR_MASK    (TILER_MODE_MASK | (TILER_LENGTH - 1))
+
 #include <tiler.h>
 
 typedef struct tiler_block_info tiler_block_info;
 
-#define __DEBUG__
+#define __DEBUG_TRACE__
 #undef  __DEBUG_ENTRY__
 #define __DEBUG_ASSERT__
 
+#define PROBE_PROVIDER memmgr
+
 #ifdef HAVE_CONFIG_H
     #include "config.h"
 #endif
 #include "utils.h"
 #include "list_utils.h"
 #include "debug_utils.h"
+#include "probe_utils.h"
+#include "record.h"
+#include "blit.h"
 #include "tilermem.h"
 #include "tilermem_utils.h"
 #include "memmgr.h"
 
+#ifdef HAVE_PROBES
+/* probe semaphores, set while a tracer is attached */
+PROBE_SEMAPHORE(alloc);
+PROBE_SEMAPHORE(map);
+PROBE_SEMAPHORE(free);
+PROBE_SEMAPHORE(unmap);
+PROBE_SEMAPHORE(ioctl);
+PROBE_SEMAPHORE(mmap);
+PROBE_SEMAPHORE(munmap);
+#endif
+
 /* list of allocations */
 struct _AllocData {
     void     *bufPtr;
     bytes_t   size;
     uint32_t  tiler_id;
     int       buf_type;
+    int       num_blocks;
+    struct tiler_block_info *blocks;  /* block layout with addresses */
+    int      *cache_modes;            /* MEMMGR_CACHE_* mode of each block */
     struct _AllocList {
         struct _AllocList *next, *last;
         struct _AllocData *me;
@@ -79,6 +119,7 @@ struct _AllocData {
 };
 static struct _AllocList bufs = {0};
 static int bufs_inited = 0;
+static int num_bufs = 0;  /* number of elements in bufs */
 
 typedef struct _AllocList _AllocList;
 typedef struct _AllocData _AllocData;
@@ -88,6 +129,65 @@ static int td = -1;
 static pthread_mutex_t ref_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t che_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* consistency check settings */
+static int check_inited = 0;         /* level set by the user or the env. */
+static pthread_once_t check_once = PTHREAD_ONCE_INIT;
+static int check_level = MEMMGR_CHECK_COUNT;
+static int check_interval = 1;
+static uint32_t check_count = 0;
+
+/* statistics, protected by che_mutex */
+static MemMgr_Stats stats = {0};
+
+/* map cache: mappings of user buffers kept for reuse, protected by
+   che_mutex */
+struct _MapData {
+    void     *bufPtr;
+    int       refs;        /* number of MemMgr_Map calls not unmapped */
+    int       num_blocks;
+    struct tiler_block_info *blocks;  /* user blocks, then mapped blocks */
+    struct _MapList {
+        struct _MapList *next, *last;
+        struct _MapData *me;
+    } link;
+};
+static struct _MapList maps = {0};  /* most recently used first */
+static int num_maps = 0;            /* number of elements in maps */
+static int max_maps = 0;            /* map cache size, 0 if disabled.  Read
+                                       without the lock to skip the cache
+                                       while it is disabled and empty */
+
+typedef struct _MapList _MapList;
+typedef struct _MapData _MapData;
+
+/**
+ * Returns the current monotonic time.
+ *
+ * @return time in nanoseconds
+ */
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * Locks the buffer records.  Time is only measured if the lock
+ * is contended, so uncontended locking stays cheap.
+ */
+static void che_lock()
+{
+    if (pthread_mutex_trylock(&che_mutex))
+    {
+        uint64_t start = now_ns();
+        pthread_mutex_lock(&che_mutex);
+        stats.lock_wait_ns += now_ns() - start;
+        stats.lock_contentions++;
+    }
+    stats.lock_acquires++;
+}
+
 /**
  * Initializes the static structures
  *
@@ -98,6 +198,7 @@ static void init()
     if (!bufs_inited)
     {
         DLIST_INIT(bufs);
+        DLIST_INIT(maps);
         bufs_inited = 1;
     }
 }
@@ -163,6 +264,79 @@ static int dec_ref()
     return res;
 }
 
+/**
+ * Issues a tiler driver call.  The command, argument, result and
+ * latency of each call are reported via the ioctl probe.
+ *
+ * @param cmd    ioctl command
+ * @param arg    ioctl argument
+ *
+ * @return the return value of the ioctl call
+ */
+static int tiler_ioctl(unsigned long cmd, unsigned long arg)
+{
+#ifdef HAVE_PROBES
+    if (PROBE_ENABLED(ioctl))
+    {
+        uint64_t start = PROBE_NOW();
+        int ret = ioctl(td, cmd, arg);
+        PROBE4(ioctl, cmd, arg, ret, PROBE_NOW() - start);
+        return ret;
+    }
+#endif
+    return ioctl(td, cmd, arg);
+}
+
+#ifndef STUB_TILER
+/**
+ * Maps a registered tiler buffer into the process space.  The
+ * result and latency of the call are reported via the mmap
+ * probe.
+ *
+ * @param size    Size of the buffer
+ * @param offset  Tiler ID (offset) of the registered buffer
+ *
+ * @return pointer to the mapping, or MAP_FAILED on failure
+ */
+static void *tiler_dev_mmap(bytes_t size, uint32_t offset)
+{
+#ifdef HAVE_PROBES
+    if (PROBE_ENABLED(mmap))
+    {
+        uint64_t start = PROBE_NOW();
+        void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, td, offset);
+        PROBE4(mmap, ptr, size, offset, PROBE_NOW() - start);
+        return ptr;
+    }
+#endif
+    return mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, td, offset);
+}
+
+/**
+ * Unmaps a tiler buffer from the process space.  The result and
+ * latency of the call are reported via the munmap probe.
+ *
+ * @param ptr     Pointer to the buffer (need not be page aligned)
+ * @param size    Size of the buffer
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int tiler_dev_munmap(void *ptr, bytes_t size)
+{
+    ptr = (void *)((uint32_t)ptr & ~(PAGE_SIZE - 1));
+#ifdef HAVE_PROBES
+    if (PROBE_ENABLED(munmap))
+    {
+        uint64_t start = PROBE_NOW();
+        int ret = munmap(ptr, size);
+        PROBE4(munmap, ptr, size, ret, PROBE_NOW() - start);
+        return ret;
+    }
+#endif
+    return munmap(ptr, size);
+}
+#endif
+
 /**
  * Returns the default page stride for this block
  *
@@ -203,9 +377,11 @@ static bytes_t def_bpp(pixel_fmt_t pixelFormat)
  */
 static bytes_t def_size(tiler_block_info *blk)
 {
+    /* 2D user blocks mapped by the emulated tiler keep the user stride */
     return (blk->fmt == PIXEL_FMT_PAGE ?
             blk->dim.len :
-            blk->dim.area.height * def_stride(blk->dim.area.width * def_bpp(blk->fmt)));
+            blk->dim.area.height * (blk->stride ? blk->stride :
+                def_stride(blk->dim.area.width * def_bpp(blk->fmt))));
 }
 
 /**
@@ -214,24 +390,45 @@ static bytes_t def_size(tiler_block_info *blk)
  *
  * @author a0194118 (9/7/2009)
  *
- * @param bufPtr    Buffer pointer
- * @param tiler_id  Tiler ID
- * @param buf_type  Buffer type: BUF_ALLOCED or BUF_MAPPED
+ * @param bufPtr      Buffer pointer
+ * @param tiler_id    Tiler ID
+ * @param buf_type    Buffer type: BUF_ALLOCED or BUF_MAPPED
+ * @param blks        Pointer to array of block info structures,
+ *                    with their ptr and ssptr filled out.  These
+ *                    are saved so that block lookups need no
+ *                    ioctls.
+ * @param num_blocks  Number of blocks
+ * @param cache_modes Array of the cache mode of each block
  *
  * @return 0 on success, -ENOMEM on memory allocation failure
  */
 static int buf_cache_add(void *bufPtr, bytes_t size, uint32_t tiler_id,
-                          int buf_type)
+                          int buf_type, struct tiler_block_info *blks,
+                          int num_blocks, const int *cache_modes)
 {
-    pthread_mutex_lock(&che_mutex);
+    che_lock();
     _AllocData *ad = NEW(_AllocData);
     if (ad)
     {
+	    ad->blocks = NEWN(struct tiler_block_info, num_blocks);
+	    ad->cache_modes = NEWN(int, num_blocks);
+	    if (!ad->blocks || !ad->cache_modes)
+	    {
+	        FREE(ad->blocks);
+	        FREE(ad->cache_modes);
+	        FREE(ad);
+	        pthread_mutex_unlock(&che_mutex);
+	        return -ENOMEM;
+	    }
+	    memcpy(ad->blocks, blks, sizeof(*blks) * num_blocks);
+	    memcpy(ad->cache_modes, cache_modes, sizeof(int) * num_blocks);
+	    ad->num_blocks = num_blocks;
 	    ad->bufPtr = bufPtr;
 	    ad->size = size;
 	    ad->tiler_id = tiler_id;
 	    ad->buf_type = buf_type;
 	    DLIST_MADD_BEFORE(bufs, ad, link);
+	    num_bufs++;
     }
     pthread_mutex_unlock(&che_mutex);
     return ad == NULL ? -ENOMEM : 0;
@@ -255,7 +452,7 @@ static uint32_t buf_cache_query(void *ptr, int buf_type_mask,
     IN;
     if(0) DP("in(p=%p,t=%d,bp*=%p)", ptr, buf_type_mask, bufPtr);
     _AllocData *ad;
-    pthread_mutex_lock(&che_mutex);
+    che_lock();
     DLIST_MLOOP(bufs, ad, link) {
         if(0) {
             DP("got(%p-%p,%d)", ad->bufPtr, ad->bufPtr + ad->size, ad->buf_type);
@@ -294,12 +491,15 @@ static uint32_t buf_cache_query(void *ptr, int buf_type_mask,
 static uint32_t buf_cache_del(void *bufPtr, int buf_type)
 {
     _AllocData *ad;
-    pthread_mutex_lock(&che_mutex);
+    che_lock();
     DLIST_MLOOP(bufs, ad, link) {
         if (ad->bufPtr == bufPtr && ad->buf_type == buf_type) {
             uint32_t tiler_id = ad->tiler_id;
             DLIST_REMOVE(ad->link);
+            FREE(ad->blocks);
+            FREE(ad->cache_modes);
             FREE(ad);
+            num_bufs--;
             pthread_mutex_unlock(&che_mutex);
             return tiler_id;
         }
@@ -308,10 +508,56 @@ static uint32_t buf_cache_del(void *bufPtr, int buf_type)
     return 0;
 }
 
+/**
+ * Reads the consistency check settings from the MEMMGR_CHECK
+ * environment variable, unless they have been set by
+ * MemMgr_SetCheckLevel().  Its format is "<level>[,<interval>]"
+ * where level is off, count or full.  Run once via check_once.
+ */
+static void check_init()
+{
+    const char *spec = getenv("MEMMGR_CHECK");
+    int level = -1, interval = 1;
+
+    if (spec)
+    {
+        const char *comma = strchr(spec, ',');
+        if (comma) interval = atoi(comma + 1);
+        size_t len = comma ? (size_t) (comma - spec) : strlen(spec);
+
+        if (len == 3 && !strncmp(spec, "off", len))
+            level = MEMMGR_CHECK_OFF;
+        else if (len == 5 && !strncmp(spec, "count", len))
+            level = MEMMGR_CHECK_COUNT;
+        else if (len == 4 && !strncmp(spec, "full", len))
+            level = MEMMGR_CHECK_FULL;
+        if (level < 0 || interval <= 0)
+        {
+            DP("invalid MEMMGR_CHECK value: %s", spec);
+            level = -1;
+        }
+    }
+
+    che_lock();
+    if (!check_inited && level >= 0)
+    {
+        check_level = level;
+        check_interval = interval;
+        check_count = 0;
+    }
+    check_inited = 1;
+    pthread_mutex_unlock(&che_mutex);
+}
+
 /**
  * Checks the consistency of the internal record cache.  The
  * number of elements in the cache should equal to the number of
  * references.
+ * <p>
+ * Depending on the check level, this compares the element count
+ * maintained by buf_cache_add/del with the reference count, and
+ * every check_interval-th call also verifies the element count
+ * by walking the cache.
  *
  * @author a0194118 (9/7/2009)
  *
@@ -319,16 +565,27 @@ static uint32_t buf_cache_del(void *bufPtr, int buf_type)
  */
 static int cache_check()
 {
-    int num_bufs = 0;
-    pthread_mutex_lock(&che_mutex);
+    int res = MEMMGR_ERR_NONE;
+
+    pthread_once(&check_once, check_init);
+    if (check_level == MEMMGR_CHECK_OFF) return res;
+
+    che_lock();
 
     init();
 
-    _AllocData *ad;
-    DLIST_MLOOP(bufs, ad, link) { num_bufs++; }
+    if (check_level == MEMMGR_CHECK_FULL &&
+        ++check_count % check_interval == 0)
+    {
+        int n = 0;
+        _AllocData *ad;
+        DLIST_MLOOP(bufs, ad, link) { n++; }
+        if (NOT_I(n,==,num_bufs)) res = MEMMGR_ERR_GENERIC;
+    }
+    if (num_bufs != refCnt) res = MEMMGR_ERR_GENERIC;
 
     pthread_mutex_unlock(&che_mutex);
-    return (num_bufs == refCnt) ? MEMMGR_ERR_NONE : MEMMGR_ERR_GENERIC;
+    return res;
 }
 
 static void dump_block(struct tiler_block_info *blk, char *prefix, char *suffix)
@@ -378,19 +635,14 @@ static void dump_buf(struct tiler_buf_info* buf, char* prefix)
 static enum tiler_fmt tiler_get_fmt(SSPtr ssptr)
 {
 #ifndef STUB_TILER
-    return (ssptr == 0              ? TILFMT_INVALID :
-            ssptr < TILER_MEM_8BIT  ? TILFMT_NONE :
-            ssptr < TILER_MEM_16BIT ? TILFMT_8BIT :
-            ssptr < TILER_MEM_32BIT ? TILFMT_16BIT :
-            ssptr < TILER_MEM_PAGED ? TILFMT_32BIT :
-            ssptr < TILER_MEM_END   ? TILFMT_PAGE : TILFMT_NONE);
+    return TilerMem_GetFmt(ssptr);
 #else
     /* if emulating, we need to get through all allocated memory segments */
-    pthread_mutex_lock(&che_mutex);
-    init();
-    _AllocData *ad;
     void *ptr = (void *) ssptr;
     if (!ptr) return TILFMT_INVALID;
+    che_lock();
+    init();
+    _AllocData *ad;
     /* P("?%p", (void *)ssptr); */
     DLIST_MLOOP(bufs, ad, link) {
         int ix;
@@ -425,7 +677,7 @@ static SSPtr tiler_alloc(struct tiler_block_info *blk)
 {
     if (0) dump_block(blk, "=(ta)=>", "");
     blk->ptr = NULL;
-    R_I(ioctl(td, TILIOC_GBUF, blk));
+    R_I(tiler_ioctl(TILIOC_GBUF, (unsigned long) blk));
     if (blk->fmt != PIXEL_FMT_PAGE)
     {
         blk->stride = def_stride(blk->dim.area.width * def_bpp(blk->fmt));
@@ -445,7 +697,7 @@ static SSPtr tiler_alloc(struct tiler_block_info *blk)
  */
 static int tiler_free(struct tiler_block_info *blk)
 {
-    return R_I(ioctl(td, TILIOC_FBUF, blk));
+    return R_I(tiler_ioctl(TILIOC_FBUF, (unsigned long) blk));
 }
 
 /**
@@ -460,7 +712,18 @@ static int tiler_free(struct tiler_block_info *blk)
 static SSPtr tiler_map(struct tiler_block_info *blk)
 {
     dump_block(blk, "=(tm)=>", "");
-    R_I(ioctl(td, TILIOC_MBUF, blk));
+#ifndef STUB_TILER
+    R_I(tiler_ioctl(TILIOC_MBUF, (unsigned long) blk));
+    if (blk->ssptr && blk->fmt != TILFMT_PAGE)
+    {
+        blk->stride = def_stride(blk->dim.area.width * def_bpp(blk->fmt));
+    }
+#else
+    /* emulate pinning the user pages: this fails if they are not all
+       mapped in the process */
+    blk->ssptr = msync(blk->ptr, def_size(blk), MS_ASYNC) ? 0 :
+                 (uint32_t) blk->ptr;
+#endif
     return R_UP(blk->ssptr);
 }
 
@@ -475,7 +738,7 @@ static SSPtr tiler_map(struct tiler_block_info *blk)
  */
 static int tiler_unmap(struct tiler_block_info *blk)
 {
-    return ioctl(td, TILIOC_UMBUF, blk);
+    return tiler_ioctl(TILIOC_UMBUF, (unsigned long) blk);
 }
 
 /**
@@ -499,6 +762,25 @@ static bytes_t tiler_size(struct tiler_block_info *blks, int num_blocks)
     return size;
 }
 
+/**
+ * Returns the cache mode a block gets for a requested mode.
+ * Blocks are mapped in their default mode: the tiler driver has
+ * no interface for choosing the mapping attributes, and the
+ * emulated tiler follows the same defaults.  So MemMgr_AllocEx
+ * rejects requests for any other mode.
+ *
+ * @param blk    Pointer to the block info
+ * @param mode   Requested MEMMGR_CACHE_* mode
+ *
+ * @return The resulting mode
+ */
+static int cache_mode(struct tiler_block_info *blk, int mode)
+{
+    int def = blk->fmt == TILFMT_PAGE ? MEMMGR_CACHE_CACHED :
+                                        MEMMGR_CACHE_UNCACHED;
+    return mode == MEMMGR_CACHE_DEFAULT ? def : mode;
+}
+
 /**
  * Registers a buffer structure with tiler, and maps the buffer
  * into memory using tiler. On success, it writes the tiler ID
@@ -509,17 +791,29 @@ static bytes_t tiler_size(struct tiler_block_info *blks, int num_blocks)
  * @param blks        Pointer to array of block info structures
  * @param num_blocks  Number of blocks
  * @param tiler_id      Pointer to tiler ID.
+ * @param cache_modes Array of requested cache modes, or NULL for
+ *                    the default modes
+ * @param offset      Offset of the buffer in its first page, for
+ *                    user buffers mapped from their enclosing
+ *                    pages
  *
  * @return pointer to the mapped buffer.
  */
 static void *tiler_mmap(struct tiler_block_info *blks, int num_blocks,
-                        int buf_type)
+                        int buf_type, const int *cache_modes,
+                        bytes_t offset)
 {
     IN;
 
     /* get size */
     bytes_t size = tiler_size(blks, num_blocks);
-    int ix;
+    int ix, modes[TILER_MAX_NUM_BLOCKS];
+
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        modes[ix] = cache_mode(blks + ix, cache_modes ? cache_modes[ix] :
+                                          MEMMGR_CACHE_DEFAULT);
+    }
 
     /* register buffer with tiler */
     struct tiler_buf_info buf;
@@ -528,7 +822,7 @@ static void *tiler_mmap(struct tiler_block_info *blks, int num_blocks,
     for (ix = 0; ix < num_blocks; ix++) memcpy(buf.blocks + ix, blks + ix, sizeof(tiler_block_info));
 #ifndef STUB_TILER
     dump_buf(&buf, "==(RBUF)=>");
-    int ret = ioctl(td, TILIOC_RBUF, &buf);
+    int ret = tiler_ioctl(TILIOC_RBUF, (unsigned long) &buf);
     dump_buf(&buf, "<=(RBUF)==");
     if (NOT_I(ret,==,0)) return NULL;
 
@@ -541,8 +835,7 @@ static void *tiler_mmap(struct tiler_block_info *blks, int num_blocks,
 
     /* map blocks to process space */
 #ifndef STUB_TILER
-    void *bufPtr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED,
-                        td, buf.offset);
+    void *bufPtr = tiler_dev_mmap(size, buf.offset);
     if (bufPtr == MAP_FAILED){
         bufPtr = NULL;
     } else {
@@ -550,9 +843,19 @@ static void *tiler_mmap(struct tiler_block_info *blks, int num_blocks,
     }
     if(0) DP("ptr=%p", bufPtr);
 #else
-    void *bufPtr = malloc(size + PAGE_SIZE - 1);
-    buf_c[1].blocks[0].ptr = bufPtr;
-    bufPtr = (void *)((PAGE_SIZE - 1 + (uint32_t)bufPtr) &~ (PAGE_SIZE - 1));
+    void *bufPtr;
+    if (buf_type == BUF_MAPPED && blks[0].fmt != TILFMT_PAGE)
+    {
+        /* 2D user blocks are used in place */
+        bufPtr = blks[0].ptr;
+        buf_c[1].blocks[0].ptr = NULL;
+    }
+    else
+    {
+        bufPtr = malloc(size + PAGE_SIZE - 1);
+        buf_c[1].blocks[0].ptr = bufPtr;
+        bufPtr = (void *)((PAGE_SIZE - 1 + (uint32_t)bufPtr) &~ (PAGE_SIZE - 1));
+    }
     /* P("<= [0x%x]", size); */
 
     /* fill out pointers - this is needed for caching 1D/2D type */
@@ -565,33 +868,36 @@ static void *tiler_mmap(struct tiler_block_info *blks, int num_blocks,
     memcpy(buf_c, &buf, sizeof(struct tiler_buf_info));
 #endif
 
+    /* fill out pointers (callers reset them on failure) */
+    for (size = ix = 0; bufPtr && ix < num_blocks; ix++)
+    {
+        blks[ix].ptr = bufPtr + size;
+        /* P("   [0x%p]", blks[ix].ptr); */
+        size += def_size(blks + ix);
+#ifdef STUB_TILER
+        blks[ix].ssptr = (uint32_t) blks[ix].ptr;
+#else
+        blks[ix].ptr = (void *)((((uint32_t)blks[ix].ptr) & ~(PAGE_SIZE - 1)) | (blks[ix].ssptr & (PAGE_SIZE - 1)));
+#endif
+    }
+    /* the buffer starts offset bytes into the mapping */
+    if (bufPtr) bufPtr += offset;
+
     /* if failed to map: unregister buffer */
     if (NOT_P(bufPtr,!=,NULL) ||
-	/* or failed to cache tiler ID for buffer */
-        NOT_I(buf_cache_add(bufPtr, size, buf.offset, buf_type),==,0))
+	/* or failed to cache tiler ID and blocks for buffer: also unmap it */
+        NOT_I(buf_cache_add(bufPtr, size - offset, buf.offset, buf_type, blks,
+                            num_blocks, modes),==,0))
     {
 #ifndef STUB_TILER
-        A_I(ioctl(td, TILIOC_URBUF, &buf),==,0);
+        if (bufPtr) A_I(tiler_dev_munmap(bufPtr, size),==,0);
+        A_I(tiler_ioctl(TILIOC_URBUF, (unsigned long) &buf),==,0);
 #else
+        FREE(buf_c[1].blocks[0].ptr);
         FREE(buf_c);
         buf.offset = 0;
 #endif
-    }
-    /* otherwise, fill out pointers */
-    else
-    {
-        /* fill out pointers */
-        for (size = ix = 0; ix < num_blocks; ix++)
-        {
-            blks[ix].ptr = bufPtr + size;
-            /* P("   [0x%p]", blks[ix].ptr); */
-            size += def_size(blks + ix);
-#ifdef STUB_TILER
-            blks[ix].ssptr = (uint32_t) blks[ix].ptr;
-#else
-            blks[ix].ptr = (void *)((((uint32_t)blks[ix].ptr) & ~(PAGE_SIZE - 1)) | (blks[ix].ssptr & (PAGE_SIZE - 1)));
-#endif
-        }
+        bufPtr = NULL;
     }
 
     return R_P(bufPtr);
@@ -702,25 +1008,118 @@ static void reset_blocks(struct tiler_block_info *blks, int num_blocks)
 
 }
 
+/**
+ * Returns the system space address of a virtual address.  This
+ * is TilerMem_VirtToPhys without recording the call.
+ *
+ * @param ptr    Virtual address
+ *
+ * @return system space address, or 0 if ptr is not mapped to
+ *         tiler space.
+ */
+static SSPtr virt_to_phys(void *ptr)
+{
+#ifndef STUB_TILER
+    SSPtr ssptr = 0;
+    if(!NOT_I(inc_ref(),==,0))
+    {
+        ssptr = tiler_ioctl(TILIOC_GSSP, (unsigned long) ptr);
+        A_I(dec_ref(),==,0);
+    }
+    return (SSPtr)R_P(ssptr);
+#else
+    return (SSPtr)ptr;
+#endif
+}
+
+/**
+ * Checks if a virtual address is mapped to tiler space.  This
+ * is MemMgr_IsMapped without recording the call.
+ *
+ * @param ptr    Virtual address
+ *
+ * @return TRUE (non-0) if the virtual address is mapped to
+ *         tiler space.
+ */
+static bool is_mapped(void *ptr)
+{
+    SSPtr ssptr = virt_to_phys(ptr);
+    enum tiler_fmt fmt = tiler_get_fmt(ssptr);
+    return fmt == TILFMT_8BIT || fmt == TILFMT_16BIT ||
+           fmt == TILFMT_32BIT || fmt == TILFMT_PAGE;
+}
+
+int MemMgr_SetCheckLevel(int level, int interval)
+{
+    if (NOT_I(level,>=,MEMMGR_CHECK_OFF) || NOT_I(level,<=,MEMMGR_CHECK_FULL) ||
+        NOT_I(interval,>,0))
+        return MEMMGR_ERR_GENERIC;
+
+    che_lock();
+    check_inited = 1;
+    check_level = level;
+    check_interval = interval;
+    check_count = 0;
+    pthread_mutex_unlock(&che_mutex);
+    return MEMMGR_ERR_NONE;
+}
+
+int MemMgr_GetCheckLevel(int *interval)
+{
+    pthread_once(&check_once, check_init);
+    che_lock();
+    int level = check_level;
+    if (interval) *interval = check_interval;
+    pthread_mutex_unlock(&che_mutex);
+    return level;
+}
+
+int MemMgr_GetStats(MemMgr_Stats *stats_out, bool reset)
+{
+    if (NOT_P(stats_out,!=,NULL)) return MEMMGR_ERR_GENERIC;
+
+    pthread_mutex_lock(&che_mutex);
+    *stats_out = stats;
+    if (reset) ZERO(stats);
+    pthread_mutex_unlock(&che_mutex);
+    return MEMMGR_ERR_NONE;
+}
+
 bytes_t MemMgr_PageSize()
 {
     return PAGE_SIZE;
 }
 
 void *MemMgr_Alloc(MemAllocBlock blocks[], int num_blocks)
+{
+    return MemMgr_AllocEx(blocks, num_blocks, NULL);
+}
+
+void *MemMgr_AllocEx(MemAllocBlock blocks[], int num_blocks,
+                     const int cache_modes[])
 {
     IN;
+    uint64_t rec_start = RECORD_START();
     void *bufPtr = NULL;
+    int ix;
 
     /* need to access ssptrs */
     struct tiler_block_info *blks = (tiler_block_info *) blocks;
 
-    /* check block allocation params, and state */
-    if (NOT_I(check_blocks(blks, num_blocks, num_blocks - 1),==,0) ||
-        NOT_I(inc_ref(),==,0)) goto DONE;
+    /* check block allocation params, cache modes and state */
+    if (NOT_I(check_blocks(blks, num_blocks, num_blocks - 1),==,0))
+        goto DONE;
+    for (ix = 0; cache_modes && ix < num_blocks; ix++)
+    {
+        if (NOT_I(cache_modes[ix],>=,MEMMGR_CACHE_DEFAULT) ||
+            NOT_I(cache_modes[ix],<=,MEMMGR_CACHE_UNCACHED) ||
+            /* blocks can only be mapped in their default mode */
+            NOT_I(cache_mode(blks + ix, cache_modes[ix]),==,
+                  cache_mode(blks + ix, MEMMGR_CACHE_DEFAULT))) goto DONE;
+    }
+    if (NOT_I(inc_ref(),==,0)) goto DONE;
 
     /* ----- begin recoverable portion ----- */
-    int ix;
 
     /* allocate each buffer using tiler driver and initialize block info */
     for (ix = 0; ix < num_blocks; ix++)
@@ -729,7 +1128,7 @@ void *MemMgr_Alloc(MemAllocBlock blocks[], int num_blocks)
         if (NOT_I(tiler_alloc(blks + ix),>=,0)) goto FAIL_ALLOC;
     }
 
-    bufPtr = tiler_mmap(blks, num_blocks, BUF_ALLOCED);
+    bufPtr = tiler_mmap(blks, num_blocks, BUF_ALLOCED, cache_modes, 0);
     if (A_P(bufPtr,!=,0)) goto DONE;
 
     /* ------ error handling ------ */
@@ -745,12 +1144,16 @@ FAIL_ALLOC:
     A_I(dec_ref(),==,0);
 DONE:
     CHK_I(cache_check(),==,0);
+    PROBE4(alloc, bufPtr, bufPtr ? tiler_size(blks, num_blocks) : 0,
+           num_blocks > 0 ? blks[0].fmt : TILFMT_INVALID, num_blocks);
+    RECORD(REC_ALLOC, bufPtr, (uintptr_t) bufPtr, blocks, num_blocks, rec_start);
     return R_P(bufPtr);
 }
 
 int MemMgr_Free(void *bufPtr)
 {
     IN;
+    uint64_t rec_start = RECORD_START();
 
     int ret = MEMMGR_ERR_GENERIC;
     struct tiler_buf_info buf;
@@ -765,7 +1168,7 @@ int MemMgr_Free(void *bufPtr)
 #ifndef STUB_TILER
         /* get block information for the buffer */
         dump_buf(&buf, "==(QBUF)=>");
-        ret = A_I(ioctl(td, TILIOC_QBUF, &buf),==,0);
+        ret = A_I(tiler_ioctl(TILIOC_QBUF, (unsigned long) &buf),==,0);
         dump_buf(&buf, "<=(QBUF)==");
 
         /* unregister buffer, and free tiler chunks even if there is an
@@ -773,7 +1176,7 @@ int MemMgr_Free(void *bufPtr)
         if (!ret)
         {
             dump_buf(&buf, "==(URBUF)=>");
-            ret = A_I(ioctl(td, TILIOC_URBUF, &buf),==,0);
+            ret = A_I(tiler_ioctl(TILIOC_URBUF, (unsigned long) &buf),==,0);
             dump_buf(&buf, "<=(URBUF)==");
 
             /* free each block */
@@ -785,8 +1188,7 @@ int MemMgr_Free(void *bufPtr)
 
             /* unmap buffer */
             bytes_t size = tiler_size(buf.blocks, buf.num_blocks);
-            bufPtr = (void *)((uint32_t)bufPtr & ~(PAGE_SIZE - 1));
-            ERR_ADD(ret, munmap(bufPtr, size));
+            ERR_ADD(ret, tiler_dev_munmap(bufPtr, size));
         }
 #else
         void *ptr = (void *) buf.offset;
@@ -797,44 +1199,37 @@ int MemMgr_Free(void *bufPtr)
     }
 
     CHK_I(cache_check(),==,0);
+    PROBE2(free, bufPtr, ret);
+    RECORD(REC_FREE, bufPtr, ret, NULL, 0, rec_start);
     return R_I(ret);
 }
 
-void *MemMgr_Map(MemAllocBlock blocks[], int num_blocks)
+/**
+ * Maps checked user blocks into tiler space, and the resulting
+ * buffer into the process space.  Unmaps the blocks already
+ * mapped if any block cannot be mapped.
+ *
+ * @param blks        Pointer to array of block info structures
+ * @param num_blocks  Number of blocks
+ * @param offset      Offset of the buffer in its first page
+ *
+ * @return pointer to the mapped buffer, or NULL on failure.
+ */
+static void *map_blocks(struct tiler_block_info *blks, int num_blocks,
+                        bytes_t offset)
 {
-    IN;
-    void *bufPtr = NULL;
-
-    /* need to access ssptrs */
-    struct tiler_block_info *blks = (tiler_block_info *) blocks;
-
-    /* check block params, and state */
-    if (check_blocks(blks, num_blocks, num_blocks) ||
-        NOT_I(inc_ref(),==,0)) goto DONE;
-
-    /* we only map 1 page aligned 1D buffer for now */
-    if (NOT_I(num_blocks,==,1) ||
-        NOT_I(blocks[0].pixelFormat,==,PIXEL_FMT_PAGE) ||
-        NOT_I(blocks[0].dim.len & (PAGE_SIZE - 1),==,0) ||
-#ifdef STUB_TILER
-        NOT_I(MemMgr_IsMapped(blocks[0].ptr),==,0) ||
-#endif
-        NOT_I((uint32_t)blocks[0].ptr & (PAGE_SIZE - 1),==,0))
-        goto FAIL;
-
     /* ----- begin recoverable portion ----- */
     int ix;
 
-    /* allocate each buffer using tiler driver */
+    /* map each block using tiler driver */
     for (ix = 0; ix < num_blocks; ix++)
     {
-        if (NOT_I(blks[ix].ptr,!=,NULL) ||
-            NOT_I(tiler_map(blks + ix),>,0)) goto FAIL_MAP;
+        if (NOT_I(tiler_map(blks + ix),>,0)) goto FAIL_MAP;
     }
 
     /* map bufer into tiler space and register with tiler manager */
-    bufPtr = tiler_mmap(blks, num_blocks, BUF_MAPPED);
-    if (A_P(bufPtr,!=,0)) goto DONE;
+    void *bufPtr = tiler_mmap(blks, num_blocks, BUF_MAPPED, NULL, offset);
+    if (A_P(bufPtr,!=,0)) return bufPtr;
 
     /* ------ error handling ------ */
 FAIL_MAP:
@@ -842,21 +1237,19 @@ FAIL_MAP:
     {
         tiler_unmap(blks + --ix);
     }
-
-FAIL:
-    /* clear ssptr and ptr fields for all blocks */
-    reset_blocks(blks, num_blocks);
-
-    A_I(dec_ref(),==,0);
-DONE:
-    CHK_I(cache_check(),==,0);
-    return R_P(bufPtr);
+    return NULL;
 }
 
-int MemMgr_UnMap(void *bufPtr)
+/**
+ * Unmaps a mapped buffer, and unregisters it from the tiler
+ * manager.
+ *
+ * @param bufPtr  Pointer to the mapped buffer
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int unmap_buf(void *bufPtr)
 {
-    IN;
-
     int ret = MEMMGR_ERR_GENERIC;
     struct tiler_buf_info buf;
     ZERO(buf);
@@ -870,7 +1263,7 @@ int MemMgr_UnMap(void *bufPtr)
 #ifndef STUB_TILER
         /* get block information for the buffer */
         dump_buf(&buf, "==(QBUF)=>");
-        ret = A_I(ioctl(td, TILIOC_QBUF, &buf),==,0);
+        ret = A_I(tiler_ioctl(TILIOC_QBUF, (unsigned long) &buf),==,0);
         dump_buf(&buf, "<=(QBUF)==");
 
         /* unregister buffer, and free tiler chunks even if there is an
@@ -878,7 +1271,7 @@ int MemMgr_UnMap(void *bufPtr)
         if (!ret)
         {
             dump_buf(&buf, "==(URBUF)=>");
-            ret = A_I(ioctl(td, TILIOC_URBUF, &buf),==,0);
+            ret = A_I(tiler_ioctl(TILIOC_URBUF, (unsigned long) &buf),==,0);
             dump_buf(&buf, "<=(URBUF)==");
 
             /* unmap each block */
@@ -890,8 +1283,7 @@ int MemMgr_UnMap(void *bufPtr)
 
             /* unmap buffer */
             bytes_t size = tiler_size(buf.blocks, buf.num_blocks);
-            bufPtr = (void *)((uint32_t)bufPtr & ~(PAGE_SIZE - 1));
-            ERR_ADD(ret, munmap(bufPtr, size));
+            ERR_ADD(ret, tiler_dev_munmap(bufPtr, size));
         }
 #else
         struct tiler_buf_info *ptr = (struct tiler_buf_info *) buf.offset;
@@ -902,39 +1294,396 @@ int MemMgr_UnMap(void *bufPtr)
         ERR_ADD(ret, dec_ref());
     }
 
-    CHK_I(cache_check(),==,0);
-    return R_I(ret);
+    return ret;
 }
 
-bool MemMgr_Is1DBlock(void *ptr)
+/**
+ * Finds the cached mapping of the given user blocks.  The
+ * caller must hold che_mutex.
+ *
+ * @param blks        Pointer to array of user block info
+ *                    structures
+ * @param num_blocks  Number of blocks
+ *
+ * @return pointer to the cached mapping, or NULL if none.
+ */
+static _MapData *map_cache_find(struct tiler_block_info *blks, int num_blocks)
 {
-    IN;
-
-    SSPtr ssptr = TilerMem_VirtToPhys(ptr);
-    enum tiler_fmt fmt = tiler_get_fmt(ssptr);
-    return R_I(fmt == TILFMT_PAGE);
+    _MapData *md;
+    DLIST_MLOOP(maps, md, link) {
+        int ix = 0;
+        if (md->num_blocks != num_blocks) continue;
+        while (ix < num_blocks && md->blocks[ix].fmt == blks[ix].fmt &&
+               md->blocks[ix].ptr == blks[ix].ptr &&
+               md->blocks[ix].dim.len == blks[ix].dim.len) ix++;
+        if (ix == num_blocks) break;
+    }
+    return md;
 }
 
-bool MemMgr_Is2DBlock(void *ptr)
+/**
+ * Looks up the cached mapping of the given user blocks.  On a
+ * hit the mapping gets another reference, and becomes the most
+ * recently used one.  The blocks are updated as by MemMgr_Map.
+ *
+ * @param blks        Pointer to array of user block info
+ *                    structures
+ * @param num_blocks  Number of blocks
+ *
+ * @return pointer to the mapped buffer, or NULL on a miss.
+ */
+static void *map_cache_get(struct tiler_block_info *blks, int num_blocks)
 {
-    IN;
+    void *bufPtr = NULL;
 
-    SSPtr ssptr = TilerMem_VirtToPhys(ptr);
-    enum tiler_fmt fmt = tiler_get_fmt(ssptr);
-    return R_I(fmt == TILFMT_8BIT || fmt == TILFMT_16BIT ||
-               fmt == TILFMT_32BIT);
-}
+    /* the cache is off by default: skip the lock until it is enabled */
+    if (!max_maps) return NULL;
 
-bool MemMgr_IsMapped(void *ptr)
-{
-    IN;
-    SSPtr ssptr = TilerMem_VirtToPhys(ptr);
-    enum tiler_fmt fmt = tiler_get_fmt(ssptr);
-    return R_I(fmt == TILFMT_8BIT || fmt == TILFMT_16BIT ||
-               fmt == TILFMT_32BIT || fmt == TILFMT_PAGE);
+    che_lock();
+    if (max_maps)
+    {
+        _MapData *md = map_cache_find(blks, num_blocks);
+        if (md)
+        {
+            md->refs++;
+            memcpy(blks, md->blocks + num_blocks, sizeof(*blks) * num_blocks);
+            DLIST_MOVE_AFTER(maps, md->link);
+            bufPtr = md->bufPtr;
+            stats.map_cache_hits++;
+        }
+        else
+        {
+            stats.map_cache_misses++;
+        }
+    }
+    pthread_mutex_unlock(&che_mutex);
+    return bufPtr;
 }
 
-bytes_t MemMgr_GetStride(void *ptr)
+/**
+ * Unmaps idle cached mappings, least recently used first, until
+ * the number of cached mappings is at most the map cache size
+ * (or none if flushing), or there are no more idle mappings.
+ *
+ * @param flush  TRUE (non-0) to unmap all idle mappings
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int map_cache_evict(bool flush)
+{
+    int ret = MEMMGR_ERR_NONE;
+    _MapData *md;
+
+    for (;;)
+    {
+        che_lock();
+        md = NULL;
+        if (num_maps > (flush ? 0 : max_maps))
+        {
+            DLIST_RMLOOP(maps, md, link) {
+                if (!md->refs) break;
+            }
+        }
+        if (md)
+        {
+            DLIST_REMOVE(md->link);
+            num_maps--;
+            stats.map_cache_evictions++;
+        }
+        pthread_mutex_unlock(&che_mutex);
+
+        if (!md) return ret;
+        ERR_ADD(ret, unmap_buf(md->bufPtr));
+        FREE(md->blocks);
+        FREE(md);
+    }
+}
+
+/**
+ * Adds a new mapping to the map cache if it is enabled, and
+ * evicts the least recently used idle mappings over the cache
+ * size.  The mapping stays uncached if the same user blocks
+ * have been cached by another thread meanwhile, or if there is
+ * not enough memory.
+ *
+ * @param bufPtr      Pointer to the mapped buffer
+ * @param user        Pointer to array of user block info
+ *                    structures
+ * @param blks        Pointer to array of mapped block info
+ *                    structures
+ * @param num_blocks  Number of blocks
+ */
+static void map_cache_add(void *bufPtr, struct tiler_block_info *user,
+                          struct tiler_block_info *blks, int num_blocks)
+{
+    _MapData *md = NULL;
+
+    if (!max_maps) return;
+
+    che_lock();
+    if (max_maps && !map_cache_find(user, num_blocks))
+    {
+        md = NEW(_MapData);
+        if (md)
+        {
+            md->blocks = NEWN(struct tiler_block_info, 2 * num_blocks);
+            if (!md->blocks) FREE(md);
+        }
+    }
+    if (md)
+    {
+        memcpy(md->blocks, user, sizeof(*user) * num_blocks);
+        memcpy(md->blocks + num_blocks, blks, sizeof(*blks) * num_blocks);
+        md->num_blocks = num_blocks;
+        md->bufPtr = bufPtr;
+        md->refs = 1;
+        DLIST_MADD_AFTER(maps, md, link);
+        num_maps++;
+    }
+    pthread_mutex_unlock(&che_mutex);
+
+    if (md) map_cache_evict(false);
+}
+
+/**
+ * Releases a reference of a cached mapping.  The mapping stays
+ * mapped until it is evicted.
+ *
+ * @param bufPtr  Pointer to the mapped buffer
+ * @param ret     Pointer to the result: 0 on success, non-0
+ *                error value if the mapping had no references
+ *
+ * @return TRUE (non-0) if bufPtr is a cached mapping.
+ */
+static bool map_cache_put(void *bufPtr, int *ret)
+{
+    _MapData *md;
+
+    /* a cached mapping was added before the caller got its pointer */
+    if (!num_maps) return 0;
+
+    che_lock();
+    DLIST_MLOOP(maps, md, link) {
+        if (md->bufPtr == bufPtr) break;
+    }
+    if (md)
+    {
+        *ret = NOT_I(md->refs,>,0) ? MEMMGR_ERR_GENERIC : MEMMGR_ERR_NONE;
+        if (!*ret) md->refs--;
+    }
+    pthread_mutex_unlock(&che_mutex);
+
+    /* the cache may have been shrunk while this mapping was in use */
+    if (md && !*ret) ERR_ADD(*ret, map_cache_evict(false));
+    return md != NULL;
+}
+
+void *MemMgr_Map(MemAllocBlock blocks[], int num_blocks)
+{
+    IN;
+    uint64_t rec_start = RECORD_START();
+    void *bufPtr = NULL;
+
+    /* need to access ssptrs */
+    struct tiler_block_info *blks = (tiler_block_info *) blocks;
+
+    /* reuse the cached mapping of the same user buffers */
+    struct tiler_block_info user[TILER_MAX_NUM_BLOCKS];
+    if (blks && num_blocks > 0 && num_blocks <= TILER_MAX_NUM_BLOCKS)
+    {
+        memcpy(user, blks, sizeof(*blks) * num_blocks);
+        bufPtr = map_cache_get(blks, num_blocks);
+        if (bufPtr) goto DONE;
+    }
+
+    /* check block params, and state */
+    if (check_blocks(blks, num_blocks, 0) ||
+        NOT_I(inc_ref(),==,0)) goto DONE;
+
+    /* we only map 1D buffers, which can come from separate user
+       allocations */
+    int ix;
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        if (NOT_P(blocks[ix].ptr,!=,NULL) ||
+#ifdef STUB_TILER
+            NOT_I(is_mapped(blocks[ix].ptr),==,0) ||
+#endif
+            NOT_I(blocks[ix].pixelFormat,==,PIXEL_FMT_PAGE))
+        {
+            DP("for block[%d]", ix);
+            goto FAIL;
+        }
+    }
+
+    /* map the pages enclosing each buffer, and point the mapped blocks at
+       the buffers inside them */
+    bytes_t offsets[TILER_MAX_NUM_BLOCKS] = { 0 };
+    bytes_t lengths[TILER_MAX_NUM_BLOCKS];
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        offsets[ix] = (uint32_t) blks[ix].ptr & (PAGE_SIZE - 1);
+        lengths[ix] = blks[ix].dim.len;
+        blks[ix].ptr -= offsets[ix];
+        blks[ix].dim.len = ROUND_UP_TO2POW(offsets[ix] + lengths[ix], PAGE_SIZE);
+    }
+
+    bufPtr = map_blocks(blks, num_blocks, offsets[0]);
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        blks[ix].dim.len = lengths[ix];
+        if (bufPtr)
+        {
+            blks[ix].ptr += offsets[ix];
+            blks[ix].ssptr += offsets[ix];
+        }
+    }
+    if (bufPtr)
+    {
+        map_cache_add(bufPtr, user, blks, num_blocks);
+        goto DONE;
+    }
+
+FAIL:
+    /* clear ssptr and ptr fields for all blocks */
+    reset_blocks(blks, num_blocks);
+
+    A_I(dec_ref(),==,0);
+DONE:
+    CHK_I(cache_check(),==,0);
+    PROBE4(map, bufPtr, bufPtr ? tiler_size(blks, num_blocks) : 0,
+           num_blocks > 0 ? blks[0].fmt : TILFMT_INVALID, num_blocks);
+    RECORD(REC_MAP, bufPtr, (uintptr_t) bufPtr, blocks, num_blocks, rec_start);
+    return R_P(bufPtr);
+}
+
+void *MemMgr_MapIn2DMode(MemAllocBlock *block)
+{
+    IN;
+    uint64_t rec_start = RECORD_START();
+    void *bufPtr = NULL;
+
+    /* need to access ssptrs */
+    struct tiler_block_info *blk = (tiler_block_info *) block;
+
+    /* check block params, and state */
+    if (NOT_P(blk,!=,NULL)) goto DONE;
+    bytes_t width = blk->dim.area.width * def_bpp(blk->fmt);
+    CHK_I(blk->ssptr,==,0);
+    if (NOT_I(blk->fmt,>=,PIXEL_FMT_8BIT) ||
+        NOT_I(blk->fmt,<=,PIXEL_FMT_32BIT) ||
+        NOT_I(blk->dim.area.width,>,0) ||
+        NOT_I(blk->dim.area.height,>,0) ||
+        (blk->stride && NOT_I(blk->stride,>=,width)) ||
+        NOT_P(blk->ptr,!=,NULL) ||
+        NOT_I((uint32_t)blk->ptr & (PAGE_SIZE - 1),==,0) ||
+#ifdef STUB_TILER
+        /* the emulated tiler uses the user buffer in place, so it cannot
+           be mapped again */
+        NOT_I(is_mapped(blk->ptr),==,0) ||
+#endif
+        NOT_I(inc_ref(),==,0)) goto DONE;
+
+    if (!blk->stride) blk->stride = width;
+    bufPtr = map_blocks(blk, 1, 0);
+    if (bufPtr) goto DONE;
+
+    /* clear ssptr and ptr fields */
+    reset_blocks(blk, 1);
+
+    A_I(dec_ref(),==,0);
+DONE:
+    CHK_I(cache_check(),==,0);
+    PROBE4(map, bufPtr, bufPtr ? def_size(blk) : 0,
+           blk ? blk->fmt : TILFMT_INVALID, 1);
+    RECORD(REC_MAP, bufPtr, (uintptr_t) bufPtr, block, block ? 1 : 0,
+           rec_start);
+    return R_P(bufPtr);
+}
+
+int MemMgr_UnMap(void *bufPtr)
+{
+    IN;
+    uint64_t rec_start = RECORD_START();
+
+    /* cached mappings are only released */
+    int ret;
+    if (!map_cache_put(bufPtr, &ret)) ret = unmap_buf(bufPtr);
+
+    CHK_I(cache_check(),==,0);
+    PROBE2(unmap, bufPtr, ret);
+    RECORD(REC_UNMAP, bufPtr, ret, NULL, 0, rec_start);
+    return R_I(ret);
+}
+
+int MemMgr_SetMapCache(int max_entries)
+{
+    IN;
+    if (NOT_I(max_entries,>=,0)) return MEMMGR_ERR_GENERIC;
+
+    che_lock();
+    init();
+    max_maps = max_entries;
+    pthread_mutex_unlock(&che_mutex);
+
+    int ret = map_cache_evict(false);
+    CHK_I(cache_check(),==,0);
+    return R_I(ret);
+}
+
+int MemMgr_FlushMapCache()
+{
+    IN;
+    int ret = map_cache_evict(true);
+    CHK_I(cache_check(),==,0);
+    return R_I(ret);
+}
+
+bool MemMgr_Is1DBlock(void *ptr)
+{
+    IN;
+    uint64_t rec_start = RECORD_START();
+
+    SSPtr ssptr = virt_to_phys(ptr);
+    enum tiler_fmt fmt = tiler_get_fmt(ssptr);
+    bool res = fmt == TILFMT_PAGE;
+    RECORD(REC_IS_1D, ptr, res, NULL, 0, rec_start);
+    return R_I(res);
+}
+
+bool MemMgr_Is2DBlock(void *ptr)
+{
+    IN;
+    uint64_t rec_start = RECORD_START();
+
+    SSPtr ssptr = virt_to_phys(ptr);
+    enum tiler_fmt fmt = tiler_get_fmt(ssptr);
+    bool res = fmt == TILFMT_8BIT || fmt == TILFMT_16BIT ||
+               fmt == TILFMT_32BIT;
+    RECORD(REC_IS_2D, ptr, res, NULL, 0, rec_start);
+    return R_I(res);
+}
+
+bool MemMgr_IsMapped(void *ptr)
+{
+    IN;
+    uint64_t rec_start = RECORD_START();
+
+    bool res = is_mapped(ptr);
+    RECORD(REC_IS_MAPPED, ptr, res, NULL, 0, rec_start);
+    return R_I(res);
+}
+
+/**
+ * Returns the stride corresponding to a virtual address.  This
+ * is MemMgr_GetStride without recording the call.
+ *
+ * @param ptr    pointer to a virtual address
+ *
+ * @return The virtual stride of the block that contains the
+ *         address.
+ */
+static bytes_t get_stride(void *ptr)
 {
     IN;
 #ifndef STUB_TILER
@@ -952,7 +1701,7 @@ bytes_t MemMgr_GetStride(void *ptr)
     {
         /* get block information for the buffer */
         dump_buf(&buf, "==(QBUF)=>");
-        int ix, ret = A_I(ioctl(td, TILIOC_QBUF, &buf),==,0);
+        int ix, ret = A_I(tiler_ioctl(TILIOC_QBUF, (unsigned long) &buf),==,0);
         dump_buf(&buf, "<=(QBUF)==");
         if (ret) return 0;
 
@@ -971,7 +1720,7 @@ bytes_t MemMgr_GetStride(void *ptr)
         return R_UP(0);
     }
     /* see if pointer is valid */
-    else if (TilerMem_VirtToPhys(ptr) == 0)
+    else if (virt_to_phys(ptr) == 0)
     {
         A_I(dec_ref(),==,0);
         return R_UP(0);
@@ -979,11 +1728,11 @@ bytes_t MemMgr_GetStride(void *ptr)
     A_I(dec_ref(),==,0);
 #else
     /* if emulating, we need to get through all allocated memory segments */
-    pthread_mutex_lock(&che_mutex);
+    if (!ptr) return R_UP(0);
+    che_lock();
     init();
 
     _AllocData *ad;
-    if (!ptr) return R_UP(0);
     DLIST_MLOOP(bufs, ad, link) {
         int ix;
         struct tiler_buf_info *buf = (struct tiler_buf_info *) ad->tiler_id;
@@ -1003,6 +1752,539 @@ bytes_t MemMgr_GetStride(void *ptr)
     return R_UP(PAGE_SIZE);
 }
 
+bytes_t MemMgr_GetStride(void *ptr)
+{
+    uint64_t rec_start = RECORD_START();
+    bytes_t stride = get_stride(ptr);
+    RECORD(REC_GET_STRIDE, ptr, stride, NULL, 0, rec_start);
+    return stride;
+}
+
+/**
+ * Returns the cache mode of the block that contains an address
+ * from the records.
+ *
+ * @param ptr    Pointer to an address
+ *
+ * @return The MEMMGR_CACHE_* mode of the block, or
+ *         MEMMGR_CACHE_CACHED if the address is not in a block
+ */
+static int get_cache_mode(void *ptr)
+{
+    _AllocData *ad;
+    int ix, mode = MEMMGR_CACHE_CACHED;
+
+    che_lock();
+    init();
+    DLIST_MLOOP(bufs, ad, link) {
+        if (ad->bufPtr <= ptr && ptr < ad->bufPtr + ad->size) {
+            for (ix = 0; ix < ad->num_blocks; ix++)
+            {
+                tiler_block_info *b = ad->blocks + ix;
+                void *start = (void *) ((uint32_t) b->ptr & ~(PAGE_SIZE - 1));
+                if (start <= ptr && ptr < start + def_size(b))
+                {
+                    mode = ad->cache_modes[ix];
+                    break;
+                }
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&che_mutex);
+    return mode;
+}
+
+int MemMgr_GetCacheMode(void *ptr)
+{
+    return get_cache_mode(ptr);
+}
+
+/**
+ * Returns whether copies into a buffer should use streaming
+ * stores.  This is the case for large copies, and for copies into
+ * non-cacheable blocks (e.g. 2D blocks by default).
+ *
+ * @param dst    Pointer to the destination
+ * @param size   Number of bytes copied
+ *
+ * @return TRUE (non-0) to use streaming stores
+ */
+static int use_stream(void *dst, bytes_t size)
+{
+    return size >= COPY_STREAM_MIN ||
+           get_cache_mode(dst) != MEMMGR_CACHE_CACHED;
+}
+
+/**
+ * Returns the region of a block as rows.  2D blocks have
+ * width * bpp byte wide rows, and their stride is looked up if
+ * not set in the block.  1D blocks have stride byte wide rows,
+ * or a single row if their stride is 0.
+ *
+ * @param blk      Pointer to the block
+ * @param width    Pointer to where to store the row width in bytes
+ * @param height   Pointer to where to store the number of rows
+ * @param stride   Pointer to where to store the stride
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+static int block_rows(MemAllocBlock *blk, bytes_t *width, bytes_t *height,
+                      bytes_t *stride)
+{
+    if (NOT_P(blk,!=,NULL) || NOT_P(blk->ptr,!=,NULL) ||
+        NOT_I(blk->pixelFormat,>=,PIXEL_FMT_MIN) ||
+        NOT_I(blk->pixelFormat,<=,PIXEL_FMT_MAX))
+        return MEMMGR_ERR_GENERIC;
+
+    if (blk->pixelFormat == PIXEL_FMT_PAGE)
+    {
+        *width = *stride = blk->stride ? blk->stride : blk->dim.len;
+        *height = *width ? blk->dim.len / *width : 0;
+        return MEMMGR_ERR_NONE;
+    }
+    *width = blk->dim.area.width * def_bpp(blk->pixelFormat);
+    *height = blk->dim.area.height;
+    *stride = blk->stride ? blk->stride : get_stride(blk->ptr);
+    return NOT_I(*width,<=,*stride) ? MEMMGR_ERR_GENERIC : MEMMGR_ERR_NONE;
+}
+
+int MemMgr_Copy2D(void *dst, bytes_t dst_stride, const void *src,
+                  bytes_t src_stride, bytes_t width, bytes_t height)
+{
+    IN;
+    if (NOT_P(dst,!=,NULL) || NOT_P(src,!=,NULL) ||
+        (height > 1 && (NOT_I(width,<=,dst_stride) ||
+                        NOT_I(width,<=,src_stride))))
+        return R_I(MEMMGR_ERR_GENERIC);
+
+    Blit_Copy2D(dst, dst_stride, src, src_stride, width, height,
+                use_stream(dst, width * height));
+    return R_I(MEMMGR_ERR_NONE);
+}
+
+int MemMgr_CopyToBlock(MemAllocBlock *dst, const void *src,
+                       bytes_t src_stride)
+{
+    IN;
+    bytes_t width, height, stride;
+    int ret = block_rows(dst, &width, &height, &stride);
+    if (ret) return R_I(ret);
+
+    return R_I(MemMgr_Copy2D(dst->ptr, stride, src,
+                             src_stride ? src_stride : width, width, height));
+}
+
+int MemMgr_CopyFromBlock(void *dst, bytes_t dst_stride, MemAllocBlock *src)
+{
+    IN;
+    bytes_t width, height, stride;
+    int ret = block_rows(src, &width, &height, &stride);
+    if (ret) return R_I(ret);
+
+    return R_I(MemMgr_Copy2D(dst, dst_stride ? dst_stride : width, src->ptr,
+                             stride, width, height));
+}
+
+/**
+ * Retrieves the block information of an allocated buffer,
+ * including the address of each block, from the records.
+ *
+ * @param bufPtr   Pointer to the start of the buffer
+ * @param buf      Pointer to where to store the buffer info
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+static int get_blocks(void *bufPtr, struct tiler_buf_info *buf)
+{
+    IN;
+    _AllocData *ad;
+    int ret = MEMMGR_ERR_GENERIC;
+    ZERO(*buf);
+
+    che_lock();
+    DLIST_MLOOP(bufs, ad, link) {
+        if (ad->bufPtr == bufPtr && ad->buf_type == BUF_ALLOCED) {
+            buf->num_blocks = ad->num_blocks;
+            buf->offset = ad->tiler_id;
+            memcpy(buf->blocks, ad->blocks,
+                   sizeof(*ad->blocks) * ad->num_blocks);
+            ret = MEMMGR_ERR_NONE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&che_mutex);
+    return R_I(ret);
+}
+
+/**
+ * Retrieves the block information of the block that contains
+ * an address from the records, without calling the tiler
+ * driver.
+ *
+ * @param ptr    Pointer to an address in the block
+ * @param blk    Pointer to where to store the block info
+ *
+ * @return 0 on success, non-0 error value if the address is not
+ *         in an allocated or mapped block
+ */
+static int find_block(void *ptr, struct tiler_block_info *blk)
+{
+    IN;
+    _AllocData *ad;
+    int ix, ret = MEMMGR_ERR_GENERIC;
+
+    che_lock();
+    DLIST_MLOOP(bufs, ad, link) {
+        if (ad->bufPtr <= ptr && ptr < ad->bufPtr + ad->size) {
+            for (ix = 0; ix < ad->num_blocks; ix++)
+            {
+                tiler_block_info *b = ad->blocks + ix;
+                void *start = (void *) ((uint32_t) b->ptr & ~(PAGE_SIZE - 1));
+                if (start <= ptr && ptr < start + def_size(b))
+                {
+                    *blk = *b;
+                    ret = MEMMGR_ERR_NONE;
+                    break;
+                }
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&che_mutex);
+    return R_I(ret);
+}
+
+int MemMgr_Fill2D(void *ptr, uint32_t pattern, bytes_t width, bytes_t height)
+{
+    IN;
+    if (NOT_P(ptr,!=,NULL)) return R_I(MEMMGR_ERR_GENERIC);
+
+    bytes_t stride = height > 1 ? get_stride(ptr) : width;
+    if (NOT_I(width,<=,stride)) return R_I(MEMMGR_ERR_GENERIC);
+
+    Blit_Fill2D(ptr, stride, pattern, width, height,
+                use_stream(ptr, width * height));
+    return R_I(MEMMGR_ERR_NONE);
+}
+
+int MemMgr_ClearNV12(void *bufPtr, uint8_t y, uint8_t u, uint8_t v)
+{
+    IN;
+    struct tiler_buf_info buf;
+    uint8_t uv[4];
+    uint32_t pattern;
+    int ix, ret = get_blocks(bufPtr, &buf);
+    if (ret) return R_I(ret);
+
+    if (NOT_I(buf.num_blocks,==,2) ||
+        NOT_I(buf.blocks[0].fmt,==,TILFMT_8BIT) ||
+        NOT_I(buf.blocks[1].fmt,==,TILFMT_16BIT))
+        return R_I(MEMMGR_ERR_GENERIC);
+
+    /* UV plane is interleaved U and V bytes */
+    uv[0] = uv[2] = u;
+    uv[1] = uv[3] = v;
+    memcpy(&pattern, uv, sizeof(pattern));
+
+    for (ix = 0; ix < 2; ix++)
+    {
+        tiler_block_info *blk = buf.blocks + ix;
+        bytes_t width = blk->dim.area.width * def_bpp(blk->fmt);
+        Blit_Fill2D(blk->ptr, blk->stride, ix ? pattern : y * 0x01010101u,
+                    width, blk->dim.area.height,
+                    use_stream(blk->ptr, width * blk->dim.area.height));
+    }
+    return R_I(MEMMGR_ERR_NONE);
+}
+
+/**
+ * Translates view coordinates into natural coordinates.
+ *
+ * @param orient   View orientation
+ * @param width    Width of the view
+ * @param height   Height of the view
+ * @param x        Pointer to the column, replaced by the natural
+ *                 column
+ * @param y        Pointer to the row, replaced by the natural row
+ */
+static void view_to_natural(int orient, uint32_t width, uint32_t height,
+                            uint32_t *x, uint32_t *y)
+{
+    uint32_t vx = orient & MEMMGR_ORIENT_X_INVERT ? width - 1 - *x : *x;
+    uint32_t vy = orient & MEMMGR_ORIENT_Y_INVERT ? height - 1 - *y : *y;
+    *x = orient & MEMMGR_ORIENT_XY_FLIP ? vy : vx;
+    *y = orient & MEMMGR_ORIENT_XY_FLIP ? vx : vy;
+}
+
+#ifndef STUB_TILER
+/**
+ * Translates natural coordinates into view coordinates.
+ *
+ * @param orient   View orientation
+ * @param width    Natural width
+ * @param height   Natural height
+ * @param x        Pointer to the natural column, replaced by the
+ *                 view column
+ * @param y        Pointer to the natural row, replaced by the
+ *                 view row
+ */
+static void natural_to_view(int orient, uint32_t width, uint32_t height,
+                            uint32_t *x, uint32_t *y)
+{
+    int flip = orient & MEMMGR_ORIENT_XY_FLIP;
+    uint32_t vx = flip ? *y : *x, vy = flip ? *x : *y;
+    uint32_t vw = flip ? height : width, vh = flip ? width : height;
+    *x = orient & MEMMGR_ORIENT_X_INVERT ? vw - 1 - vx : vx;
+    *y = orient & MEMMGR_ORIENT_Y_INVERT ? vh - 1 - vy : vy;
+}
+#endif
+
+int MemMgr_GetView(void *ptr, int orient, MemMgr_View *view)
+{
+    IN;
+    tiler_block_info blk;
+
+    if (NOT_P(view,!=,NULL) || NOT_I(orient & ~7,==,0) ||
+        NOT_I(find_block(ptr, &blk),==,0) || NOT_P(blk.ptr,==,ptr) ||
+        NOT_I(blk.fmt,!=,TILFMT_PAGE))
+        return R_I(MEMMGR_ERR_GENERIC);
+
+    int flip = orient & MEMMGR_ORIENT_XY_FLIP;
+    pixels_t width = blk.dim.area.width, height = blk.dim.area.height;
+    ZERO(*view);
+    view->orient = orient;
+    view->width = flip ? height : width;
+    view->height = flip ? width : height;
+    view->block_ptr = ptr;
+    view->block_stride = blk.stride;
+    view->bpp = def_bpp(blk.fmt);
+
+    /* the tiler container of the block is transposed in XY flipped
+       views, so their stride is the container height */
+    bytes_t stride = 1 << TilerMem_StrideShift(blk.fmt);
+    uint32_t cw = stride / view->bpp, ch = TILER_LENGTH / stride;
+    view->stride = (flip ? ch : cw) * view->bpp;
+
+    if (!orient)
+    {
+        view->ptr = ptr;
+        view->ptr_stride = blk.stride;
+    }
+#ifndef STUB_TILER
+    /* every view, including the natural one, is addressed in tiler
+       space; the top-left of the view is the view corner of the block
+       closest to the container origin */
+    pixels_t bx = 0, by = 0;
+    TilerMem_SSPtrToXY(blk.ssptr, &bx, &by);
+    uint32_t x0 = bx, y0 = by, x1 = x0 + width - 1, y1 = y0 + height - 1;
+    natural_to_view(orient, cw, ch, &x0, &y0);
+    natural_to_view(orient, cw, ch, &x1, &y1);
+    if (x1 < x0) x0 = x1;
+    if (y1 < y0) y0 = y1;
+    view->ssptr = ((SSPtr) orient << TILER_ORIENT_SHIFT) |
+                  (blk.ssptr & TILER_MODE_MASK) |
+                  (y0 * view->stride + x0 * view->bpp);
+#else
+    /* there is no tiler space, so use the block pixel that the tiler
+       would read first */
+    view->ssptr = (SSPtr) MemMgr_ViewPixel(view, 0, 0);
+#endif
+    return R_I(MEMMGR_ERR_NONE);
+}
+
+int MemMgr_CreateView(void *ptr, pixels_t x, pixels_t y, pixels_t width,
+                      pixels_t height, MemMgr_View *view)
+{
+    IN;
+    tiler_block_info blk;
+
+    if (NOT_P(view,!=,NULL) ||
+        NOT_I(find_block(ptr, &blk),==,0) || NOT_P(blk.ptr,==,ptr) ||
+        NOT_I(blk.fmt,!=,TILFMT_PAGE) ||
+        NOT_I(width,>,0) || NOT_I(height,>,0) ||
+        NOT_I((uint32_t) x + width,<=,blk.dim.area.width) ||
+        NOT_I((uint32_t) y + height,<=,blk.dim.area.height))
+        return R_I(MEMMGR_ERR_GENERIC);
+
+    bytes_t bpp = def_bpp(blk.fmt);
+    ZERO(*view);
+    view->width = width;
+    view->height = height;
+    view->stride = 1 << TilerMem_StrideShift(blk.fmt);
+    view->ptr = ptr + y * blk.stride + x * bpp;
+    view->ptr_stride = blk.stride;
+    view->block_ptr = view->ptr;
+    view->block_stride = blk.stride;
+    view->bpp = bpp;
+#ifndef STUB_TILER
+    /* tiler space address of the natural view, as in MemMgr_GetView */
+    view->ssptr = (blk.ssptr & TILER_ADDR_MASK) + y * view->stride + x * bpp;
+#else
+    view->ssptr = (SSPtr) view->ptr;
+#endif
+    return R_I(MEMMGR_ERR_NONE);
+}
+
+void *MemMgr_ViewPixel(const MemMgr_View *view, pixels_t x, pixels_t y)
+{
+    if (NOT_P(view,!=,NULL) || NOT_P(view->block_ptr,!=,NULL) ||
+        NOT_I(x,<,view->width) || NOT_I(y,<,view->height))
+        return NULL;
+
+    uint32_t nx = x, ny = y;
+    view_to_natural(view->orient, view->width, view->height, &nx, &ny);
+    return view->block_ptr + ny * view->block_stride + nx * view->bpp;
+}
+
+#ifdef STUB_TILER
+/*
+ * Cache maintenance is only provided when emulating the tiler: the
+ * tiler driver has no cache maintenance call, and the cacheflush
+ * system call does not reach the outer (PL310) cache, so device builds
+ * cannot maintain cacheable memory.
+ */
+
+/**
+ * Returns the first part of a memory range that is either all
+ * cacheable, or all in non-cacheable blocks, based on the
+ * records.  Memory outside of tiler blocks is cacheable.
+ *
+ * @param ptr       Start of the range
+ * @param end       End of the range
+ * @param part_end  Pointer to where to store the end of the part
+ *
+ * @return TRUE (non-0) if the part is cacheable
+ */
+static bool cacheable_part(void *ptr, void *end, void **part_end)
+{
+    _AllocData *ad;
+    bool cacheable = 1;
+    int ix;
+
+    *part_end = end;
+    che_lock();
+    init();
+    DLIST_MLOOP(bufs, ad, link) {
+        for (ix = 0; ix < ad->num_blocks; ix++)
+        {
+            tiler_block_info *blk = ad->blocks + ix;
+            void *start = (void *) ((uint32_t) blk->ptr & ~(PAGE_SIZE - 1));
+            void *stop = start + def_size(blk);
+            if (start <= ptr && ptr < stop)
+            {
+                cacheable = ad->cache_modes[ix] == MEMMGR_CACHE_CACHED;
+                if (stop < *part_end) *part_end = stop;
+            }
+            /* part also ends where the next block starts */
+            else if (ptr < start && start < *part_end)
+            {
+                *part_end = start;
+            }
+        }
+    }
+    pthread_mutex_unlock(&che_mutex);
+    return cacheable;
+}
+
+/**
+ * Returns the data cache line size reported by the kernel, or
+ * CACHE_LINE if it is not reported.
+ *
+ * @return line size in bytes (a power of 2)
+ */
+static bytes_t cache_line()
+{
+    static bytes_t line = 0;
+    if (!line)
+    {
+        unsigned int size = 0;
+        FILE *fp = fopen(CACHE_LINE_PATH, "r");
+        if (fp)
+        {
+            if (fscanf(fp, "%u", &size) != 1) size = 0;
+            fclose(fp);
+        }
+        line = size >= 16 && size <= PAGE_SIZE && !(size & (size - 1)) ?
+               size : CACHE_LINE;
+    }
+    return line;
+}
+
+/**
+ * Performs a cache maintenance operation on a list of ranges,
+ * skipping the parts in non-cacheable blocks.  Nothing is
+ * maintained; the bytes are only counted in the statistics.
+ *
+ * @param op          CACHE_CLEAN, CACHE_INVALIDATE or CACHE_FLUSH
+ * @param ranges      Array of ranges
+ * @param num_ranges  Number of ranges
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+static int cache_maint(int op, MemMgr_Range ranges[], int num_ranges)
+{
+    IN;
+    uint64_t maintained = 0, skipped = 0;
+    int ix;
+
+    if (NOT_I(num_ranges,>=,0) || (num_ranges && NOT_P(ranges,!=,NULL)))
+        return R_I(MEMMGR_ERR_GENERIC);
+    for (ix = 0; ix < num_ranges; ix++)
+    {
+        if (ranges[ix].size && NOT_P(ranges[ix].ptr,!=,NULL))
+            return R_I(MEMMGR_ERR_GENERIC);
+    }
+
+    for (ix = 0; ix < num_ranges; ix++)
+    {
+        void *ptr = ranges[ix].ptr, *end = ptr + ranges[ix].size, *part_end;
+        for (; ptr < end; ptr = part_end)
+        {
+            if (!cacheable_part(ptr, end, &part_end))
+            {
+                skipped += part_end - ptr;
+                continue;
+            }
+
+            /* blocks are page aligned, so whole lines of the part are
+               still cacheable */
+            bytes_t line = cache_line();
+            void *start = (void *) ((uint32_t) ptr & ~(line - 1));
+            void *stop = (void *) (((uint32_t) part_end + line - 1) &
+                                   ~(line - 1));
+            maintained += stop - start;
+        }
+    }
+
+    che_lock();
+    switch (op)
+    {
+    case CACHE_CLEAN:      stats.cache_clean_bytes += maintained; break;
+    case CACHE_INVALIDATE: stats.cache_invalidate_bytes += maintained; break;
+    default:               stats.cache_flush_bytes += maintained; break;
+    }
+    stats.cache_skipped_bytes += skipped;
+    pthread_mutex_unlock(&che_mutex);
+    return R_I(MEMMGR_ERR_NONE);
+}
+
+int MemMgr_CacheClean(MemMgr_Range ranges[], int num_ranges)
+{
+    return cache_maint(CACHE_CLEAN, ranges, num_ranges);
+}
+
+int MemMgr_CacheInvalidate(MemMgr_Range ranges[], int num_ranges)
+{
+    return cache_maint(CACHE_INVALIDATE, ranges, num_ranges);
+}
+
+int MemMgr_CacheFlush(MemMgr_Range ranges[], int num_ranges)
+{
+    return cache_maint(CACHE_FLUSH, ranges, num_ranges);
+}
+#endif
+
 bytes_t TilerMem_GetStride(SSPtr ssptr)
 {
     IN;
@@ -1018,17 +2300,10 @@ bytes_t TilerMem_GetStride(SSPtr ssptr)
 
 SSPtr TilerMem_VirtToPhys(void *ptr)
 {
-#ifndef STUB_TILER
-    SSPtr ssptr = 0;
-    if(!NOT_I(inc_ref(),==,0))
-    {
-        ssptr = ioctl(td, TILIOC_GSSP, (unsigned long) ptr);
-        A_I(dec_ref(),==,0);
-    }
-    return (SSPtr)R_P(ssptr);
-#else
-    return (SSPtr)ptr;
-#endif
+    uint64_t rec_start = RECORD_START();
+    SSPtr ssptr = virt_to_phys(ptr);
+    RECORD(REC_VIRT_TO_PHYS, ptr, ssptr, NULL, 0, rec_start);
+    return ssptr;
 }
 
 /**
@@ -1075,6 +2350,7 @@ int __test__MemMgr()
 
     /* def_size */
     tiler_block_info blk;
+    ZERO(blk);
     blk.fmt = TILFMT_8BIT;
     blk.dim.area.width = PAGE_SIZE * 8 / 10;
     blk.dim.area.height = 10;
@@ -1093,3 +2369,43 @@ int __test__MemMgr()
 
     return ret;
 }
+
+/**
+ * Internal Unit Test of the consistency checks.  Makes the
+ * buffer count disagree with the reference count, and with the
+ * number of buffer records, and verifies that cache_check
+ * reports it at each check level that checks it.  Assumes that
+ * no buffers are allocated or mapped, and restores the check
+ * level.
+ *
+ * @return 0 for success, non-0 error value for failure.
+ */
+int __test__CacheCheck()
+{
+    int ret = 0, level, interval, saved = MemMgr_GetCheckLevel(&interval);
+
+    for (level = MEMMGR_CHECK_OFF; level <= MEMMGR_CHECK_FULL; level++)
+    {
+        ret |= NOT_I(MemMgr_SetCheckLevel(level, 1),==,0);
+        ret |= NOT_I(cache_check(),==,0);
+
+        /* a reference without a buffer */
+        ret |= NOT_I(inc_ref(),==,0);
+        ret |= NOT_I(cache_check() != 0,==,level != MEMMGR_CHECK_OFF);
+
+        /* a buffer without a record */
+        che_lock();
+        num_bufs++;
+        pthread_mutex_unlock(&che_mutex);
+        ret |= NOT_I(cache_check() != 0,==,level == MEMMGR_CHECK_FULL);
+        che_lock();
+        num_bufs--;
+        pthread_mutex_unlock(&che_mutex);
+
+        ret |= NOT_I(dec_ref(),==,0);
+        ret |= NOT_I(cache_check(),==,0);
+    }
+
+    ret |= NOT_I(MemMgr_SetCheckLevel(saved, interval),==,0);
+    return ret;
+}
@@ -101,6 +101,61 @@ struct MemAllocBlock {
 
 typedef struct MemAllocBlock MemAllocBlock;
 
+/* consistency check levels */
+#define MEMMGR_CHECK_OFF   0  /* no checks */
+#define MEMMGR_CHECK_COUNT 1  /* compare buffer count with reference count */
+#define MEMMGR_CHECK_FULL  2  /* also verify buffer count by walking the
+                                 buffer list at the check interval */
+
+/* cache modes of blocks */
+#define MEMMGR_CACHE_DEFAULT  0  /* uncached for 2D, cached for 1D blocks */
+#define MEMMGR_CACHE_CACHED   1  /* cacheable (write-back) */
+#define MEMMGR_CACHE_WC       2  /* non-cacheable, write-combined */
+#define MEMMGR_CACHE_UNCACHED 3  /* non-cacheable, non-bufferable */
+
+/* view orientations of 2D blocks.  A view is the block transformed by
+   an optional transpose (XY_FLIP) followed by inversions of the view's
+   own x and y axes. */
+#define MEMMGR_ORIENT_X_INVERT 1  /* mirror horizontally */
+#define MEMMGR_ORIENT_Y_INVERT 2  /* mirror vertically */
+#define MEMMGR_ORIENT_XY_FLIP  4  /* swap the x and y axes */
+
+/* clockwise rotations */
+#define MEMMGR_ROTATE_0   0
+#define MEMMGR_ROTATE_90  (MEMMGR_ORIENT_XY_FLIP | MEMMGR_ORIENT_X_INVERT)
+#define MEMMGR_ROTATE_180 (MEMMGR_ORIENT_X_INVERT | MEMMGR_ORIENT_Y_INVERT)
+#define MEMMGR_ROTATE_270 (MEMMGR_ORIENT_XY_FLIP | MEMMGR_ORIENT_Y_INVERT)
+
+/**
+ * Orientation or sub-rectangle view of a 2D block, as filled
+ * out by MemMgr_GetView() or MemMgr_CreateView().
+ *
+ * ssptr is the tiler space address of the view, with the
+ * orientation in bits 31-29, as used by tiler clients such as
+ * the display controller.  This holds for every view, including
+ * the natural one (orientation 0), so it is never an address in
+ * the system space alias of the tiler (TILER_MEM_8BIT and up)
+ * that TilerMem_VirtToPhys() returns.
+ */
+struct MemMgr_View {
+    int      orient;      /* MEMMGR_ORIENT_* flags */
+    pixels_t width;       /* width of view (block height if XY flipped) */
+    pixels_t height;      /* height of view (block width if XY flipped) */
+    SSPtr    ssptr;       /* tiler address of the top-left pixel of view */
+    bytes_t  stride;      /* tiler stride of view */
+    void    *ptr;         /* mapped address of view, or NULL if the view
+                             is not mapped */
+    bytes_t  ptr_stride;  /* stride of mapped view, or 0 */
+
+    /* natural view of block, or of the sub-rectangle (used by
+       MemMgr_ViewPixel) */
+    void    *block_ptr;
+    bytes_t  block_stride;
+    bytes_t  bpp;
+};
+
+typedef struct MemMgr_View MemMgr_View;
+
 /**
  * Returns the page size.  This is required for allocating 1D
  * blocks that stack under any other blocks.
@@ -111,6 +166,112 @@ typedef struct MemAllocBlock MemAllocBlock;
  */
 bytes_t MemMgr_PageSize();
 
+/**
+ * Sets how thoroughly the allocator checks the consistency of
+ * its buffer records after each MemMgr_Alloc, MemMgr_Free,
+ * MemMgr_Map and MemMgr_UnMap call.  MEMMGR_CHECK_OFF and
+ * MEMMGR_CHECK_COUNT cost O(1).  MEMMGR_CHECK_FULL also walks
+ * all buffer records on every interval-th check.
+ * <p>
+ * The default is MEMMGR_CHECK_COUNT, or what is specified by
+ * the MEMMGR_CHECK environment variable, e.g. "full,100".
+ * Checks only run in builds with assertions enabled.
+ *
+ * @param level     MEMMGR_CHECK_OFF, MEMMGR_CHECK_COUNT or
+ *                  MEMMGR_CHECK_FULL
+ * @param interval  Number of checks between full checks.  Must
+ *                  be positive.
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_SetCheckLevel(int level, int interval);
+
+/**
+ * Returns the consistency check level set by
+ * MemMgr_SetCheckLevel() or the MEMMGR_CHECK environment
+ * variable, e.g. to restore it after a temporary change.
+ *
+ * @param interval  Pointer to where to store the number of
+ *                  checks between full checks, or NULL
+ *
+ * @return MEMMGR_CHECK_OFF, MEMMGR_CHECK_COUNT or
+ *         MEMMGR_CHECK_FULL
+ */
+int MemMgr_GetCheckLevel(int *interval);
+
+/**
+ * Memory Allocator statistics
+ */
+struct MemMgr_Stats {
+    uint32_t lock_acquires;    /* number of buffer record lock
+                                  acquisitions */
+    uint32_t lock_contentions; /* number of acquisitions that had to
+                                  wait for another thread */
+    uint64_t lock_wait_ns;     /* total time spent waiting for the
+                                  buffer record lock */
+    /* cache maintenance, only counted when emulating the tiler */
+    uint64_t cache_clean_bytes;      /* bytes cleaned by MemMgr_CacheClean */
+    uint64_t cache_invalidate_bytes; /* bytes invalidated by
+                                        MemMgr_CacheInvalidate */
+    uint64_t cache_flush_bytes;      /* bytes flushed by MemMgr_CacheFlush */
+    uint64_t cache_skipped_bytes;    /* bytes of non-cacheable 2D blocks
+                                        skipped by cache maintenance */
+    uint32_t map_cache_hits;      /* MemMgr_Map calls that reused a cached
+                                     mapping */
+    uint32_t map_cache_misses;    /* MemMgr_Map calls that missed the
+                                     enabled map cache */
+    uint32_t map_cache_evictions; /* cached mappings unmapped on eviction
+                                     or flush */
+};
+
+typedef struct MemMgr_Stats MemMgr_Stats;
+
+/**
+ * Memory range for cache maintenance (emulated tiler only)
+ */
+struct MemMgr_Range {
+    void    *ptr;   /* start of range */
+    bytes_t  size;  /* size of range in bytes */
+};
+
+typedef struct MemMgr_Range MemMgr_Range;
+
+/**
+ * Retrieves the statistics of the allocator since the last
+ * reset, and optionally resets them.  The statistics are
+ * process wide.
+ *
+ * @param stats   Pointer to the statistics to fill out
+ * @param reset   TRUE (non-0) to reset the statistics
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_GetStats(MemMgr_Stats *stats, bool reset);
+
+/**
+ * Starts recording every public MemMgr API call into a binary
+ * trace file, with its time stamp, thread, block layouts,
+ * duration and result.  Recording also starts when the library
+ * is loaded if the MEMMGR_RECORD environment variable is set to
+ * the trace file path.
+ * <p>
+ * Use memmgr_replay to replay the trace.
+ *
+ * @param path   Path to the trace file
+ *
+ * @return 0 on success.  Non-0 error value on failure, e.g. if
+ *         already recording.
+ */
+int MemMgr_StartRecording(const char *path);
+
+/**
+ * Stops recording API calls, and closes the trace file.
+ *
+ * @return 0 on success.  Non-0 error value on failure, e.g. if
+ *         not recording.
+ */
+int MemMgr_StopRecording();
+
 /**
  * Allocates a buffer as a list of blocks (1D or 2D), and maps
  * them so that they are packaged consecutively. Returns the
@@ -123,7 +284,7 @@ bytes_t MemMgr_PageSize();
  * method.
  * <p>
  * 2D blocks will be non-cacheable, while 1D blocks will be
- * cacheable.
+ * cacheable.  Use MemMgr_AllocEx() to request other cache modes.
  * <p>
  * On success, the buffer is registered with the memory
  * allocator.
@@ -147,6 +308,42 @@ bytes_t MemMgr_PageSize();
  */
 void *MemMgr_Alloc(MemAllocBlock blocks[], int num_blocks);
 
+/**
+ * Allocates a buffer as MemMgr_Alloc(), and requests a cache
+ * mode for each block.  The allocation fails if a block cannot
+ * be mapped in the requested mode.  Use MemMgr_GetCacheMode()
+ * to get the mode of a block.
+ * <p>
+ * NOTE: the tiler driver has no interface for choosing the
+ * mapping attributes, so blocks can only be mapped in their
+ * default mode: uncached for 2D, and cached for 1D blocks.  The
+ * emulated tiler follows the same defaults.  Requesting any
+ * other mode fails.
+ *
+ * @param blocks       Block specification information, as for
+ *                     MemMgr_Alloc()
+ * @param num_blocks   Number of blocks
+ * @param cache_modes  Array of num_blocks MEMMGR_CACHE_* modes,
+ *                     or NULL for the default modes
+ *
+ * @return Pointer to the buffer, which is also the pointer to
+ *         the first allocated block. NULL if allocation failed,
+ *         e.g. if a mode cannot be honored.
+ */
+void *MemMgr_AllocEx(MemAllocBlock blocks[], int num_blocks,
+                     const int cache_modes[]);
+
+/**
+ * Returns the cache mode of the block that contains an address.
+ *
+ * @param ptr    Pointer to a virtual address
+ *
+ * @return The MEMMGR_CACHE_* mode of the block (never
+ *         MEMMGR_CACHE_DEFAULT), or MEMMGR_CACHE_CACHED for
+ *         addresses that are not in a tiler buffer.
+ */
+int MemMgr_GetCacheMode(void *ptr);
+
 /**
  * Frees a buffer allocated by MemMgr_Alloc(). It fails for
  * any buffer not allocated by MemMgr_Alloc() or one that has
@@ -175,10 +372,16 @@ int MemMgr_Free(void *bufPtr);
  * you cannot map a buffer that is already mapped to tiler, e.g.
  * a buffer pointer returned by this method.
  *
- * In phase 1 and 2, the supported configurations are:
+ * The supported configurations are:
  * <ol>
- * <li> Mapping exactly one 1D block to tiler space (e.g.
+ * <li> Mapping one 1D block to tiler space (e.g.
  * MapIn1DMode).
+ * <li> Mapping up to TILER_MAX_NUM_BLOCKS 1D blocks, e.g. the
+ * planes of a frame from separate user allocations, into one
+ * consecutive buffer with one call.  The buffer is unmapped
+ * with one MemMgr_UnMap() call.  If any block cannot be
+ * mapped, the blocks already mapped are unmapped, and no block
+ * stays mapped.
  * </ol>
  *
  * @author a0194118 (9/3/2009)
@@ -190,8 +393,11 @@ int MemMgr_Free(void *bufPtr);
  *                   These will be updated with the mapped
  *                   addresses of these blocks on success.
  *
- *                   Each block must be page aligned.  Length of
- *                   each block also must be page aligned.
+ *                   Blocks need not be page aligned.  The pages
+ *                   enclosing each block are mapped one after
+ *                   the other, and the mapped address of each
+ *                   block keeps that block's own offset within
+ *                   its first page.
  *
  * @param num_blocks Number of blocks to be included in the
  *                   mapped memory segment
@@ -201,12 +407,41 @@ int MemMgr_Free(void *bufPtr);
  */
 void *MemMgr_Map(MemAllocBlock blocks[], int num_blocks);
 
+/**
+ * Maps a user provided frame to the tiler space as a 2D block
+ * without copying it, e.g. so that hardware can use 2D tiler
+ * addressing on frames received in ordinary user memory.  Use
+ * MemMgr_UnMap() to unmap the block.
+ * <p>
+ * NOTE: on the device, this needs a tiler driver that can map
+ * user memory into 2D containers; drivers that only map 1D
+ * blocks fail the call.  The emulated tiler uses the user
+ * buffer in place, with the user stride, so a buffer cannot be
+ * mapped into 2D mode more than once at a time.
+ *
+ * @param block  Block specification information.  pixelFormat
+ *               must be a 2D format.  dim.area gives the size
+ *               of the frame in pixels.  stride is the user
+ *               stride in bytes, or 0 if the rows are packed.
+ *               ptr must contain the page aligned user buffer.
+ *               On success, ptr and stride are updated to the
+ *               mapped address and stride of the block, and
+ *               reserved to its system space address.
+ *
+ * @return Pointer to the mapped block. NULL if mapping failed.
+ */
+void *MemMgr_MapIn2DMode(MemAllocBlock *block);
+
 /**
  * This function unmaps the user provided data buffer from tiler
  * space that was mapped to the tiler space in paged mode using
  * MemMgr_Map().  It also unmaps the buffer itself from the
  * process space.  Trying to unmap a previously unmapped buffer
  * will fail.
+ * <p>
+ * If the buffer is in the map cache, this only releases the
+ * reference taken by MemMgr_Map(), and the buffer stays mapped
+ * until it is evicted.
  *
  * @author a0194118 (9/1/2009)
  *
@@ -217,6 +452,37 @@ void *MemMgr_Map(MemAllocBlock blocks[], int num_blocks);
  */
 int MemMgr_UnMap(void *bufPtr);
 
+/**
+ * Sets the size of the map cache.  The map cache keeps the
+ * mappings of up to max_entries sets of user buffers after
+ * they are unmapped.  A MemMgr_Map() call with the same user
+ * buffers (pixel format, ptr and length of each block) returns
+ * the cached mapping with another reference, instead of mapping
+ * the buffers again.  Mappings without references are unmapped,
+ * least recently used first, when the cache exceeds its size.
+ * <p>
+ * The map cache is disabled by default (0 entries).  Shrinking
+ * the cache unmaps the idle mappings over the new size.
+ * MemMgr_MapIn2DMode() mappings are not cached.
+ * <p>
+ * :NOTE: cached mappings keep the user buffers pinned in tiler
+ * space, so call MemMgr_FlushMapCache() before freeing or
+ * reusing the memory of a cached user buffer.
+ *
+ * @param max_entries  Maximum number of cached mappings, or 0
+ *                     to disable the cache
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_SetMapCache(int max_entries);
+
+/**
+ * Unmaps all cached mappings that have no references.
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_FlushMapCache();
+
 /**
  * Checks if a given virtual address is mapped by tiler manager
  * to tiler space.
@@ -304,4 +570,211 @@ bool MemMgr_Is2DBlock(void *ptr);
  */
 bytes_t MemMgr_GetStride(void *ptr);
 
+
+/**
+ * Copies a 2D region between two buffers, e.g. between a linear
+ * frame and a tiler 2D block.  Rows are copied using SIMD
+ * kernels.  Copies into tiler buffers, and large copies, use
+ * streaming stores that do not read the destination into the
+ * cache, and the rows of large regions are copied by multiple
+ * threads.
+ *
+ * @param dst          Pointer to the first destination row
+ * @param dst_stride   Destination stride in bytes
+ * @param src          Pointer to the first source row
+ * @param src_stride   Source stride in bytes
+ * @param width        Row width in bytes.  Must not be more than
+ *                     either stride, unless height is 1.
+ * @param height       Number of rows
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_Copy2D(void *dst, bytes_t dst_stride, const void *src,
+                  bytes_t src_stride, bytes_t width, bytes_t height);
+
+/**
+ * Copies a linear frame into a block.  The size of the region
+ * is the size of the block: width * bpp bytes by height rows for
+ * 2D blocks, and length bytes for 1D blocks (split into stride
+ * sized rows if stride is set).  If the stride of a 2D block is
+ * 0, it is looked up as by MemMgr_GetStride().
+ *
+ * @param dst          Pointer to the destination block
+ *                     specification (e.g. as filled out by
+ *                     MemMgr_Alloc)
+ * @param src          Pointer to the first source row
+ * @param src_stride   Source stride in bytes, or 0 if the rows
+ *                     are packed
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_CopyToBlock(MemAllocBlock *dst, const void *src,
+                       bytes_t src_stride);
+
+/**
+ * Copies a block into a linear frame.  The size of the region
+ * is the size of the block, as for MemMgr_CopyToBlock().
+ *
+ * @param dst          Pointer to the first destination row
+ * @param dst_stride   Destination stride in bytes, or 0 if the
+ *                     rows are packed
+ * @param src          Pointer to the source block specification
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_CopyFromBlock(void *dst, bytes_t dst_stride, MemAllocBlock *src);
+
+/**
+ * Fills a 2D region of a buffer with a 32-bit pattern, e.g. to
+ * clear a frame.  The stride is looked up as by
+ * MemMgr_GetStride(), and the stride padding is not written.
+ * Each row is filled as if the pattern were stored at every 4
+ * bytes from the start of the row, so the last pattern of a row
+ * may be partial.  Rows are filled using vector stores, as by
+ * MemMgr_Copy2D().
+ * <p>
+ * E.g. use 0x80808080 for an 8-bit gray block, or a repeated
+ * 32-bit pixel for a 32-bit block.
+ *
+ * @param ptr      Pointer to the first row
+ * @param pattern  Fill pattern (in native byte order)
+ * @param width    Row width in bytes.  Must not be more than the
+ *                 stride, unless height is 1.
+ * @param height   Number of rows
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_Fill2D(void *ptr, uint32_t pattern, bytes_t width, bytes_t height);
+
+/**
+ * Clears an NV12 buffer allocated by MemMgr_Alloc() (an 8-bit
+ * Y block followed by a 16-bit interleaved UV block) to a color,
+ * e.g. to black (16, 128, 128).  The stride padding is not
+ * written.
+ *
+ * @param bufPtr   Pointer to the buffer returned by
+ *                 MemMgr_Alloc()
+ * @param y        Luma value
+ * @param u        Cb value
+ * @param v        Cr value
+ *
+ * @return 0 on success.  Non-0 error value on failure, e.g. if
+ *         the buffer is not an NV12 buffer.
+ */
+int MemMgr_ClearNV12(void *bufPtr, uint8_t y, uint8_t u, uint8_t v);
+
+/**
+ * Returns an orientation view of a 2D block allocated by
+ * MemMgr_Alloc(): its tiler address and stride, and its size.
+ * Views of the same block share its memory, so e.g. a frame can
+ * be displayed rotated by passing the ssptr and stride of its
+ * rotated view to the display, without copying the frame.
+ * <p>
+ * Only the natural view (MEMMGR_ROTATE_0) is mapped into the
+ * process.  For the other views, use MemMgr_ViewPixel() to
+ * access the pixels of the view through the natural mapping.
+ * <p>
+ * NOTE: when emulating the tiler, there is no tiler space.  The
+ * ssptr of a view is the virtual address of the block pixel at
+ * the top-left of the view, and stride is the stride the tiler
+ * would use for the view.
+ *
+ * @param ptr      Pointer to the start of the 2D block
+ * @param orient   Orientation of the view (MEMMGR_ORIENT_* flags
+ *                 or a MEMMGR_ROTATE_* value)
+ * @param view     Pointer to where to store the view
+ *
+ * @return 0 on success.  Non-0 error value on failure, e.g. if
+ *         ptr is not the start of an allocated 2D block.
+ */
+int MemMgr_GetView(void *ptr, int orient, MemMgr_View *view);
+
+/**
+ * Returns a view of a sub-rectangle of a 2D block allocated by
+ * MemMgr_Alloc(), e.g. for cropping or letterboxing: the mapped
+ * address, tiler address and strides of its top-left pixel.
+ * The rectangle is validated against the block layout saved at
+ * allocation, so this makes no tiler driver calls and maps
+ * nothing.  The view is valid until the buffer is freed.
+ *
+ * @param ptr      Pointer to the start of the 2D block
+ * @param x        Left column of the rectangle
+ * @param y        Top row of the rectangle
+ * @param width    Width of the rectangle in pixels
+ * @param height   Height of the rectangle in pixels
+ * @param view     Pointer to where to store the view
+ *
+ * @return 0 on success.  Non-0 error value on failure, e.g. if
+ *         the rectangle is empty or not inside the block.
+ */
+int MemMgr_CreateView(void *ptr, pixels_t x, pixels_t y, pixels_t width,
+                      pixels_t height, MemMgr_View *view);
+
+/**
+ * Returns the address of a pixel of a view in the natural
+ * mapping of its block.  This translates view coordinates the
+ * same way as the tiler does for the ssptr of the view.
+ *
+ * @param view     Pointer to the view filled out by
+ *                 MemMgr_GetView()
+ * @param x        Column of the pixel in the view
+ * @param y        Row of the pixel in the view
+ *
+ * @return Pointer to the pixel, or NULL if (x, y) is outside
+ *         the view.
+ */
+void *MemMgr_ViewPixel(const MemMgr_View *view, pixels_t x, pixels_t y);
+
+#ifdef STUB_TILER
+/*
+ * The cache maintenance functions are only provided when emulating
+ * the tiler.  The tiler driver has no cache maintenance call, and
+ * user space cannot maintain the outer (L2) cache, so device builds
+ * do not export them.
+ */
+
+/**
+ * Cleans (writes back) the data cache lines of a list of
+ * ranges, e.g. before a remote core or DMA reads a buffer that
+ * was written by the CPU.  Ranges are extended to whole cache
+ * lines.  Parts of the ranges that lie in 2D blocks are skipped,
+ * as 2D blocks are mapped non-cacheable.
+ * <p>
+ * NOTE: nothing is maintained, but the bytes that would be
+ * (using the cache line size reported by the kernel) are
+ * counted in MemMgr_Stats.
+ *
+ * @param ranges      Array of ranges
+ * @param num_ranges  Number of ranges
+ *
+ * @return 0 on success.  Non-0 error value on failure, e.g. if
+ *         a non-empty range has a NULL pointer.
+ */
+int MemMgr_CacheClean(MemMgr_Range ranges[], int num_ranges);
+
+/**
+ * Invalidates the data cache lines of a list of ranges, e.g.
+ * before the CPU reads a buffer written by a remote core or
+ * DMA.  Ranges are handled as by MemMgr_CacheClean().
+ *
+ * @param ranges      Array of ranges
+ * @param num_ranges  Number of ranges
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_CacheInvalidate(MemMgr_Range ranges[], int num_ranges);
+
+/**
+ * Cleans and invalidates the data cache lines of a list of
+ * ranges, e.g. for buffers that are both read and written by a
+ * remote core.  Ranges are handled as by MemMgr_CacheClean().
+ *
+ * @param ranges      Array of ranges
+ * @param num_ranges  Number of ranges
+ *
+ * @return 0 on success.  Non-0 error value on failure.
+ */
+int MemMgr_CacheFlush(MemMgr_Range ranges[], int num_ranges);
+#endif
+
 #endif
@@ -0,0 +1,1471 @@
+/*
+ *  memmgr_bench.c
+ *
+ *  Memory Allocator performance benchmarks.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* retrieve type definitions */
+#define __DEBUG__
+#undef __DEBUG_ENTRY__
+#define __DEBUG_ASSERT__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include <utils.h>
+#include <debug_utils.h>
+#include <memmgr.h>
+#include <tilermem.h>
+#include <tilermem_utils.h>
+#include <benchlib.h>
+
+#ifdef STUB_TILER
+#define BACKEND "stub"
+#else
+#define BACKEND "tiler"
+#endif
+
+/* default number of operations per case */
+#define DEF_ITERATIONS 1000
+
+/* resolutions used by memmgr_test */
+static const struct {
+    pixels_t width, height;
+} res[] = {
+    {   64,   64 },
+    {  176,  144 },
+    {  640,  480 },
+    {  848,  480 },
+    { 1280,  720 },
+    { 1920, 1080 },
+};
+
+#define NUM_RES (sizeof(res) / sizeof(*res))
+
+/* star suite settings */
+#define STAR_SEED        0x4B72316A
+#define STAR_SLOTS       10
+#define STAR_MAX_THREADS 16
+
+/* lookup suite settings */
+#define LOOKUP_MAX_BUFS  512
+#define LOOKUP_COUNTS    10    /* 1, 2, 4, .. LOOKUP_MAX_BUFS */
+#define LOOKUP_PLOT_COLS 60
+
+/* exhaust suite settings */
+#define EXHAUST_MAX_BUFS 4096
+#define EXHAUST_FAILS    100   /* failed allocations timed at exhaustion */
+#define EXHAUST_WINDOW   16    /* alloc+free cycles per throughput window */
+#define EXHAUST_WINDOWS  32
+#define EXHAUST_RECOVERY 90    /* % of the empty container throughput */
+
+/* copy and fill suite settings */
+#define COPY_ITERATIONS  100
+
+/* cache suite settings */
+#define CACHE_RANGES     16    /* ranges per batched call */
+
+/**
+ * Sets up a 1D block specification.
+ *
+ * @param blk      Pointer to the block
+ * @param length   Buffer length
+ * @param ptr      Buffer pointer (NULL for allocation)
+ */
+static void set_1D(MemAllocBlock *blk, bytes_t length, void *ptr)
+{
+    memset(blk, 0, sizeof(*blk));
+    blk->pixelFormat = PIXEL_FMT_PAGE;
+    blk->dim.len = length;
+    blk->ptr = ptr;
+}
+
+/**
+ * Sets up a 2D block specification.
+ *
+ * @param blk      Pointer to the block
+ * @param width    Buffer width
+ * @param height   Buffer height
+ * @param fmt      Pixel format
+ */
+static void set_2D(MemAllocBlock *blk, pixels_t width, pixels_t height,
+                   pixel_fmt_t fmt)
+{
+    memset(blk, 0, sizeof(*blk));
+    blk->pixelFormat = fmt;
+    blk->dim.area.width = width;
+    blk->dim.area.height = height;
+}
+
+/**
+ * Measures alloc+free cycles of a buffer.
+ *
+ * @param name        Case name
+ * @param blks        Block specification
+ * @param num_blocks  Number of blocks
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_alloc(const char *name, MemAllocBlock *blks, int num_blocks)
+{
+    BenchLib_Samples s;
+    MemAllocBlock tmp[2];
+    uint32_t ix, n = BenchLib_Iterations(DEF_ITERATIONS);
+    int ret = 0;
+
+    if (NOT_I(BenchLib_InitSamples(&s, n),==,0)) return 1;
+
+    uint64_t start = BenchLib_Now();
+    for (ix = 0; ix < n && !ret; ix++)
+    {
+        memcpy(tmp, blks, sizeof(*blks) * num_blocks);
+        uint64_t t = BenchLib_Now();
+        void *bufPtr = MemMgr_Alloc(tmp, num_blocks);
+        if (NOT_P(bufPtr,!=,NULL)) ret = 1;
+        else ret = NOT_I(MemMgr_Free(bufPtr),==,0);
+        BenchLib_AddSample(&s, BenchLib_Now() - t);
+    }
+    if (!ret) BenchLib_Report("alloc", name, 1, &s, BenchLib_Now() - start);
+
+    BenchLib_FreeSamples(&s);
+    return ret;
+}
+
+/**
+ * Measures alloc+free cycles of 1D, 2D and NV12 buffers at each
+ * resolution.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int alloc_suite()
+{
+    MemAllocBlock blks[2];
+    char name[64];
+    int ix, ret = 0;
+
+    for (ix = 0; ix < NUM_RES; ix++)
+    {
+        pixels_t w = res[ix].width, h = res[ix].height;
+
+        set_1D(blks, w * h * 2, NULL);
+        sprintf(name, "1D %ux%ux2", w, h);
+        ret |= bench_alloc(name, blks, 1);
+
+        set_2D(blks, w, h, PIXEL_FMT_8BIT);
+        sprintf(name, "2D 8bit %ux%u", w, h);
+        ret |= bench_alloc(name, blks, 1);
+
+        set_2D(blks, w, h, PIXEL_FMT_16BIT);
+        sprintf(name, "2D 16bit %ux%u", w, h);
+        ret |= bench_alloc(name, blks, 1);
+
+        set_2D(blks, w, h, PIXEL_FMT_32BIT);
+        sprintf(name, "2D 32bit %ux%u", w, h);
+        ret |= bench_alloc(name, blks, 1);
+
+        set_2D(blks, w, h, PIXEL_FMT_8BIT);
+        set_2D(blks + 1, w >> 1, h >> 1, PIXEL_FMT_16BIT);
+        sprintf(name, "NV12 %ux%u", w, h);
+        ret |= bench_alloc(name, blks, 2);
+    }
+    return ret;
+}
+
+/* map suite cases */
+enum map_method {
+    MAP_ALIGNED,     /* page aligned user buffer */
+    MAP_UNALIGNED,   /* user buffer at a sub-page offset */
+    MAP_BOUNCE       /* copy of the unaligned buffer into an aligned one */
+};
+
+static const char *map_names[] = { "", "unaligned ", "bounce " };
+
+/**
+ * Measures map+unmap cycles of user buffers of the 1D buffer
+ * size at each resolution: page aligned, at a sub-page offset
+ * with an unaligned length, and copied from the unaligned
+ * buffer into a page aligned bounce buffer before mapping.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int map_suite()
+{
+    BenchLib_Samples s;
+    MemAllocBlock blk;
+    char name[64];
+    uint32_t i, n = BenchLib_Iterations(DEF_ITERATIONS);
+    int ix, m, ret = 0;
+
+    for (ix = 0; ix < NUM_RES && !ret; ix++)
+    {
+        bytes_t size = res[ix].width * res[ix].height * 2;
+        bytes_t length = ROUND_UP_TO2POW(size, PAGE_SIZE);
+        void *buffer = malloc(2 * (length + PAGE_SIZE));
+        if (NOT_P(buffer,!=,NULL)) return 1;
+        void *dataPtr = (void *) ROUND_UP_TO2POW((uintptr_t) buffer, PAGE_SIZE);
+        void *srcPtr = (uint8_t *) dataPtr + length + 64;
+        memset(srcPtr, 0x5A, size);
+
+        for (m = MAP_ALIGNED; m <= MAP_BOUNCE && !ret; m++)
+        {
+            if (NOT_I(BenchLib_InitSamples(&s, n),==,0))
+            {
+                FREE(buffer);
+                return 1;
+            }
+
+            uint64_t start = BenchLib_Now();
+            for (i = 0; i < n && !ret; i++)
+            {
+                if (m == MAP_UNALIGNED) set_1D(&blk, size, srcPtr);
+                else set_1D(&blk, length, dataPtr);
+                uint64_t t = BenchLib_Now();
+                if (m == MAP_BOUNCE) memcpy(dataPtr, srcPtr, size);
+                void *bufPtr = MemMgr_Map(&blk, 1);
+                if (NOT_P(bufPtr,!=,NULL)) ret = 1;
+                else ret = NOT_I(MemMgr_UnMap(bufPtr),==,0);
+                BenchLib_AddSample(&s, BenchLib_Now() - t);
+            }
+            sprintf(name, "%s1D %ux%ux2", map_names[m], res[ix].width,
+                    res[ix].height);
+            if (!ret) BenchLib_Report("map", name, 1, &s, BenchLib_Now() - start);
+
+            BenchLib_FreeSamples(&s);
+        }
+        FREE(buffer);
+    }
+    return ret;
+}
+
+/* buffer slot of a star worker */
+struct star_slot {
+    int           op;         /* 0: map, 1: 1D, 2-4: 8/16/32-bit 2D */
+    int           num_blocks;
+    uint32_t      val;        /* fill seed */
+    void         *bufPtr;
+    void         *buffer;     /* user buffer for maps */
+    MemAllocBlock blks[2];
+};
+
+/* state of a star worker thread */
+struct star_worker {
+    pthread_t        thread;
+    uint32_t         seed;        /* PRNG state */
+    uint32_t         num_ops;     /* operations to perform */
+    uint32_t         failed;      /* failed allocations and maps */
+    int              res;         /* result */
+    BenchLib_Samples s;
+    struct star_slot slots[STAR_SLOTS];
+};
+
+/**
+ * Returns the next value of a per-thread xorshift PRNG.  Unlike
+ * rand(), this keeps each worker's operation sequence
+ * deterministic regardless of thread scheduling.
+ *
+ * @param seed   Pointer to the PRNG state
+ *
+ * @return pseudo random value
+ */
+static uint32_t star_rand(uint32_t *seed)
+{
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *seed = x;
+}
+
+/**
+ * Fills or checks the rows of the blocks of a buffer with a
+ * pattern derived from the slot's fill seed.
+ *
+ * @param slot   Pointer to the slot
+ * @param check  TRUE to check the pattern, FALSE to fill
+ *
+ * @return number of mismatching words
+ */
+static uint32_t star_fill(struct star_slot *slot, int check)
+{
+    uint32_t errs = 0, row, i, rows, words, stride, v = slot->val;
+    int b;
+
+    for (b = 0; b < slot->num_blocks; b++)
+    {
+        MemAllocBlock *blk = slot->blks + b;
+        if (blk->pixelFormat == PIXEL_FMT_PAGE)
+        {
+            rows = 1;
+            words = blk->dim.len / 4;
+            stride = 0;
+        }
+        else
+        {
+            rows = blk->dim.area.height;
+            words = blk->dim.area.width * (blk->pixelFormat == PIXEL_FMT_8BIT ? 1 :
+                                           blk->pixelFormat == PIXEL_FMT_16BIT ? 2 : 4) / 4;
+            stride = blk->stride;
+        }
+        for (row = 0; row < rows; row++)
+        {
+            uint32_t *p = (uint32_t *) ((uint8_t *) blk->ptr + row * stride);
+            for (i = 0; i < words; i++, v += 0x9E3779B9)
+            {
+                if (!check) p[i] = v;
+                else errs += p[i] != v;
+            }
+        }
+    }
+    return errs;
+}
+
+/**
+ * Allocates or maps a buffer for a slot using the operation mix
+ * of star_test in memmgr_test.
+ *
+ * @param w      Pointer to the worker
+ * @param slot   Pointer to the slot
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int star_get(struct star_worker *w, struct star_slot *slot)
+{
+    uint32_t op = star_rand(&w->seed);
+    pixels_t width = 64, height = 64;
+
+    switch ("AAAABBBBCCCDDEEF"[op & 15]) {
+    case 'F': width = 1920; height = 1080; break;
+    case 'E': width = 1280; height = 720; break;
+    case 'D': width = 640; height = 480; break;
+    case 'C': width = 848; height = 480; break;
+    case 'B': width = 176; height = 144; break;
+    }
+    slot->op = "AAABBBBCCCCDDDDE"[(op >> 4) & 15] - 'A';
+    slot->val = star_rand(&w->seed);
+    slot->num_blocks = 1;
+
+    switch (slot->op)
+    {
+    case 0:
+    {
+        bytes_t length = ROUND_UP_TO2POW(width * height, PAGE_SIZE);
+        slot->buffer = malloc(length + PAGE_SIZE - 1);
+        if (NOT_P(slot->buffer,!=,NULL)) return 1;
+        set_1D(slot->blks, length,
+               (void *) ROUND_UP_TO2POW((uintptr_t) slot->buffer, PAGE_SIZE));
+        break;
+    }
+    case 1: set_1D(slot->blks, width * height, NULL); break;
+    case 2: set_2D(slot->blks, width, height, PIXEL_FMT_8BIT); break;
+    case 3: set_2D(slot->blks, width, height, PIXEL_FMT_16BIT); break;
+    case 4: set_2D(slot->blks, width, height, PIXEL_FMT_32BIT); break;
+    }
+
+    uint64_t t = BenchLib_Now();
+    slot->bufPtr = slot->op ? MemMgr_Alloc(slot->blks, slot->num_blocks) :
+                              MemMgr_Map(slot->blks, slot->num_blocks);
+    BenchLib_AddSample(&w->s, BenchLib_Now() - t);
+
+    /* running out of tiler space is not an error */
+    if (!slot->bufPtr)
+    {
+        w->failed++;
+        FREE(slot->buffer);
+        return 0;
+    }
+    star_fill(slot, 0);
+    return 0;
+}
+
+/**
+ * Verifies the fill pattern of a slot's buffer, then frees or
+ * unmaps it.
+ *
+ * @param w      Pointer to the worker
+ * @param slot   Pointer to the slot
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int star_put(struct star_worker *w, struct star_slot *slot)
+{
+    int ret = NOT_I(star_fill(slot, 1),==,0);
+
+    uint64_t t = BenchLib_Now();
+    if (slot->op) ERR_ADD(ret, MemMgr_Free(slot->bufPtr));
+    else ERR_ADD(ret, MemMgr_UnMap(slot->bufPtr));
+    BenchLib_AddSample(&w->s, BenchLib_Now() - t);
+
+    FREE(slot->buffer);
+    ZERO(*slot);
+    return ret;
+}
+
+/**
+ * Star worker thread.  Performs a random sequence of
+ * allocs/maps and frees/unmaps on its own slots.
+ *
+ * @param arg    Pointer to the worker
+ *
+ * @return NULL
+ */
+static void *star_thread(void *arg)
+{
+    struct star_worker *w = (struct star_worker *) arg;
+    uint32_t n;
+    int ix;
+
+    for (n = 0; n < w->num_ops && !w->res; n++)
+    {
+        struct star_slot *slot = w->slots + star_rand(&w->seed) % STAR_SLOTS;
+        w->res = slot->bufPtr ? star_put(w, slot) : star_get(w, slot);
+    }
+
+    for (ix = 0; ix < STAR_SLOTS; ix++)
+    {
+        if (w->slots[ix].bufPtr) ERR_ADD(w->res, star_put(w, w->slots + ix));
+    }
+    return NULL;
+}
+
+/**
+ * Runs the star workload on a number of threads concurrently,
+ * and reports aggregate throughput and lock wait time.
+ *
+ * @param num_threads   Number of worker threads
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_star(int num_threads)
+{
+    struct star_worker *w = NEWN(struct star_worker, num_threads);
+    BenchLib_Samples s;
+    MemMgr_Stats stats;
+    uint32_t failed = 0;
+    char name[64];
+    int ix, ret = 0;
+
+    if (NOT_P(w,!=,NULL)) return 1;
+    if (NOT_I(BenchLib_InitSamples(&s, 0),==,0)) { FREE(w); return 1; }
+
+    MemMgr_GetStats(&stats, true);
+    uint64_t start = BenchLib_Now();
+    for (ix = 0; ix < num_threads; ix++)
+    {
+        w[ix].seed = STAR_SEED + ix;
+        w[ix].num_ops = BenchLib_Iterations(DEF_ITERATIONS);
+        if (NOT_I(BenchLib_InitSamples(&w[ix].s, w[ix].num_ops + STAR_SLOTS),==,0) ||
+            NOT_I(pthread_create(&w[ix].thread, NULL, star_thread, w + ix),==,0))
+        {
+            BenchLib_FreeSamples(&w[ix].s);
+            ret = 1;
+            break;
+        }
+    }
+    num_threads = ix;
+    for (ix = 0; ix < num_threads; ix++)
+    {
+        pthread_join(w[ix].thread, NULL);
+        ERR_ADD(ret, w[ix].res);
+        ERR_ADD(ret, BenchLib_MergeSamples(&s, &w[ix].s));
+        failed += w[ix].failed;
+        BenchLib_FreeSamples(&w[ix].s);
+    }
+    uint64_t elapsed = BenchLib_Now() - start;
+    MemMgr_GetStats(&stats, false);
+
+    if (!ret)
+    {
+        sprintf(name, "star %d slots/thread", STAR_SLOTS);
+        BenchLib_Result *r = BenchLib_Report("star", name, num_threads, &s, elapsed);
+        BenchLib_AddMetric(r, "lock_wait_ns", stats.lock_wait_ns);
+        BenchLib_AddMetric(r, "lock_contentions", stats.lock_contentions);
+        BenchLib_AddMetric(r, "lock_acquires", stats.lock_acquires);
+        BenchLib_AddMetric(r, "failed_allocs", failed);
+    }
+
+    BenchLib_FreeSamples(&s);
+    FREE(w);
+    return ret;
+}
+
+/**
+ * Runs the star workload on 1 to STAR_MAX_THREADS threads.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int star_suite()
+{
+    int threads, ret = 0;
+    for (threads = 1; threads <= STAR_MAX_THREADS && !ret; threads <<= 1)
+    {
+        ret = bench_star(threads);
+    }
+    return ret;
+}
+
+/* query APIs measured by the lookup suite */
+static const char *lookup_apis[] = { "GetStride", "IsMapped", "VirtToPhys" };
+
+/* queried pointer positions */
+static const char *lookup_pos[] = { "head", "middle", "tail", "miss", "foreign" };
+
+#define NUM_APIS (sizeof(lookup_apis) / sizeof(*lookup_apis))
+#define NUM_POS  (sizeof(lookup_pos) / sizeof(*lookup_pos))
+
+/**
+ * Calls a query API.
+ *
+ * @param api    API index into lookup_apis
+ * @param ptr    Queried pointer
+ *
+ * @return the result of the query
+ */
+static uint32_t lookup(int api, void *ptr)
+{
+    switch (api)
+    {
+    case 0:  return MemMgr_GetStride(ptr);
+    case 1:  return MemMgr_IsMapped(ptr);
+    default: return TilerMem_VirtToPhys(ptr);
+    }
+}
+
+/**
+ * Prints the median query latencies as a function of the number
+ * of live buffers.  Each row is a buffer count, and each
+ * position is plotted by its initial (x for miss, f for
+ * foreign) on a linear latency axis.
+ *
+ * @param api      API index into lookup_apis
+ * @param counts   Buffer counts
+ * @param num      Number of buffer counts
+ * @param p50      Median latencies [count][position]
+ */
+static void lookup_plot(int api, int *counts, int num, uint64_t p50[][NUM_POS])
+{
+    uint64_t max = 1;
+    char line[LOOKUP_PLOT_COLS + 1];
+    int ix, pos;
+
+    for (ix = 0; ix < num; ix++)
+        for (pos = 0; pos < NUM_POS; pos++)
+            if (p50[ix][pos] > max) max = p50[ix][pos];
+
+    printf("\n%s median latency vs. live buffers (h=head m=middle t=tail "
+           "x=miss f=foreign)\n", lookup_apis[api]);
+    for (ix = 0; ix < num; ix++)
+    {
+        memset(line, ' ', LOOKUP_PLOT_COLS);
+        line[LOOKUP_PLOT_COLS] = '\0';
+        for (pos = NUM_POS - 1; pos >= 0; pos--)
+        {
+            int col = p50[ix][pos] * (LOOKUP_PLOT_COLS - 1) / max;
+            line[col] = "hmtxf"[pos];
+        }
+        printf("%5d |%s|\n", counts[ix], line);
+    }
+    printf("      0 ns%*llu ns\n\n", LOOKUP_PLOT_COLS - 6, (unsigned long long) max);
+    fflush(stdout);
+}
+
+/**
+ * Measures the latency of the query APIs for pointers at the
+ * head, middle and tail of the buffer records, for an
+ * unregistered heap pointer (miss) and for an unmapped address
+ * (foreign), as the number of live buffers grows from 1 to
+ * LOOKUP_MAX_BUFS.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int lookup_suite()
+{
+    static uint64_t p50[NUM_APIS][LOOKUP_COUNTS][NUM_POS];
+    int counts[LOOKUP_COUNTS], num_counts = 0, num_bufs = 0, ix, api, pos, ret = 0;
+    uint32_t i, n = BenchLib_Iterations(DEF_ITERATIONS);
+    void **bufs = NEWN(void *, LOOKUP_MAX_BUFS);
+    void *heap = malloc(PAGE_SIZE);
+    MemAllocBlock blk;
+    BenchLib_Samples s;
+    char name[64];
+
+    if (NOT_P(bufs,!=,NULL) || NOT_P(heap,!=,NULL) ||
+        NOT_I(BenchLib_InitSamples(&s, n),==,0))
+    {
+        FREE(bufs);
+        FREE(heap);
+        return 1;
+    }
+
+    for (ix = 1; ix <= LOOKUP_MAX_BUFS && !ret; ix <<= 1)
+    {
+        /* grow the buffer records; newer buffers are at the tail */
+        while (num_bufs < ix)
+        {
+            set_1D(&blk, PAGE_SIZE, NULL);
+            bufs[num_bufs] = MemMgr_Alloc(&blk, 1);
+            if (!bufs[num_bufs]) break;
+            num_bufs++;
+        }
+        if (num_bufs < ix) break;
+
+        void *ptrs[NUM_POS];
+        ptrs[0] = bufs[0];
+        ptrs[1] = bufs[num_bufs / 2];
+        ptrs[2] = bufs[num_bufs - 1];
+        ptrs[3] = heap;
+        ptrs[4] = (void *) 0x12345678;
+
+        for (api = 0; api < NUM_APIS; api++)
+        {
+            for (pos = 0; pos < NUM_POS; pos++)
+            {
+                s.num = 0;
+                uint64_t start = BenchLib_Now();
+                for (i = 0; i < n; i++)
+                {
+                    uint64_t t = BenchLib_Now();
+                    lookup(api, ptrs[pos]);
+                    BenchLib_AddSample(&s, BenchLib_Now() - t);
+                }
+                sprintf(name, "%s %s %d", lookup_apis[api], lookup_pos[pos], num_bufs);
+                BenchLib_Result *r = BenchLib_Report("lookup", name, 1, &s,
+                                                     BenchLib_Now() - start);
+                p50[api][num_counts][pos] = r ? r->p50_ns : 0;
+            }
+        }
+        counts[num_counts++] = num_bufs;
+    }
+
+    for (api = 0; api < NUM_APIS; api++)
+    {
+        lookup_plot(api, counts, num_counts, p50[api]);
+    }
+
+    while (num_bufs--)
+    {
+        ERR_ADD(ret, MemMgr_Free(bufs[num_bufs]));
+    }
+    BenchLib_FreeSamples(&s);
+    FREE(bufs);
+    FREE(heap);
+    return ret;
+}
+
+#ifdef STUB_TILER
+/**
+ * Returns the size of an allocated buffer.
+ *
+ * @param blks        Block specification after the allocation
+ * @param num_blocks  Number of blocks
+ *
+ * @return buffer size in bytes
+ */
+static uint64_t buf_size(MemAllocBlock *blks, int num_blocks)
+{
+    uint64_t size = 0;
+    int ix;
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        size += blks[ix].pixelFormat == PIXEL_FMT_PAGE ? blks[ix].dim.len :
+                (uint64_t) blks[ix].stride * blks[ix].dim.area.height;
+    }
+    return size;
+}
+#endif
+
+/**
+ * Allocates buffers until an allocation fails, recording the
+ * latency of each successful allocation.  The stub has no
+ * container to exhaust, so it stops at TILER_LENGTH bytes.
+ *
+ * @param blks        Block specification
+ * @param num_blocks  Number of blocks
+ * @param bufs        Buffer array
+ * @param num         Pointer to the number of buffers in the array
+ * @param s           Pointer to the samples (may be NULL)
+ *
+ * @return TRUE if the container was exhausted, FALSE if
+ *         EXHAUST_MAX_BUFS buffers were allocated
+ */
+static int exhaust_fill(MemAllocBlock *blks, int num_blocks, void **bufs,
+                        int *num, BenchLib_Samples *s)
+{
+    MemAllocBlock tmp[2];
+#ifdef STUB_TILER
+    uint64_t bytes = 0;
+#endif
+
+    while (*num < EXHAUST_MAX_BUFS)
+    {
+        memcpy(tmp, blks, sizeof(*blks) * num_blocks);
+        uint64_t t = BenchLib_Now();
+        void *bufPtr = MemMgr_Alloc(tmp, num_blocks);
+        t = BenchLib_Now() - t;
+        if (!bufPtr) return true;
+
+        if (s) BenchLib_AddSample(s, t);
+        bufs[(*num)++] = bufPtr;
+#ifdef STUB_TILER
+        bytes += buf_size(tmp, num_blocks);
+        if (bytes >= TILER_LENGTH) return true;
+#endif
+    }
+    return false;
+}
+
+/**
+ * Runs windows of alloc+free cycles, and records the latency of
+ * each cycle and the throughput of each window.  Failed
+ * allocations are counted and timed as well.
+ *
+ * @param blks        Block specification
+ * @param num_blocks  Number of blocks
+ * @param s           Pointer to the samples
+ * @param rate        Array of EXHAUST_WINDOWS window throughputs
+ * @param failed      Pointer to the number of failed allocations
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int exhaust_cycles(MemAllocBlock *blks, int num_blocks,
+                          BenchLib_Samples *s, double *rate, int *failed)
+{
+    MemAllocBlock tmp[2];
+    int win, ix, ret = 0;
+
+    *failed = 0;
+    for (win = 0; win < EXHAUST_WINDOWS && !ret; win++)
+    {
+        uint64_t start = BenchLib_Now();
+        for (ix = 0; ix < EXHAUST_WINDOW && !ret; ix++)
+        {
+            memcpy(tmp, blks, sizeof(*blks) * num_blocks);
+            uint64_t t = BenchLib_Now();
+            void *bufPtr = MemMgr_Alloc(tmp, num_blocks);
+            if (bufPtr) ret = NOT_I(MemMgr_Free(bufPtr),==,0);
+            else (*failed)++;
+            BenchLib_AddSample(s, BenchLib_Now() - t);
+        }
+        rate[win] = EXHAUST_WINDOW * 1e9 / (BenchLib_Now() - start + 1);
+    }
+    return ret;
+}
+
+/**
+ * Reports a range of fill samples as a case.  The case's elapsed
+ * time is the sum of its latencies.
+ *
+ * @param name   Case name
+ * @param s      Pointer to all fill samples in allocation order
+ * @param from   First sample
+ * @param to     End of the samples
+ */
+static void exhaust_report(const char *name, BenchLib_Samples *s,
+                           uint32_t from, uint32_t to)
+{
+    BenchLib_Samples part;
+    uint64_t elapsed = 0;
+    uint32_t ix;
+
+    if (from >= to) return;
+    part.ns = s->ns + from;
+    part.num = part.max = to - from;
+    for (ix = 0; ix < part.num; ix++) elapsed += part.ns[ix];
+    BenchLib_Report("exhaust", name, 1, &part, elapsed);
+}
+
+/**
+ * Measures a buffer layout as the container fills up:
+ * <ol>
+ * <li>alloc+free cycles in an empty container,
+ * <li>allocation latency per quarter of the fill, until an
+ *     allocation fails,
+ * <li>the latency of failing allocations,
+ * <li>the latency of freeing half of the buffers in random order,
+ * <li>alloc+free cycles after that, and how many windows it
+ *     takes to reach EXHAUST_RECOVERY% of the empty container
+ *     throughput,
+ * <li>how much of the freed space can be allocated again.
+ * </ol>
+ *
+ * @param label       Layout name
+ * @param blks        Block specification
+ * @param num_blocks  Number of blocks
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_exhaust(const char *label, MemAllocBlock *blks, int num_blocks)
+{
+    static const char *quarters[] = { "0-25%", "25-50%", "50-75%", "75-100%" };
+    double rate[EXHAUST_WINDOWS], empty_rate = 0;
+    void **bufs = NEWN(void *, EXHAUST_MAX_BUFS);
+    int num = 0, exhausted, failed, ix, q, ret = 0;
+    uint32_t seed = STAR_SEED;
+    BenchLib_Samples s;
+    BenchLib_Result *r;
+    char name[64];
+
+    if (NOT_P(bufs,!=,NULL)) return 1;
+    if (NOT_I(BenchLib_InitSamples(&s, EXHAUST_MAX_BUFS + EXHAUST_WINDOWS * EXHAUST_WINDOW),==,0))
+    {
+        FREE(bufs);
+        return 1;
+    }
+
+    /* baseline throughput */
+    uint64_t start = BenchLib_Now();
+    ret = exhaust_cycles(blks, num_blocks, &s, rate, &failed);
+    if (ret)
+    {
+        BenchLib_FreeSamples(&s);
+        FREE(bufs);
+        return ret;
+    }
+    sprintf(name, "%s cycle empty", label);
+    r = BenchLib_Report("exhaust", name, 1, &s, BenchLib_Now() - start);
+    if (r) empty_rate = r->ops_per_sec;
+
+    /* fill up the container */
+    s.num = 0;
+    exhausted = exhaust_fill(blks, num_blocks, bufs, &num, &s);
+    for (q = 0; q < 4 && !ret; q++)
+    {
+        sprintf(name, "%s fill %s", label, quarters[q]);
+        exhaust_report(name, &s, s.num * q / 4, s.num * (q + 1) / 4);
+    }
+
+    /* failed allocations */
+    s.num = 0;
+    start = BenchLib_Now();
+    for (ix = 0; ix < EXHAUST_FAILS && exhausted && !ret; ix++)
+    {
+        MemAllocBlock tmp[2];
+        memcpy(tmp, blks, sizeof(*blks) * num_blocks);
+        uint64_t t = BenchLib_Now();
+        void *bufPtr = MemMgr_Alloc(tmp, num_blocks);
+        t = BenchLib_Now() - t;
+        if (bufPtr) ret = NOT_I(MemMgr_Free(bufPtr),==,0);
+        else BenchLib_AddSample(&s, t);
+    }
+    sprintf(name, "%s failed", label);
+    r = s.num ? BenchLib_Report("exhaust", name, 1, &s, BenchLib_Now() - start) : NULL;
+    BenchLib_AddMetric(r, "buffers", num);
+
+    /* free half of the buffers in random order */
+    for (ix = num - 1; ix > 0; ix--)
+    {
+        int j = star_rand(&seed) % (ix + 1);
+        void *tmp = bufs[ix];
+        bufs[ix] = bufs[j];
+        bufs[j] = tmp;
+    }
+    int kept = num - num / 2, freed = num / 2;
+    s.num = 0;
+    start = BenchLib_Now();
+    while (num > kept && !ret)
+    {
+        uint64_t t = BenchLib_Now();
+        ret = NOT_I(MemMgr_Free(bufs[--num]),==,0);
+        BenchLib_AddSample(&s, BenchLib_Now() - t);
+    }
+    sprintf(name, "%s free half", label);
+    if (!ret) BenchLib_Report("exhaust", name, 1, &s, BenchLib_Now() - start);
+
+    /* throughput recovery */
+    s.num = 0;
+    start = BenchLib_Now();
+    if (!ret) ret = exhaust_cycles(blks, num_blocks, &s, rate, &failed);
+    sprintf(name, "%s recover", label);
+    r = ret ? NULL : BenchLib_Report("exhaust", name, 1, &s, BenchLib_Now() - start);
+    for (ix = 0; ix < EXHAUST_WINDOWS && rate[ix] * 100 < empty_rate * EXHAUST_RECOVERY; ix++);
+    BenchLib_AddMetric(r, "empty_ops_per_sec", empty_rate);
+    BenchLib_AddMetric(r, "first_window_ops_per_sec", rate[0]);
+    BenchLib_AddMetric(r, "recovery_windows", ix < EXHAUST_WINDOWS ? ix + 1 : -1);
+    BenchLib_AddMetric(r, "failed_allocs", failed);
+
+    /* refill the freed space */
+    if (!ret && exhausted)
+    {
+        exhaust_fill(blks, num_blocks, bufs, &num, NULL);
+        BenchLib_AddMetric(r, "refill_pct", freed ? 100.0 * (num - kept) / freed : 0);
+    }
+
+    while (num)
+    {
+        ERR_ADD(ret, MemMgr_Free(bufs[--num]));
+    }
+    BenchLib_FreeSamples(&s);
+    FREE(bufs);
+    return ret;
+}
+
+/**
+ * Measures allocation latency as the container is exhausted and
+ * the recovery after freeing half of the buffers, for 1D, 2D and
+ * NV12 layouts.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int exhaust_suite()
+{
+    MemAllocBlock blks[2];
+    int ret = 0;
+
+    set_1D(blks, 640 * 480 * 2, NULL);
+    ret |= bench_exhaust("1D 640x480x2", blks, 1);
+
+    set_2D(blks, 176, 144, PIXEL_FMT_8BIT);
+    ret |= bench_exhaust("2D 8bit 176x144", blks, 1);
+
+    set_2D(blks, 640, 480, PIXEL_FMT_8BIT);
+    set_2D(blks + 1, 320, 240, PIXEL_FMT_16BIT);
+    ret |= bench_exhaust("NV12 640x480", blks, 2);
+
+    set_2D(blks, 1920, 1080, PIXEL_FMT_8BIT);
+    set_2D(blks + 1, 960, 540, PIXEL_FMT_16BIT);
+    ret |= bench_exhaust("NV12 1920x1080", blks, 2);
+    return ret;
+}
+
+/* copy methods */
+enum copy_method {
+    COPY_MEMCPY,     /* memcpy row loop into the block */
+    COPY_TO_BLOCK,   /* MemMgr_CopyToBlock */
+    COPY_FROM_BLOCK  /* MemMgr_CopyFromBlock */
+};
+
+static const char *copy_names[] = { "memcpy rows to", "CopyToBlock",
+                                    "CopyFromBlock" };
+
+/**
+ * Measures the bandwidth of copying a linear frame into a 2D
+ * block, or back, using a memcpy row loop as clients do, and
+ * using the MemMgr copy APIs.
+ *
+ * @param width    Frame width
+ * @param height   Frame height
+ * @param fmt      Pixel format
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_copy(pixels_t width, pixels_t height, pixel_fmt_t fmt)
+{
+    BenchLib_Samples s;
+    MemAllocBlock blk;
+    char name[64];
+    bytes_t bpp = fmt == PIXEL_FMT_32BIT ? 4 : fmt == PIXEL_FMT_16BIT ? 2 : 1;
+    bytes_t row = width * bpp, y;
+    uint32_t i, n = BenchLib_Iterations(COPY_ITERATIONS);
+    int m, ret = 0;
+
+    set_2D(&blk, width, height, fmt);
+    void *bufPtr = MemMgr_Alloc(&blk, 1);
+    uint8_t *frame = malloc(row * height);
+    if (NOT_P(bufPtr,!=,NULL) || NOT_P(frame,!=,NULL))
+    {
+        if (bufPtr) MemMgr_Free(bufPtr);
+        FREE(frame);
+        return 1;
+    }
+    memset(frame, 0x5A, row * height);
+
+    for (m = COPY_MEMCPY; m <= COPY_FROM_BLOCK && !ret; m++)
+    {
+        if (NOT_I(BenchLib_InitSamples(&s, n),==,0)) break;
+
+        uint64_t start = BenchLib_Now();
+        for (i = 0; i < n && !ret; i++)
+        {
+            uint64_t t = BenchLib_Now();
+            switch (m)
+            {
+            case COPY_MEMCPY:
+                for (y = 0; y < height; y++)
+                {
+                    memcpy((uint8_t *) blk.ptr + y * blk.stride,
+                           frame + y * row, row);
+                }
+                break;
+            case COPY_TO_BLOCK:
+                ret = NOT_I(MemMgr_CopyToBlock(&blk, frame, 0),==,0);
+                break;
+            default:
+                ret = NOT_I(MemMgr_CopyFromBlock(frame, 0, &blk),==,0);
+                break;
+            }
+            BenchLib_AddSample(&s, BenchLib_Now() - t);
+        }
+        uint64_t elapsed = BenchLib_Now() - start;
+
+        sprintf(name, "%s 2D %ubit %ux%u", copy_names[m], bpp * 8, width,
+                height);
+        if (!ret)
+        {
+            BenchLib_Result *r = BenchLib_Report("copy", name, 1, &s, elapsed);
+            BenchLib_AddMetric(r, "mbytes_per_sec",
+                               elapsed ? 1e3 * row * height * n / elapsed : 0);
+        }
+        BenchLib_FreeSamples(&s);
+    }
+
+    ret |= NOT_I(MemMgr_Free(bufPtr),==,0);
+    FREE(frame);
+    return ret;
+}
+
+/**
+ * Measures the bandwidth of 2D copies between linear frames and
+ * 2D blocks at each resolution from 640x480.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int copy_suite()
+{
+    int ix, ret = 0;
+
+    for (ix = 0; ix < NUM_RES; ix++)
+    {
+        if (res[ix].width < 640) continue;
+        ret |= bench_copy(res[ix].width, res[ix].height, PIXEL_FMT_8BIT);
+        ret |= bench_copy(res[ix].width, res[ix].height, PIXEL_FMT_32BIT);
+    }
+    return ret;
+}
+
+/* fill methods */
+enum fill_method {
+    FILL_MEMSET,     /* memset row loop */
+    FILL_2D,         /* MemMgr_Fill2D of each block */
+    FILL_CLEAR_NV12  /* MemMgr_ClearNV12 */
+};
+
+static const char *fill_names[] = { "memset rows", "Fill2D", "ClearNV12" };
+
+/**
+ * Measures the bandwidth of clearing an NV12 buffer to black
+ * using a memset row loop as clients do, and using the MemMgr
+ * fill APIs.
+ *
+ * @param width    Frame width
+ * @param height   Frame height
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_fill(pixels_t width, pixels_t height)
+{
+    BenchLib_Samples s;
+    MemAllocBlock blks[2];
+    char name[64];
+    bytes_t bytes = width * height * 3 / 2, y;
+    uint32_t i, n = BenchLib_Iterations(COPY_ITERATIONS);
+    int m, b, ret = 0;
+
+    set_2D(blks, width, height, PIXEL_FMT_8BIT);
+    set_2D(blks + 1, width >> 1, height >> 1, PIXEL_FMT_16BIT);
+    void *bufPtr = MemMgr_Alloc(blks, 2);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+
+    for (m = FILL_MEMSET; m <= FILL_CLEAR_NV12 && !ret; m++)
+    {
+        if (NOT_I(BenchLib_InitSamples(&s, n),==,0)) break;
+
+        uint64_t start = BenchLib_Now();
+        for (i = 0; i < n && !ret; i++)
+        {
+            uint64_t t = BenchLib_Now();
+            switch (m)
+            {
+            case FILL_MEMSET:
+                for (b = 0; b < 2; b++)
+                {
+                    for (y = 0; y < blks[b].dim.area.height; y++)
+                    {
+                        memset((uint8_t *) blks[b].ptr + y * blks[b].stride,
+                               b ? 128 : 16, width);
+                    }
+                }
+                break;
+            case FILL_2D:
+                ret = NOT_I(MemMgr_Fill2D(blks[0].ptr, 0x10101010, width,
+                                          height),==,0) ||
+                      NOT_I(MemMgr_Fill2D(blks[1].ptr, 0x80808080, width,
+                                          height >> 1),==,0);
+                break;
+            default:
+                ret = NOT_I(MemMgr_ClearNV12(bufPtr, 16, 128, 128),==,0);
+                break;
+            }
+            BenchLib_AddSample(&s, BenchLib_Now() - t);
+        }
+        uint64_t elapsed = BenchLib_Now() - start;
+
+        sprintf(name, "%s NV12 %ux%u", fill_names[m], width, height);
+        if (!ret)
+        {
+            BenchLib_Result *r = BenchLib_Report("fill", name, 1, &s, elapsed);
+            BenchLib_AddMetric(r, "mbytes_per_sec",
+                               elapsed ? 1e3 * bytes * n / elapsed : 0);
+        }
+        BenchLib_FreeSamples(&s);
+    }
+
+    ret |= NOT_I(MemMgr_Free(bufPtr),==,0);
+    return ret;
+}
+
+/**
+ * Measures the bandwidth of clearing NV12 buffers at each
+ * resolution from 640x480.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int fill_suite()
+{
+    int ix, ret = 0;
+
+    for (ix = 0; ix < NUM_RES; ix++)
+    {
+        if (res[ix].width < 640) continue;
+        ret |= bench_fill(res[ix].width, res[ix].height);
+    }
+    return ret;
+}
+
+#ifdef STUB_TILER
+/* cache maintenance is only provided when emulating the tiler */
+
+/**
+ * Measures cache flushes of a buffer with NV12 2D blocks and a
+ * 1D block of the same size, as a whole buffer range and as a
+ * batch of CACHE_RANGES ranges across the buffer.  Reports the
+ * bytes flushed and skipped (in 2D blocks) per call.
+ *
+ * @param width    Frame width
+ * @param height   Frame height
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_cache(pixels_t width, pixels_t height)
+{
+    BenchLib_Samples s;
+    MemAllocBlock blks[3];
+    MemMgr_Range ranges[CACHE_RANGES];
+    MemMgr_Stats stats;
+    char name[64];
+    uint32_t i, n = BenchLib_Iterations(DEF_ITERATIONS);
+    int b, ix, ret = 0;
+
+    set_2D(blks, width, height, PIXEL_FMT_8BIT);
+    set_2D(blks + 1, width >> 1, height >> 1, PIXEL_FMT_16BIT);
+    set_1D(blks + 2, (width * height * 3 / 2 + PAGE_SIZE - 1) &
+                     ~(PAGE_SIZE - 1), NULL);
+    void *bufPtr = MemMgr_Alloc(blks, 3);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+    uint8_t *end = (uint8_t *) blks[2].ptr + blks[2].dim.len;
+    bytes_t size = end - (uint8_t *) bufPtr;
+
+    for (b = 0; b < 2 && !ret; b++)
+    {
+        int num_ranges = b ? CACHE_RANGES : 1;
+        for (ix = 0; ix < num_ranges; ix++)
+        {
+            ranges[ix].ptr = (uint8_t *) bufPtr + size / num_ranges * ix;
+            ranges[ix].size = size / num_ranges;
+        }
+        if (NOT_I(BenchLib_InitSamples(&s, n),==,0)) break;
+
+        MemMgr_GetStats(&stats, true);
+        uint64_t start = BenchLib_Now();
+        for (i = 0; i < n && !ret; i++)
+        {
+            uint64_t t = BenchLib_Now();
+            ret = NOT_I(MemMgr_CacheFlush(ranges, num_ranges),==,0);
+            BenchLib_AddSample(&s, BenchLib_Now() - t);
+        }
+        uint64_t elapsed = BenchLib_Now() - start;
+        MemMgr_GetStats(&stats, false);
+
+        sprintf(name, "flush %d range%s NV12+1D %ux%u", num_ranges,
+                b ? "s" : "", width, height);
+        if (!ret)
+        {
+            BenchLib_Result *r = BenchLib_Report("cache", name, 1, &s, elapsed);
+            BenchLib_AddMetric(r, "flush_bytes", stats.cache_flush_bytes / n);
+            BenchLib_AddMetric(r, "skipped_bytes",
+                               stats.cache_skipped_bytes / n);
+            BenchLib_AddMetric(r, "mbytes_per_sec",
+                               elapsed ? 1e3 * stats.cache_flush_bytes /
+                                         elapsed : 0);
+        }
+        BenchLib_FreeSamples(&s);
+    }
+
+    ret |= NOT_I(MemMgr_Free(bufPtr),==,0);
+    return ret;
+}
+
+/**
+ * Measures cache flushes of buffers at each resolution from
+ * 640x480.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int cache_suite()
+{
+    int ix, ret = 0;
+
+    for (ix = 0; ix < NUM_RES; ix++)
+    {
+        if (res[ix].width < 640) continue;
+        ret |= bench_cache(res[ix].width, res[ix].height);
+    }
+    return ret;
+}
+#endif
+
+static const char *map_2D_names[] = { "CopyToBlock", "MapIn2DMode+UnMap" };
+
+/**
+ * Measures getting a user frame into 2D tiler addressing by
+ * copying it into an allocated 2D block, and by mapping it in
+ * 2D mode and unmapping it.
+ *
+ * @param width    Frame width
+ * @param height   Frame height
+ * @param fmt      Pixel format
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_map_2D(pixels_t width, pixels_t height, pixel_fmt_t fmt)
+{
+    BenchLib_Samples s;
+    MemAllocBlock blk, frame_blk;
+    char name[64];
+    bytes_t bpp = fmt == PIXEL_FMT_32BIT ? 4 : fmt == PIXEL_FMT_16BIT ? 2 : 1;
+    bytes_t row = width * bpp;
+    uint32_t i, n = BenchLib_Iterations(COPY_ITERATIONS);
+    int m, ret = 0;
+
+    set_2D(&blk, width, height, fmt);
+    void *bufPtr = MemMgr_Alloc(&blk, 1);
+    uint8_t *buffer = malloc(row * height + PAGE_SIZE - 1);
+    if (NOT_P(bufPtr,!=,NULL) || NOT_P(buffer,!=,NULL))
+    {
+        if (bufPtr) MemMgr_Free(bufPtr);
+        FREE(buffer);
+        return 1;
+    }
+    uint8_t *frame = (uint8_t *) ROUND_UP_TO2POW((uintptr_t) buffer, PAGE_SIZE);
+    memset(frame, 0x5A, row * height);
+
+    for (m = 0; m < 2 && !ret; m++)
+    {
+        if (NOT_I(BenchLib_InitSamples(&s, n),==,0)) break;
+
+        uint64_t start = BenchLib_Now();
+        for (i = 0; i < n && !ret; i++)
+        {
+            uint64_t t = BenchLib_Now();
+            if (m)
+            {
+                set_2D(&frame_blk, width, height, fmt);
+                frame_blk.ptr = frame;
+                void *ptr = MemMgr_MapIn2DMode(&frame_blk);
+                ret = NOT_P(ptr,!=,NULL) || NOT_I(MemMgr_UnMap(ptr),==,0);
+            }
+            else
+            {
+                ret = NOT_I(MemMgr_CopyToBlock(&blk, frame, 0),==,0);
+            }
+            BenchLib_AddSample(&s, BenchLib_Now() - t);
+        }
+        uint64_t elapsed = BenchLib_Now() - start;
+
+        sprintf(name, "%s 2D %ubit %ux%u", map_2D_names[m], bpp * 8, width,
+                height);
+        if (!ret)
+        {
+            BenchLib_Result *r = BenchLib_Report("map2d", name, 1, &s,
+                                                 elapsed);
+            BenchLib_AddMetric(r, "mbytes_per_sec",
+                               elapsed ? 1e3 * row * height * n / elapsed : 0);
+        }
+        BenchLib_FreeSamples(&s);
+    }
+
+    ret |= NOT_I(MemMgr_Free(bufPtr),==,0);
+    FREE(buffer);
+    return ret;
+}
+
+/**
+ * Measures 2D mode mapping against copying for 8 and 32-bit
+ * frames at each resolution from 640x480.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int map_2D_suite()
+{
+    int ix, ret = 0;
+
+    for (ix = 0; ix < NUM_RES; ix++)
+    {
+        if (res[ix].width < 640) continue;
+        ret |= bench_map_2D(res[ix].width, res[ix].height, PIXEL_FMT_8BIT);
+        ret |= bench_map_2D(res[ix].width, res[ix].height, PIXEL_FMT_32BIT);
+    }
+    return ret;
+}
+
+/* number of user buffers in the map cache ring */
+#define MAP_CACHE_RING 4
+
+/**
+ * Measures map+unmap cycles of a ring of user buffers of the 1D
+ * buffer size at a resolution, with the map cache disabled and
+ * with a map cache that holds the ring.  Also reports the map
+ * cache hit rate.
+ *
+ * @param width    Frame width
+ * @param height   Frame height
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int bench_map_cache(pixels_t width, pixels_t height)
+{
+    BenchLib_Samples s;
+    MemAllocBlock blk;
+    MemMgr_Stats stats;
+    char name[64];
+    bytes_t length = ROUND_UP_TO2POW(width * height * 2, PAGE_SIZE);
+    uint32_t i, n = BenchLib_Iterations(DEF_ITERATIONS);
+    int m, ret = 0;
+
+    void *buffer = malloc(MAP_CACHE_RING * length + PAGE_SIZE - 1);
+    if (NOT_P(buffer,!=,NULL)) return 1;
+    void *dataPtr = (void *) ROUND_UP_TO2POW((uintptr_t) buffer, PAGE_SIZE);
+
+    for (m = 0; m < 2 && !ret; m++)
+    {
+        if (NOT_I(BenchLib_InitSamples(&s, n),==,0)) break;
+        ret = NOT_I(MemMgr_SetMapCache(m ? MAP_CACHE_RING : 0),==,0);
+        MemMgr_GetStats(&stats, true);
+
+        uint64_t start = BenchLib_Now();
+        for (i = 0; i < n && !ret; i++)
+        {
+            set_1D(&blk, length, dataPtr + (i % MAP_CACHE_RING) * length);
+            uint64_t t = BenchLib_Now();
+            void *bufPtr = MemMgr_Map(&blk, 1);
+            if (NOT_P(bufPtr,!=,NULL)) ret = 1;
+            else ret = NOT_I(MemMgr_UnMap(bufPtr),==,0);
+            BenchLib_AddSample(&s, BenchLib_Now() - t);
+        }
+        uint64_t elapsed = BenchLib_Now() - start;
+        MemMgr_GetStats(&stats, false);
+
+        sprintf(name, "%s 1D %ux%ux2 ring of %d", m ? "cached" : "uncached",
+                width, height, MAP_CACHE_RING);
+        if (!ret)
+        {
+            uint32_t lookups = stats.map_cache_hits + stats.map_cache_misses;
+            BenchLib_Result *r = BenchLib_Report("mapcache", name, 1, &s,
+                                                 elapsed);
+            BenchLib_AddMetric(r, "hit_rate",
+                               lookups ? (double) stats.map_cache_hits /
+                                         lookups : 0);
+        }
+        BenchLib_FreeSamples(&s);
+    }
+
+    ret |= NOT_I(MemMgr_SetMapCache(0),==,0);
+    FREE(buffer);
+    return ret;
+}
+
+/**
+ * Measures the map cache on a ring of user buffers at each
+ * resolution from 640x480.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int map_cache_suite()
+{
+    int ix, ret = 0;
+
+    for (ix = 0; ix < NUM_RES; ix++)
+    {
+        if (res[ix].width < 640) continue;
+        ret |= bench_map_cache(res[ix].width, res[ix].height);
+    }
+    return ret;
+}
+
+static BenchLib_Suite suites[] = {
+    { "alloc", "alloc+free of 1D, 2D and NV12 buffers", alloc_suite },
+    { "map",   "map+unmap of 1D user buffers",          map_suite },
+    { "star",  "random allocs/maps and frees/unmaps on 1-16 threads",
+      star_suite },
+    { "lookup", "query latency vs. number of live buffers", lookup_suite },
+    { "exhaust", "alloc latency up to exhaustion and recovery after frees",
+      exhaust_suite },
+    { "copy",  "2D copy bandwidth between frames and 2D blocks", copy_suite },
+    { "fill",  "NV12 clear bandwidth", fill_suite },
+#ifdef STUB_TILER
+    { "cache", "cache flush of buffers with 2D and 1D blocks", cache_suite },
+#endif
+    { "map2d", "2D mode mapping of user frames vs. copying into 2D blocks",
+      map_2D_suite },
+    { "mapcache", "map+unmap of a ring of user buffers with the map cache",
+      map_cache_suite },
+    { NULL, NULL, NULL },
+};
+
+/**
+ * Main benchmark function.  Checks arguments for suites, runs
+ * them and prints usage or suite list if required.
+ *
+ * @param argc   Number of arguments
+ * @param argv   Arguments
+ *
+ * @return -1 on usage or suite list, otherwise # of failed
+ *         suites.
+ */
+int main(int argc, char **argv)
+{
+    return BenchLib_Run(argc, argv, suites, BACKEND);
+}
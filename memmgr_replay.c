@@ -0,0 +1,562 @@
+/*
+ *  memmgr_replay.c
+ *
+ *  Replays Memory Allocator API call traces.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* for nanosleep */
+#define _POSIX_C_SOURCE 200112L
+
+/* retrieve type definitions */
+#define __DEBUG__
+#undef __DEBUG_ENTRY__
+#define __DEBUG_ASSERT__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include <utils.h>
+#include <debug_utils.h>
+#include <memmgr.h>
+#include <tilermem.h>
+#include <tilermem_utils.h>
+#include <benchlib.h>
+#include "record.h"
+
+#ifdef STUB_TILER
+#define BACKEND "stub"
+#else
+#define BACKEND "tiler"
+#endif
+
+#define MAX_BLOCKS 16
+
+/* names of recorded operations, indexed by enum record_op */
+static const char *op_names[] = {
+    "", "alloc", "free", "map", "unmap", "GetStride", "Is1DBlock",
+    "Is2DBlock", "IsMapped", "VirtToPhys"
+};
+
+#define NUM_OPS (sizeof(op_names) / sizeof(*op_names))
+
+/* recorded call */
+struct rep_op {
+    struct record_entry  e;
+    struct record_block *blocks;
+    uint32_t             ix;      /* position in the trace file */
+};
+
+/* buffer that is live during replay */
+struct rep_buf {
+    uint64_t  rec_ptr;    /* recorded buffer pointer */
+    uint64_t  size;       /* recorded buffer size */
+    void     *bufPtr;     /* replayed buffer pointer */
+    void     *buffer;     /* user buffer of mapped buffers */
+    int       slot;       /* tiler_ptest slot */
+};
+
+static struct rep_buf *bufs = NULL;
+static int num_bufs = 0;
+
+/**
+ * Reads a trace file.
+ *
+ * @param path     Path to the trace file
+ * @param ops      Pointer to where to store the op array
+ * @param blocks   Pointer to where to store the block array
+ *
+ * @return number of ops read, or -1 on failure
+ */
+static int read_trace(const char *path, struct rep_op **ops,
+                      struct record_block **blocks)
+{
+    struct record_header hdr;
+    struct record_entry e;
+    int num = 0, max = 0, num_blks = 0, max_blks = 0, ix;
+    FILE *fp = fopen(path, "rb");
+
+    *ops = NULL;
+    *blocks = NULL;
+    if (!fp || fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        memcmp(hdr.magic, RECORD_MAGIC, sizeof(hdr.magic)) ||
+        hdr.endian != RECORD_ENDIAN)
+    {
+        fprintf(stderr, "%s is not a trace file of this byte order\n", path);
+        if (fp) fclose(fp);
+        return -1;
+    }
+
+    while (fread(&e, sizeof(e), 1, fp) == 1)
+    {
+        if (num == max)
+        {
+            struct rep_op *o = realloc(*ops, sizeof(*o) * (max += 4096));
+            if (NOT_P(o,!=,NULL)) break;
+            *ops = o;
+        }
+        if (num_blks + e.num_blocks > max_blks)
+        {
+            struct record_block *b = realloc(*blocks, sizeof(*b) * (max_blks += 4096));
+            if (NOT_P(b,!=,NULL)) break;
+            *blocks = b;
+        }
+        if (e.num_blocks > MAX_BLOCKS ||
+            fread(*blocks + num_blks, sizeof(**blocks), e.num_blocks, fp) != e.num_blocks)
+        {
+            fprintf(stderr, "%s is truncated\n", path);
+            break;
+        }
+        (*ops)[num].e = e;
+        (*ops)[num].ix = num;
+        /* store block index for now, as the array may move */
+        (*ops)[num++].blocks = (struct record_block *) (uintptr_t) num_blks;
+        num_blks += e.num_blocks;
+    }
+    fclose(fp);
+
+    for (ix = 0; ix < num; ix++)
+    {
+        (*ops)[ix].blocks = *blocks + (uintptr_t) (*ops)[ix].blocks;
+    }
+    return num;
+}
+
+/* orders ops by time stamp, then by position in the trace */
+static int cmp_ops(const void *a, const void *b)
+{
+    const struct rep_op *x = (const struct rep_op *) a, *y = (const struct rep_op *) b;
+    if (x->e.ts != y->e.ts) return x->e.ts < y->e.ts ? -1 : 1;
+    return x->ix < y->ix ? -1 : x->ix > y->ix;
+}
+
+/**
+ * Returns the size of a recorded buffer from its block layout.
+ *
+ * @param op     Pointer to the recorded alloc or map
+ *
+ * @return buffer size
+ */
+static uint64_t rec_size(struct rep_op *op)
+{
+    uint64_t size = 0;
+    int ix;
+    for (ix = 0; ix < op->e.num_blocks; ix++)
+    {
+        struct record_block *b = op->blocks + ix;
+        size += b->fmt == PIXEL_FMT_PAGE ? ROUND_UP_TO2POW(b->width, PAGE_SIZE) :
+                (uint64_t) b->stride * b->height;
+    }
+    return size;
+}
+
+/**
+ * Finds a live buffer by its recorded pointer.
+ *
+ * @param rec_ptr  Recorded pointer
+ * @param inside   TRUE to also match pointers inside a buffer,
+ *                 FALSE to only match the buffer pointer
+ *
+ * @return pointer to the live buffer, or NULL if not found
+ */
+static struct rep_buf *find_buf(uint64_t rec_ptr, bool inside)
+{
+    int ix;
+    for (ix = 0; ix < num_bufs; ix++)
+    {
+        if (bufs[ix].rec_ptr == rec_ptr ||
+            (inside && bufs[ix].rec_ptr < rec_ptr &&
+             rec_ptr < bufs[ix].rec_ptr + bufs[ix].size)) return bufs + ix;
+    }
+    return NULL;
+}
+
+/**
+ * Adds a live buffer.  The lowest unused tiler_ptest slot is
+ * assigned to it.
+ *
+ * @return pointer to the live buffer, or NULL on memory
+ *         allocation failure.
+ */
+static struct rep_buf *add_buf(uint64_t rec_ptr, uint64_t size, void *bufPtr,
+                               void *buffer)
+{
+    static int max_bufs = 0;
+    int slot = 1, ix;
+
+    if (num_bufs == max_bufs)
+    {
+        struct rep_buf *b = realloc(bufs, sizeof(*b) * (max_bufs + 256));
+        if (NOT_P(b,!=,NULL)) return NULL;
+        bufs = b;
+        max_bufs += 256;
+    }
+
+    /* find lowest free slot */
+    for (ix = 0; ix < num_bufs; ix++)
+    {
+        if (bufs[ix].slot == slot)
+        {
+            slot++;
+            ix = -1;
+        }
+    }
+
+    bufs[num_bufs].rec_ptr = rec_ptr;
+    bufs[num_bufs].size = size;
+    bufs[num_bufs].bufPtr = bufPtr;
+    bufs[num_bufs].buffer = buffer;
+    bufs[num_bufs].slot = slot;
+    return bufs + num_bufs++;
+}
+
+static void del_buf(struct rep_buf *buf)
+{
+    *buf = bufs[--num_bufs];
+}
+
+/**
+ * Prints a recorded alloc/free as a tiler_ptest argument.
+ * Other calls cannot be expressed in the tiler_ptest grammar.
+ *
+ * @param op     Pointer to the recorded call
+ *
+ * @return 0 if the call was printed, 1 if it was skipped
+ */
+static int print_op(struct rep_op *op)
+{
+    struct rep_buf *buf;
+    int ix;
+
+    if (op->e.op == REC_ALLOC && op->e.ret)
+    {
+        buf = add_buf(op->e.ptr, 0, NULL, NULL);
+        if (!buf) return 1;
+        printf("%d.a:", buf->slot);
+        for (ix = 0; ix < op->e.num_blocks; ix++)
+        {
+            struct record_block *b = op->blocks + ix;
+            if (b->fmt == PIXEL_FMT_PAGE) printf("%u", b->width);
+            else printf("%u*%u*%d", b->width, b->height,
+                        b->fmt == PIXEL_FMT_8BIT ? 8 :
+                        b->fmt == PIXEL_FMT_16BIT ? 16 : 32);
+            printf(ix + 1 < op->e.num_blocks ? "," : " ");
+        }
+        return 0;
+    }
+    else if (op->e.op == REC_FREE && !op->e.ret && (buf = find_buf(op->e.ptr, false)))
+    {
+        printf("%d.f ", buf->slot);
+        del_buf(buf);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Replays a recorded call.
+ *
+ * @param op       Pointer to the recorded call
+ * @param dur_ns   Pointer to where to store the duration of the
+ *                 call
+ *
+ * @return 0 if the call had the same outcome as recorded, 1
+ *         otherwise
+ */
+static int replay_op(struct rep_op *op, uint64_t *dur_ns)
+{
+    MemAllocBlock blks[MAX_BLOCKS];
+    struct rep_buf *buf = NULL;
+    void *bufPtr, *buffer = NULL, *ptr = NULL;
+    uint64_t t, ret;
+    bytes_t size;
+    int ix;
+
+    /* set up block specifications of allocs and maps */
+    memset(blks, 0, sizeof(blks));
+    for (ix = 0; ix < op->e.num_blocks; ix++)
+    {
+        struct record_block *b = op->blocks + ix;
+        blks[ix].pixelFormat = b->fmt;
+        if (b->fmt == PIXEL_FMT_PAGE)
+        {
+            blks[ix].dim.len = b->width;
+            blks[ix].stride = b->stride;
+        }
+        else
+        {
+            blks[ix].dim.area.width = b->width;
+            blks[ix].dim.area.height = b->height;
+            /* 2D maps are replayed with the mapped stride */
+            if (op->e.op == REC_MAP) blks[ix].stride = b->stride;
+        }
+    }
+
+    /* translate pointers into live buffers.  Frees and unmaps of
+       unknown buffers are replayed using NULL, as the recorded
+       pointer may be a valid buffer in this process. */
+    if (op->e.op == REC_FREE || op->e.op == REC_UNMAP)
+    {
+        buf = find_buf(op->e.ptr, false);
+        ptr = buf ? buf->bufPtr : NULL;
+    }
+    else if (op->e.op != REC_ALLOC && op->e.op != REC_MAP)
+    {
+        buf = find_buf(op->e.ptr, true);
+        ptr = buf ? (uint8_t *) buf->bufPtr + (op->e.ptr - buf->rec_ptr) :
+                    (void *) (uintptr_t) op->e.ptr;
+    }
+
+    switch (op->e.op)
+    {
+    case REC_ALLOC:
+        t = BenchLib_Now();
+        bufPtr = MemMgr_Alloc(blks, op->e.num_blocks);
+        *dur_ns = BenchLib_Now() - t;
+        if (bufPtr && !add_buf(op->e.ptr, rec_size(op), bufPtr, NULL)) MemMgr_Free(bufPtr);
+        return !bufPtr != !op->e.ret;
+
+    case REC_MAP:
+        /* map consecutive parts of one page aligned user buffer */
+        size = rec_size(op);
+        if (size)
+        {
+            buffer = malloc(size + PAGE_SIZE - 1);
+            if (NOT_P(buffer,!=,NULL)) return 1;
+            ptr = (void *) ROUND_UP_TO2POW((uintptr_t) buffer, PAGE_SIZE);
+            for (ix = 0; ix < op->e.num_blocks; ix++)
+            {
+                struct record_block *b = op->blocks + ix;
+                blks[ix].ptr = ptr;
+                ptr = (uint8_t *) ptr + (b->fmt == PIXEL_FMT_PAGE ? b->width :
+                                         b->stride * b->height);
+            }
+        }
+        t = BenchLib_Now();
+        bufPtr = op->e.num_blocks == 1 && blks[0].pixelFormat != PIXEL_FMT_PAGE ?
+                 MemMgr_MapIn2DMode(blks) : MemMgr_Map(blks, op->e.num_blocks);
+        *dur_ns = BenchLib_Now() - t;
+        if (bufPtr && !add_buf(op->e.ptr, rec_size(op), bufPtr, buffer))
+        {
+            MemMgr_UnMap(bufPtr);
+            bufPtr = NULL;
+        }
+        if (!bufPtr) FREE(buffer);
+        return !bufPtr != !op->e.ret;
+
+    case REC_FREE:
+    case REC_UNMAP:
+        t = BenchLib_Now();
+        ret = op->e.op == REC_FREE ? MemMgr_Free(ptr) : MemMgr_UnMap(ptr);
+        *dur_ns = BenchLib_Now() - t;
+        if (buf && !ret)
+        {
+            FREE(buf->buffer);
+            del_buf(buf);
+        }
+        return !ret != !op->e.ret;
+
+    case REC_GET_STRIDE:
+        t = BenchLib_Now();
+        ret = MemMgr_GetStride(ptr);
+        break;
+    case REC_IS_1D:
+        t = BenchLib_Now();
+        ret = MemMgr_Is1DBlock(ptr);
+        break;
+    case REC_IS_2D:
+        t = BenchLib_Now();
+        ret = MemMgr_Is2DBlock(ptr);
+        break;
+    case REC_IS_MAPPED:
+        t = BenchLib_Now();
+        ret = MemMgr_IsMapped(ptr);
+        break;
+    case REC_VIRT_TO_PHYS:
+        t = BenchLib_Now();
+        ret = TilerMem_VirtToPhys(ptr);
+        /* system space addresses differ between runs */
+        *dur_ns = BenchLib_Now() - t;
+        return !ret != !op->e.ret;
+    default:
+        return 1;
+    }
+    *dur_ns = BenchLib_Now() - t;
+    return ret != op->e.ret;
+}
+
+/**
+ * Waits until a given monotonic time.
+ *
+ * @param when   Time in ns
+ */
+static void wait_until(uint64_t when)
+{
+    uint64_t now = BenchLib_Now();
+    if (now < when)
+    {
+        struct timespec ts;
+        ts.tv_sec = (when - now) / 1000000000;
+        ts.tv_nsec = (when - now) % 1000000000;
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-t] [-s speed] [-o json_file] <trace>\n"
+            "       %s -p <trace>\n"
+            "   -t:      replay with the recorded inter-arrival times (default\n"
+            "            is to replay as fast as possible)\n"
+            "   -s:      speed-up factor for -t\n"
+            "   -o:      write JSON report into file (- for stdout)\n"
+            "   -p:      print recorded allocs and frees as tiler_ptest arguments\n",
+            prog, prog);
+    fflush(stderr);
+}
+
+/**
+ * Main replay function.  Reads the trace, and replays it or
+ * prints it as tiler_ptest arguments.
+ *
+ * @param argc   Number of arguments
+ * @param argv   Arguments
+ *
+ * @return -1 on usage or error, otherwise # of calls whose
+ *         outcome differed from the recording.
+ */
+int main(int argc, char **argv)
+{
+    struct rep_op *ops;
+    struct record_block *blocks;
+    BenchLib_Samples s[NUM_OPS], all;
+    const char *json = NULL;
+    int timed = 0, print = 0, arg, num, ix, failed = 0, skipped = 0;
+    double speed = 1;
+    uint64_t lag = 0;
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (!strcmp(argv[arg], "-t")) timed = 1;
+        else if (!strcmp(argv[arg], "-p")) print = 1;
+        else if (!strcmp(argv[arg], "-s") && arg + 1 < argc &&
+                 atof(argv[arg + 1]) > 0) speed = atof(argv[++arg]);
+        else if (!strcmp(argv[arg], "-o") && arg + 1 < argc) json = argv[++arg];
+        else break;
+    }
+    if (arg + 1 != argc)
+    {
+        usage(argv[0]);
+        return -1;
+    }
+
+    num = read_trace(argv[arg], &ops, &blocks);
+    if (num < 0) return -1;
+    qsort(ops, num, sizeof(*ops), cmp_ops);
+
+    if (print)
+    {
+        for (ix = 0; ix < num; ix++)
+        {
+            skipped += print_op(ops + ix);
+        }
+        printf("\n");
+        if (skipped) fprintf(stderr, "skipped %d calls other than successful "
+                             "allocs and frees\n", skipped);
+        FREE(ops);
+        FREE(blocks);
+        FREE(bufs);
+        return 0;
+    }
+
+    for (ix = 0; ix < NUM_OPS; ix++)
+    {
+        BenchLib_InitSamples(s + ix, num);
+    }
+    BenchLib_InitSamples(&all, num);
+
+    printf("Replaying %d calls %s\n", num, timed ? "with recorded timing" : "flat-out");
+    fflush(stdout);
+
+    uint64_t start = BenchLib_Now();
+    for (ix = 0; ix < num; ix++)
+    {
+        uint64_t dur_ns = 0;
+        if (timed)
+        {
+            uint64_t when = start + (uint64_t) ((ops[ix].e.ts - ops[0].e.ts) / speed);
+            wait_until(when);
+            lag += BenchLib_Now() - when;
+        }
+        if (replay_op(ops + ix, &dur_ns))
+        {
+            P("%s(%llx) #%u: outcome differs from recording", op_names[ops[ix].e.op < NUM_OPS ? ops[ix].e.op : 0],
+              (unsigned long long) ops[ix].e.ptr, ops[ix].ix);
+            failed++;
+        }
+        if (ops[ix].e.op < NUM_OPS) BenchLib_AddSample(s + ops[ix].e.op, dur_ns);
+        BenchLib_AddSample(&all, dur_ns);
+    }
+    uint64_t elapsed = BenchLib_Now() - start;
+
+    /* release buffers that were live at the end of the recording */
+    while (num_bufs)
+    {
+        if (bufs->buffer) MemMgr_UnMap(bufs->bufPtr);
+        else MemMgr_Free(bufs->bufPtr);
+        FREE(bufs->buffer);
+        del_buf(bufs);
+    }
+
+    for (ix = 1; ix < NUM_OPS; ix++)
+    {
+        if (s[ix].num) BenchLib_Report("replay", op_names[ix], 1, s + ix, elapsed);
+        BenchLib_FreeSamples(s + ix);
+    }
+    BenchLib_FreeSamples(s);
+    BenchLib_Result *r = BenchLib_Report("replay", "all", 1, &all, elapsed);
+    BenchLib_AddMetric(r, "differing_calls", failed);
+    if (timed) BenchLib_AddMetric(r, "avg_lag_ns", num ? lag / num : 0);
+    BenchLib_FreeSamples(&all);
+
+    if (json && BenchLib_WriteReport(json, argv[0], BACKEND)) failed++;
+
+    FREE(ops);
+    FREE(blocks);
+    FREE(bufs);
+    return failed;
+}
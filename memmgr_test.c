@@ -57,6 +57,7 @@
 #include <tilermem.h>
 #include <tilermem_utils.h>
 #include <testlib.h>
+#include <fill_utils.h>
 
 #define FALSE 0
 #define TESTERR_NOTIMPLEMENTED -65378
@@ -111,6 +112,7 @@
     T(neg_unmap_tests())\
     T(neg_check_tests())\
     T(page_size_test())\
+    T(check_level_test())\
     T(maxalloc_2D_test(2500, 32, PIXEL_FMT_8BIT, MAX_ALLOCS))\
     T(maxalloc_2D_test(2500, 16, PIXEL_FMT_16BIT, MAX_ALLOCS))\
     T(maxalloc_2D_test(1250, 16, PIXEL_FMT_32BIT, MAX_ALLOCS))\
@@ -167,10 +169,37 @@
     T(star_tiler_test(1000, 30))\
     T(star_test(100, 10))\
     T(star_test(1000, 10))\
+    T(copy_2D_test(176, 144, PIXEL_FMT_8BIT))\
+    T(copy_2D_test(640, 480, PIXEL_FMT_16BIT))\
+    T(copy_2D_test(1920, 1080, PIXEL_FMT_8BIT))\
+    T(copy_2D_test(1920, 1080, PIXEL_FMT_32BIT))\
+    T(clear_NV12_test(176, 144))\
+    T(clear_NV12_test(1920, 1080))\
+    T(view_2D_test(176, 144, PIXEL_FMT_8BIT))\
+    T(view_2D_test(640, 480, PIXEL_FMT_16BIT))\
+    T(view_2D_test(1920, 1080, PIXEL_FMT_32BIT))\
+    T(xlate_test())\
+    T(crop_2D_test(176, 144, PIXEL_FMT_8BIT))\
+    T(crop_2D_test(1920, 1080, PIXEL_FMT_16BIT))\
+    T(cache_test(176, 144))\
+    T(cache_test(1920, 1080))\
+    T(cache_mode_test(176, 144))\
+    T(cache_mode_test(1920, 1080))\
+    T(map_multi_1D_test(3, 640 * 480))\
+    T(map_multi_1D_test(TILER_MAX_NUM_BLOCKS, 4096))\
+    T(map_2D_test(176, 144, PIXEL_FMT_8BIT, 0))\
+    T(map_2D_test(640, 480, PIXEL_FMT_16BIT, 1536))\
+    T(map_2D_test(1920, 1080, PIXEL_FMT_32BIT, 0))\
+    T(map_unaligned_1D_test(3, 2 * PAGE_SIZE - 5))\
+    T(map_unaligned_1D_test(PAGE_SIZE - 1, 100))\
+    T(map_unaligned_1D_test(0, 176 * 144 * 3 / 2))\
+    T(map_cache_test(3, 4096))\
+    T(map_cache_test(8, 640 * 480 * 2))\
 
 /* this is defined in memmgr.c, but not exported as it is for internal
    use only */
 extern int __test__MemMgr();
+extern int __test__CacheCheck();
 
 /**
  * Returns the default page stride for this block
@@ -210,6 +239,10 @@ static bytes_t def_bpp(pixel_fmt_t pixelFormat)
  * such.  This series only repeats after 704189 values, so the
  * probability of a match for a range of at least 2 values is
  * less than 2*10^-11.
+ * <p>
+ * If MEMMGR_FILL=hash, the hash pattern of fill_utils.h is used
+ * instead, which is filled a vector at a time and does not touch
+ * the stride padding.
  *
  * V(i + 1) - V(i) = { 1, 2, 3, ..., 65535, 2, 4, 6, 8 ...,
  * 65534, 3, 6, 9, 12, ..., 4, 8, 12, 16, ... }
@@ -241,6 +274,12 @@ void fill_mem(uint16_t start, MemAllocBlock *block)
     P("(%p,0x%x*0x%x,s=0x%x)=0x%x", block->ptr, width, height, stride, start);
 
     CHK_I(width,<=,stride);
+    if (FillUtils_Mode() == FILL_MODE_HASH)
+    {
+        FillUtils_Fill(start, block->ptr, width, height, stride);
+        OUT;
+        return;
+    }
     uint32_t *ptr32 = (uint32_t *)ptr;
     while (height--)
     {
@@ -326,6 +365,15 @@ int check_mem(uint16_t start, MemAllocBlock *block)
     width *= def_bpp(block->pixelFormat);
 
     CHK_I(width,<=,stride);
+    if (FillUtils_Mode() == FILL_MODE_HASH)
+    {
+        if (FillUtils_Check(start, block->ptr, width, height, stride, &r, &i))
+        {
+            DP("assert: hash pattern mismatch at [%u,%u]", r, i);
+            return R_I(MEMMGR_ERR_GENERIC);
+        }
+        return R_I(MEMMGR_ERR_NONE);
+    }
     uint32_t *ptr32 = (uint32_t *)ptr;
     for (r = 0; r < height; r++)
     {
@@ -390,6 +438,32 @@ int check_mem(uint16_t start, MemAllocBlock *block)
     return R_I(MEMMGR_ERR_NONE);
 }
 
+/**
+ * This verifies that the rows of two 2D regions of the same
+ * size and format are identical.  Unlike check_mem, it does not
+ * depend on the fill pattern being stride independent.
+ *
+ * @param a   pointer to first block info structure
+ * @param b   pointer to second block info structure
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int cmp_rows(MemAllocBlock *a, MemAllocBlock *b)
+{
+    IN;
+    bytes_t width = a->dim.area.width * def_bpp(a->pixelFormat), r;
+    for (r = 0; r < a->dim.area.height; r++)
+    {
+        if (memcmp((uint8_t *)a->ptr + r * a->stride,
+                   (uint8_t *)b->ptr + r * b->stride, width))
+        {
+            DP("assert: row %u differs", r);
+            return R_I(MEMMGR_ERR_GENERIC);
+        }
+    }
+    return R_I(MEMMGR_ERR_NONE);
+}
+
 /**
  * This method allocates a 1D tiled buffer of the given length
  * and stride using MemMgr_Alloc.  If successful, it checks
@@ -763,6 +837,85 @@ int page_size_test()
     return NOT_I(MemMgr_PageSize(),==,PAGE_SIZE);
 }
 
+/**
+ * Tests the tiler address translation functions.  It decodes
+ * and encodes the corners and some inner points of each
+ * container, singly and batched, and the rows of a rectangle.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int xlate_test()
+{
+    static const SSPtr bases[] = { TILER_MEM_8BIT, TILER_MEM_16BIT,
+                                   TILER_MEM_32BIT, TILER_MEM_PAGED };
+    static const bytes_t strides[] = { TILER_STRIDE_8BIT, TILER_STRIDE_16BIT,
+                                       TILER_STRIDE_32BIT, PAGE_SIZE };
+    static const bytes_t bpps[] = { 1, 2, 4, 1 };
+    SSPtr ssptrs[8], out[8], rows[16];
+    pixels_t x[8], y[8], bx[8], by[8];
+    int f, ix, ret = 0;
+
+    ret |= NOT_I(TilerMem_GetFmt(0),==,TILFMT_INVALID);
+    ret |= NOT_I(TilerMem_GetFmt(TILER_MEM_8BIT - 1),==,TILFMT_NONE);
+    ret |= NOT_I(TilerMem_GetFmt(TILER_MEM_END),==,TILFMT_NONE);
+
+    for (f = 0; !ret && f < 4; f++)
+    {
+        enum tiler_fmt fmt = (enum tiler_fmt) (TILFMT_8BIT + f);
+        pixels_t w = strides[f] / bpps[f], h = TILER_LENGTH / strides[f];
+
+        ret |= NOT_I(TilerMem_ContainerBase(fmt),==,bases[f]);
+        ret |= NOT_I(TilerMem_GetFmt(bases[f]),==,fmt);
+        ret |= NOT_I(TilerMem_GetFmt(bases[f] + TILER_LENGTH - 1),==,fmt);
+
+        /* corners and inner points */
+        x[0] = 0; y[0] = 0;
+        x[1] = w - 1; y[1] = 0;
+        x[2] = 0; y[2] = h - 1;
+        x[3] = w - 1; y[3] = h - 1;
+        for (ix = 4; ix < 8; ix++)
+        {
+            x[ix] = rand() % w;
+            y[ix] = rand() % h;
+        }
+        for (ix = 0; !ret && ix < 8; ix++)
+        {
+            pixels_t dx = 0, dy = 0;
+            ssptrs[ix] = TilerMem_XYToSSPtr(fmt, x[ix], y[ix]);
+            ret |= NOT_I(ssptrs[ix],==,bases[f] + y[ix] * strides[f] +
+                         x[ix] * bpps[f]);
+            ret |= NOT_I(TilerMem_SSPtrToXY(ssptrs[ix], &dx, &dy),==,fmt);
+            ret |= NOT_I(dx,==,x[ix]);
+            ret |= NOT_I(dy,==,y[ix]);
+        }
+
+        /* batched forms */
+        TilerMem_XYToSSPtrs(fmt, x, y, out, 8);
+        TilerMem_SSPtrsToXY(fmt, ssptrs, bx, by, 8);
+        for (ix = 0; !ret && ix < 8; ix++)
+        {
+            ret |= NOT_I(out[ix],==,ssptrs[ix]);
+            ret |= NOT_I(bx[ix],==,x[ix]);
+            ret |= NOT_I(by[ix],==,y[ix]);
+        }
+
+        /* outside the container */
+        ret |= NOT_I(TilerMem_XYToSSPtr(fmt, w, 0),==,0);
+        ret |= NOT_I(TilerMem_XYToSSPtr(fmt, 0, h),==,0);
+
+        /* rectangle rows */
+        ret |= NOT_I(TilerMem_RectRows(ssptrs[0], 16, rows),==,0);
+        for (ix = 0; !ret && ix < 16; ix++)
+        {
+            ret |= NOT_I(rows[ix],==,ssptrs[0] + ix * strides[f]);
+        }
+        ret |= NOT_I(TilerMem_RectRows(ssptrs[2], 2, rows),!=,0);
+    }
+    ret |= NOT_I(TilerMem_XYToSSPtr(TILFMT_NONE, 0, 0),==,0);
+    ret |= NOT_I(TilerMem_RectRows(TILER_MEM_END, 1, rows),!=,0);
+    return ret;
+}
+
 /**
  * This method tests the allocation and freeing of a 1D tiled
  * buffer.
@@ -860,6 +1013,857 @@ int map_1D_test(bytes_t length, bytes_t stride)
     return res;
 }
 
+/**
+ * This method tests mapping several separately allocated 1D
+ * buffers as one tiler buffer, and that a failure to map one
+ * of the buffers leaves none of them mapped.
+ *
+ * @param num_blocks  Number of buffers
+ * @param length      Length of each buffer
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int map_multi_1D_test(int num_blocks, bytes_t length)
+{
+    length = (length + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1);
+    printf("Mapping and UnMapping %d 0x%xb 1D buffers as one buffer\n",
+           num_blocks, length);
+
+#ifdef __MAP_OK__
+    MemAllocBlock blocks[TILER_MAX_NUM_BLOCKS];
+    void *buffers[TILER_MAX_NUM_BLOCKS], *dataPtrs[TILER_MAX_NUM_BLOCKS];
+    uint16_t vals[TILER_MAX_NUM_BLOCKS];
+    int ix, ret = 0;
+
+    /* allocate aligned buffers */
+    memset(blocks, 0, sizeof(blocks));
+    memset(buffers, 0, sizeof(buffers));
+    for (ix = 0; ix < num_blocks && !ret; ix++)
+    {
+        buffers[ix] = malloc(length + PAGE_SIZE - 1);
+        ret = NOT_P(buffers[ix],!=,NULL);
+        dataPtrs[ix] = (void *)(((uint32_t)buffers[ix] + PAGE_SIZE - 1) &~
+                                (PAGE_SIZE - 1));
+        blocks[ix].pixelFormat = PIXEL_FMT_PAGE;
+        blocks[ix].dim.len = length;
+        blocks[ix].ptr = dataPtrs[ix];
+        vals[ix] = (uint16_t) rand();
+        if (!ret) fill_mem(vals[ix], blocks + ix);
+    }
+
+    /* blocks are mapped consecutively */
+    void *bufPtr = ret ? NULL : MemMgr_Map(blocks, num_blocks);
+    ret |= NOT_P(bufPtr,!=,NULL);
+    for (ix = 0; ix < num_blocks && !ret; ix++)
+    {
+        ret |= NOT_P(blocks[ix].ptr,==,bufPtr + length * ix) ||
+               NOT_I(MemMgr_IsMapped(blocks[ix].ptr),!=,0) ||
+               NOT_I(MemMgr_Is1DBlock(blocks[ix].ptr),!=,0);
+    }
+    if (bufPtr) ERR_ADD(ret, MemMgr_UnMap(bufPtr));
+
+    /* the last block cannot be mapped (the first page is never mapped in
+       the process), so the already mapped blocks are unmapped */
+    if (!ret)
+    {
+        memset(blocks, 0, sizeof(blocks));
+        for (ix = 0; ix < num_blocks; ix++)
+        {
+            blocks[ix].pixelFormat = PIXEL_FMT_PAGE;
+            blocks[ix].dim.len = length;
+            blocks[ix].ptr = dataPtrs[ix];
+        }
+        blocks[num_blocks - 1].ptr = (void *) PAGE_SIZE;
+        ret |= NOT_P(MemMgr_Map(blocks, num_blocks),==,NULL);
+        ret |= NOT_P(blocks[0].ptr,==,NULL);
+    }
+
+    /* the user buffers are intact */
+    for (ix = 0; ix < num_blocks && buffers[ix]; ix++)
+    {
+        blocks[ix].ptr = dataPtrs[ix];
+        if (!ret) ret |= NOT_I(check_mem(vals[ix], blocks + ix),==,0);
+        FREE(buffers[ix]);
+    }
+#else
+    int ret = TESTERR_NOTIMPLEMENTED;
+#endif
+    return ret;
+}
+
+/**
+ * This method tests mapping 1D buffers that are not page
+ * aligned.  The mapped buffer has the same offset in its first
+ * page as the user buffer.  Also maps a page aligned buffer
+ * after the unaligned one in the same call.
+ *
+ * @param offset  Offset of the buffer in its first page
+ * @param length  Buffer length
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int map_unaligned_1D_test(bytes_t offset, bytes_t length)
+{
+    printf("Mapping and UnMapping 0x%xb 1D buffer at page offset 0x%x\n",
+           length, offset);
+
+#ifdef __MAP_OK__
+    MemAllocBlock blocks[2];
+    bytes_t pages = (offset + length + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1);
+    void *buffer = malloc(pages + 2 * PAGE_SIZE);
+    if (NOT_P(buffer,!=,NULL)) return 1;
+    void *dataPtr = (void *)(((uint32_t)buffer + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1));
+
+    memset(blocks, 0, sizeof(blocks));
+    blocks[0].pixelFormat = blocks[1].pixelFormat = PIXEL_FMT_PAGE;
+    blocks[0].dim.len = length;
+    blocks[0].ptr = dataPtr + offset;
+    blocks[1].dim.len = PAGE_SIZE;
+    blocks[1].ptr = dataPtr + pages;
+    uint16_t val = (uint16_t) rand();
+    fill_mem(val, blocks);
+
+    int ix, ret = 0;
+    for (ix = 1; ix <= 2 && !ret; ix++)
+    {
+        void *bufPtr = MemMgr_Map(blocks, ix);
+        ret = NOT_P(bufPtr,!=,NULL);
+        if (ret) break;
+
+        /* the enclosing pages are mapped consecutively */
+        ret |= NOT_P(bufPtr,==,blocks[0].ptr) ||
+               NOT_L((PAGE_SIZE - 1) & (long)bufPtr,==,offset) ||
+               NOT_I(MemMgr_IsMapped(bufPtr),!=,0) ||
+               NOT_I(MemMgr_IsMapped(bufPtr + length - 1),!=,0) ||
+               NOT_I(MemMgr_Is1DBlock(bufPtr),!=,0) ||
+               NOT_P(TilerMem_VirtToPhys(bufPtr),==,blocks[0].reserved) ||
+               NOT_L(blocks[0].dim.len,==,length);
+        if (ix == 2)
+        {
+            ret |= NOT_P(blocks[1].ptr,==,bufPtr - offset + pages) ||
+                   NOT_I(MemMgr_IsMapped(blocks[1].ptr),!=,0);
+        }
+        ERR_ADD(ret, MemMgr_UnMap(bufPtr));
+
+        /* the user buffer is intact */
+        blocks[0].ptr = dataPtr + offset;
+        blocks[1].ptr = dataPtr + pages;
+        blocks[0].reserved = blocks[1].reserved = 0;
+        if (!ret) ret |= NOT_I(check_mem(val, blocks),==,0);
+    }
+
+    FREE(buffer);
+#else
+    int ret = TESTERR_NOTIMPLEMENTED;
+#endif
+    return ret;
+}
+
+/**
+ * This method tests mapping a user allocated frame in 2D mode,
+ * and that the frame is visible through the mapping.  It also
+ * checks that invalid frames are not mapped.
+ *
+ * @param width   Frame width
+ * @param height  Frame height
+ * @param fmt     Pixel format
+ * @param stride  Frame stride, or 0 for packed rows
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int map_2D_test(pixels_t width, pixels_t height, pixel_fmt_t fmt,
+                bytes_t stride)
+{
+    printf("Mapping and UnMapping %ux%u %ub frame with stride %u in 2D mode\n",
+           width, height, def_bpp(fmt) * 8, stride);
+
+#ifdef __MAP_OK__
+    bytes_t row = width * def_bpp(fmt);
+    MemAllocBlock block, frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.pixelFormat = fmt;
+    frame.dim.area.width = width;
+    frame.dim.area.height = height;
+    frame.stride = stride ? stride : row;
+
+    /* allocate aligned frame */
+    void *buffer = malloc(frame.stride * height + PAGE_SIZE - 1);
+    if (NOT_P(buffer,!=,NULL)) return 1;
+    frame.ptr = (void *)(((uint32_t)buffer + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1));
+    uint16_t val = (uint16_t) rand();
+    fill_mem(val, &frame);
+
+    block = frame;
+    block.stride = stride;
+    void *bufPtr = MemMgr_MapIn2DMode(&block);
+    int ret = NOT_P(bufPtr,!=,NULL);
+    if (!ret)
+    {
+        ret |= NOT_P(block.ptr,==,bufPtr) ||
+               NOT_I(MemMgr_IsMapped(bufPtr),!=,0) ||
+               NOT_I(MemMgr_Is2DBlock(bufPtr),!=,0) ||
+               NOT_I(MemMgr_Is1DBlock(bufPtr),==,0) ||
+               NOT_I(MemMgr_GetStride(bufPtr),==,block.stride) ||
+               NOT_L(block.reserved,!=,0) ||
+               NOT_P(TilerMem_VirtToPhys(bufPtr),==,block.reserved) ||
+               NOT_I(cmp_rows(&block, &frame),==,0);
+        ERR_ADD(ret, MemMgr_UnMap(bufPtr));
+    }
+
+    /* the user frame is intact */
+    ret |= NOT_I(check_mem(val, &frame),==,0);
+
+    P("/* NULL block, 1D format, stride too small, unaligned frame */");
+    ret |= NOT_P(MemMgr_MapIn2DMode(NULL),==,NULL);
+    block = frame;
+    block.pixelFormat = PIXEL_FMT_PAGE;
+    ret |= NOT_P(MemMgr_MapIn2DMode(&block),==,NULL);
+    block = frame;
+    block.stride = row - 1;
+    ret |= NOT_P(MemMgr_MapIn2DMode(&block),==,NULL);
+    block = frame;
+    block.ptr = frame.ptr + 3;
+    ret |= NOT_P(MemMgr_MapIn2DMode(&block),==,NULL);
+
+    FREE(buffer);
+#else
+    int ret = TESTERR_NOTIMPLEMENTED;
+#endif
+    return ret;
+}
+
+/**
+ * This method tests the map cache with a ring of user buffers
+ * that is one buffer larger than the cache.  Repeated maps of
+ * the same buffers reuse the cached mappings, and the least
+ * recently used idle mapping is evicted.
+ *
+ * @param num_bufs  Number of user buffers in the ring (at least 3)
+ * @param length    Buffer length
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int map_cache_test(int num_bufs, bytes_t length)
+{
+    length = (length + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1);
+    printf("Mapping and UnMapping a ring of %d 0x%xb 1D buffers with the "
+           "map cache\n", num_bufs, length);
+
+#ifdef __MAP_OK__
+    MemAllocBlock block;
+    MemMgr_Stats stats;
+    void *buffer = malloc(num_bufs * length + PAGE_SIZE - 1), *bufPtr;
+    if (NOT_P(buffer,!=,NULL)) return 1;
+    void *dataPtr = (void *)(((uint32_t)buffer + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1));
+    int ix, ret = 0;
+
+    /* invalid cache size */
+    ret |= NOT_I(MemMgr_SetMapCache(-1),!=,0);
+    ret |= NOT_I(MemMgr_SetMapCache(num_bufs - 1),==,0);
+    MemMgr_GetStats(&stats, true);
+
+    /* a repeated map of the same buffer returns the cached mapping, even
+       while it is still mapped */
+    ZERO(block);
+    block.pixelFormat = PIXEL_FMT_PAGE;
+    block.dim.len = length;
+    block.ptr = dataPtr;
+    void *cached = MemMgr_Map(&block, 1);
+    ret |= NOT_P(cached,!=,NULL);
+    if (cached)
+    {
+        ret |= NOT_I(MemMgr_UnMap(cached),==,0) ||
+               NOT_I(MemMgr_IsMapped(cached),!=,0);
+        for (ix = 0; ix < 2; ix++)
+        {
+            block.ptr = dataPtr;
+            block.reserved = 0;
+            bufPtr = MemMgr_Map(&block, 1);
+            ret |= NOT_P(bufPtr,==,cached) || NOT_P(block.ptr,==,cached);
+        }
+        ret |= NOT_I(MemMgr_UnMap(cached),==,0) ||
+               NOT_I(MemMgr_UnMap(cached),==,0) ||
+               NOT_I(MemMgr_UnMap(cached),!=,0);
+    }
+
+    /* mapping the ring evicts the least recently used mapping */
+    for (ix = 1; ix <= num_bufs && !ret; ix++)
+    {
+        ZERO(block);
+        block.pixelFormat = PIXEL_FMT_PAGE;
+        block.dim.len = length;
+        block.ptr = dataPtr + (ix % num_bufs) * length;
+        bufPtr = MemMgr_Map(&block, 1);
+        ret |= NOT_P(bufPtr,!=,NULL);
+        if (bufPtr) ret |= NOT_I(MemMgr_UnMap(bufPtr),==,0);
+    }
+    MemMgr_GetStats(&stats, true);
+    ret |= NOT_L(stats.map_cache_hits,==,2) ||
+           NOT_L(stats.map_cache_misses,==,num_bufs + 1) ||
+           NOT_L(stats.map_cache_evictions,==,2);
+
+    /* the last buffer is still cached */
+    ZERO(block);
+    block.pixelFormat = PIXEL_FMT_PAGE;
+    block.dim.len = length;
+    block.ptr = dataPtr + (num_bufs - 1) * length;
+    bufPtr = MemMgr_Map(&block, 1);
+    ret |= NOT_P(bufPtr,!=,NULL);
+    if (bufPtr)
+    {
+        /* flushing keeps the mappings in use */
+        ret |= NOT_I(MemMgr_FlushMapCache(),==,0) ||
+               NOT_I(MemMgr_IsMapped(bufPtr),!=,0);
+        ret |= NOT_I(MemMgr_UnMap(bufPtr),==,0);
+    }
+    MemMgr_GetStats(&stats, true);
+    ret |= NOT_L(stats.map_cache_hits,==,1) ||
+           NOT_L(stats.map_cache_evictions,==,num_bufs - 2);
+
+    /* disabling the cache unmaps the rest */
+    ret |= NOT_I(MemMgr_SetMapCache(0),==,0);
+    MemMgr_GetStats(&stats, true);
+    ret |= NOT_L(stats.map_cache_evictions,==,1);
+
+    FREE(buffer);
+#else
+    int ret = TESTERR_NOTIMPLEMENTED;
+#endif
+    return ret;
+}
+
+/**
+ * This method tests copying a 2D tiled buffer into a linear
+ * frame and back using MemMgr_CopyFromBlock and
+ * MemMgr_CopyToBlock, with the stride of the block looked up.
+ *
+ * @param width    Buffer width
+ * @param height   Buffer height
+ * @param fmt      Pixel format
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int copy_2D_test(pixels_t width, pixels_t height, pixel_fmt_t fmt)
+{
+    printf("Copy %ux%ux%ub 2D buffer to and from a frame\n", width, height,
+           def_bpp(fmt));
+
+    MemAllocBlock frame, block, tiled;
+    memset(&frame, 0, sizeof(frame));
+    frame.pixelFormat = fmt;
+    frame.dim.area.width  = width;
+    frame.dim.area.height = height;
+    frame.stride = width * def_bpp(fmt);
+    frame.ptr = malloc(frame.stride * height);
+    if (NOT_P(frame.ptr,!=,NULL)) return 1;
+
+    uint16_t val = (uint16_t) rand();
+    void *ptr = alloc_2D(width, height, fmt, 0, val);
+    if (!ptr)
+    {
+        FREE(frame.ptr);
+        return 1;
+    }
+    block = frame;
+    block.stride = 0;
+    block.ptr = ptr;
+    tiled = block;
+    tiled.stride = MemMgr_GetStride(ptr);
+
+    /* block to frame */
+    int ret = A_I(MemMgr_CopyFromBlock(frame.ptr, 0, &block),==,0);
+    if (!ret) ret = A_I(cmp_rows(&frame, &tiled),==,0);
+
+    /* frame to block */
+    fill_mem(val + 1, &frame);
+    if (!ret) ret = A_I(MemMgr_CopyToBlock(&block, frame.ptr, 0),==,0);
+    if (!ret) ret = A_I(cmp_rows(&tiled, &frame),==,0);
+
+    /* invalid regions */
+    ret |= NOT_I(MemMgr_Copy2D(NULL, frame.stride, frame.ptr, frame.stride,
+                               frame.stride, height),!=,0);
+    ret |= NOT_I(MemMgr_Copy2D(ptr, frame.stride, frame.ptr, frame.stride,
+                               frame.stride + 1, 2),!=,0);
+
+    ERR_ADD(ret, MemMgr_Free(ptr));
+    FREE(frame.ptr);
+    return ret;
+}
+
+/**
+ * This method tests clearing an NV12 tiled buffer with
+ * MemMgr_ClearNV12, and filling its Y block with MemMgr_Fill2D.
+ * It verifies the written values, and that the stride padding
+ * is not written.
+ *
+ * @param width    Buffer width
+ * @param height   Buffer height
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int clear_NV12_test(pixels_t width, pixels_t height)
+{
+    printf("Clear & Fill %ux%u NV12 buffer\n", width, height);
+
+    uint16_t val = (uint16_t) rand();
+    void *ptr = alloc_NV12(width, height, val);
+    if (!ptr) return 1;
+
+    bytes_t stride = def_stride(width), rows = height * 3 / 2, r, i;
+    uint8_t *y = ptr, *uv = y + stride * height, bytes[4] = { 1, 2, 3, 4 };
+    uint32_t pattern;
+    int ret = 0;
+
+    /* mark the stride padding */
+    for (r = 0; stride > width && r < rows; r++) y[r * stride + width] = 0xA5;
+
+    ret |= A_I(MemMgr_ClearNV12(ptr, 16, 128, 128),==,0);
+    for (r = 0; !ret && r < rows; r++)
+    {
+        for (i = 0; !ret && i < width; i++)
+        {
+            ret = NOT_I(y[r * stride + i],==,r < height ? 16 : 128);
+        }
+        if (!ret && stride > width) ret = NOT_I(y[r * stride + width],==,0xA5);
+    }
+
+    /* fill all but the last column of the Y block */
+    memcpy(&pattern, bytes, sizeof(pattern));
+    if (!ret) ret = A_I(MemMgr_Fill2D(ptr, pattern, width - 1, height),==,0);
+    for (r = 0; !ret && r < height; r++)
+    {
+        for (i = 0; !ret && i < width - 1; i++)
+        {
+            ret = NOT_I(y[r * stride + i],==,bytes[i & 3]);
+        }
+        if (!ret) ret = NOT_I(y[r * stride + width - 1],==,16);
+    }
+
+    /* not the start of an NV12 buffer */
+    ret |= NOT_I(MemMgr_ClearNV12(NULL, 16, 128, 128),!=,0);
+    ret |= NOT_I(MemMgr_ClearNV12(uv, 16, 128, 128),!=,0);
+
+    ERR_ADD(ret, MemMgr_Free(ptr));
+    return ret;
+}
+
+/**
+ * Returns the tiler address that a view reports for a pixel of
+ * the natural view, given its system space address.
+ *
+ * @param ssptr   System space address of the pixel
+ *
+ * @return tiler address of the pixel in the natural view
+ */
+static SSPtr natural_view_ssptr(SSPtr ssptr)
+{
+#ifndef STUB_TILER
+    /* views are addressed in tiler space, not in its system alias */
+    return ssptr - TILER_MEM_8BIT;
+#else
+    /* the emulated tiler uses the virtual address of the pixel */
+    return ssptr;
+#endif
+}
+
+/**
+ * This method tests the orientation views of a 2D buffer.  It
+ * verifies the size, mapping, tiler address and stride of each
+ * view, and that the view pixels translate to the rotated or
+ * mirrored natural pixels.
+ *
+ * @param width    Buffer width
+ * @param height   Buffer height
+ * @param fmt      Pixel format
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int view_2D_test(pixels_t width, pixels_t height, pixel_fmt_t fmt)
+{
+    printf("Views of %ux%ux%ub 2D buffer\n", width, height, def_bpp(fmt));
+
+    static const int orients[] = {
+        MEMMGR_ROTATE_0, MEMMGR_ROTATE_90, MEMMGR_ROTATE_180,
+        MEMMGR_ROTATE_270, MEMMGR_ORIENT_X_INVERT, MEMMGR_ORIENT_Y_INVERT,
+        MEMMGR_ORIENT_XY_FLIP,
+        MEMMGR_ORIENT_XY_FLIP | MEMMGR_ORIENT_X_INVERT | MEMMGR_ORIENT_Y_INVERT
+    };
+    uint16_t val = (uint16_t) rand();
+    void *ptr = alloc_2D(width, height, fmt, 0, val);
+    if (!ptr) return 1;
+
+    bytes_t bpp = def_bpp(fmt), stride = MemMgr_GetStride(ptr);
+    bytes_t nat_stride = TilerMem_GetStride(TilerMem_VirtToPhys(ptr));
+    bytes_t flip_stride = 0;
+    MemMgr_View view;
+    int ix, ret = 0;
+
+    for (ix = 0; !ret && ix < (int) (sizeof(orients) / sizeof(*orients)); ix++)
+    {
+        int o = orients[ix], flip = o & MEMMGR_ORIENT_XY_FLIP;
+        uint32_t x, y, nx, ny, step;
+        ret = A_I(MemMgr_GetView(ptr, o, &view),==,0);
+        if (ret) break;
+
+        ret |= NOT_I(view.width,==,flip ? height : width);
+        ret |= NOT_I(view.height,==,flip ? width : height);
+        if (o)
+        {
+            ret |= NOT_P(view.ptr,==,NULL);
+        }
+        else
+        {
+            ret |= NOT_P(view.ptr,==,ptr);
+            ret |= NOT_I(view.ptr_stride,==,stride);
+            ret |= NOT_I(view.ssptr,==,
+                         natural_view_ssptr(TilerMem_VirtToPhys(ptr)));
+        }
+#ifndef STUB_TILER
+        /* every view is in tiler space, with its orientation */
+        ret |= NOT_I(view.ssptr >> 29,==,o);
+#endif
+
+        /* XY flipped views share the transposed container stride */
+        if (!flip)
+            ret |= NOT_I(view.stride,==,nat_stride);
+        else if (!flip_stride)
+            flip_stride = view.stride;
+        else
+            ret |= NOT_I(view.stride,==,flip_stride);
+
+        /* check the corners, and a diagonal of pixels */
+        step = view.width > view.height ? view.width : view.height;
+        step = step > 64 ? step / 64 : 1;
+        for (x = y = 0; !ret && x < view.width && y < view.height;
+             x += step, y += step)
+        {
+            uint32_t cx[3] = { x, 0, view.width - 1 };
+            uint32_t cy[3] = { y, view.height - 1, 0 };
+            int c;
+            for (c = 0; !ret && c < 3; c++)
+            {
+                switch (o)
+                {
+                case MEMMGR_ROTATE_0:
+                    nx = cx[c]; ny = cy[c]; break;
+                case MEMMGR_ROTATE_90:
+                    nx = cy[c]; ny = height - 1 - cx[c]; break;
+                case MEMMGR_ROTATE_180:
+                    nx = width - 1 - cx[c]; ny = height - 1 - cy[c]; break;
+                case MEMMGR_ROTATE_270:
+                    nx = width - 1 - cy[c]; ny = cx[c]; break;
+                case MEMMGR_ORIENT_X_INVERT:
+                    nx = width - 1 - cx[c]; ny = cy[c]; break;
+                case MEMMGR_ORIENT_Y_INVERT:
+                    nx = cx[c]; ny = height - 1 - cy[c]; break;
+                case MEMMGR_ORIENT_XY_FLIP:
+                    nx = cy[c]; ny = cx[c]; break;
+                default:
+                    nx = width - 1 - cy[c]; ny = height - 1 - cx[c]; break;
+                }
+                ret = NOT_P(MemMgr_ViewPixel(&view, cx[c], cy[c]),==,
+                            (uint8_t *) ptr + ny * stride + nx * bpp);
+            }
+        }
+        ret |= NOT_P(MemMgr_ViewPixel(&view, view.width, 0),==,NULL);
+        ret |= NOT_P(MemMgr_ViewPixel(&view, 0, view.height),==,NULL);
+    }
+    ret |= NOT_I(flip_stride,!=,0);
+
+    /* invalid views */
+    ret |= NOT_I(MemMgr_GetView(ptr, 8, &view),!=,0);
+    ret |= NOT_I(MemMgr_GetView((uint8_t *) ptr + stride, 0, &view),!=,0);
+    ret |= NOT_I(MemMgr_GetView(NULL, 0, &view),!=,0);
+
+    ERR_ADD(ret, free_2D(width, height, fmt, 0, val, ptr));
+    return ret;
+}
+
+/**
+ * This method tests sub-rectangle views of a 2D buffer.  It
+ * verifies the addresses and strides of crops at the corners
+ * and in the middle of the buffer, that a crop can be copied
+ * out, and that rectangles outside the buffer are rejected.
+ *
+ * @param width    Buffer width
+ * @param height   Buffer height
+ * @param fmt      Pixel format
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int crop_2D_test(pixels_t width, pixels_t height, pixel_fmt_t fmt)
+{
+    printf("Crop views of %ux%ux%ub 2D buffer\n", width, height,
+           def_bpp(fmt));
+
+    uint16_t val = (uint16_t) rand();
+    void *ptr = alloc_2D(width, height, fmt, 0, val);
+    if (!ptr) return 1;
+
+    bytes_t bpp = def_bpp(fmt), stride = MemMgr_GetStride(ptr);
+    SSPtr ssptr = TilerMem_VirtToPhys(ptr);
+    bytes_t tiler_stride = TilerMem_GetStride(ssptr);
+    pixels_t cw = width / 2, ch = height / 2;
+    pixels_t xs[4] = { 0, width - cw, 0, width / 4 };
+    pixels_t ys[4] = { 0, 0, height - ch, height / 4 };
+    MemMgr_View view;
+    int ix, ret = 0;
+
+    for (ix = 0; !ret && ix < 4; ix++)
+    {
+        ret = A_I(MemMgr_CreateView(ptr, xs[ix], ys[ix], cw, ch, &view),==,0);
+        if (ret) break;
+
+        uint8_t *p = (uint8_t *) ptr + ys[ix] * stride + xs[ix] * bpp;
+        ret |= NOT_I(view.width,==,cw);
+        ret |= NOT_I(view.height,==,ch);
+        ret |= NOT_P(view.ptr,==,p);
+        ret |= NOT_I(view.ptr_stride,==,stride);
+        ret |= NOT_I(view.stride,==,tiler_stride);
+        ret |= NOT_I(view.ssptr,==,natural_view_ssptr(TilerMem_VirtToPhys(p)));
+        ret |= NOT_P(MemMgr_ViewPixel(&view, cw - 1, ch - 1),==,
+                     p + (ch - 1) * stride + (cw - 1) * bpp);
+    }
+
+    /* copy out the middle crop, and check it against the block */
+    uint8_t *frame = malloc(cw * bpp * ch);
+    if (NOT_P(frame,!=,NULL)) ret = 1;
+    if (!ret) ret = A_I(MemMgr_Copy2D(frame, cw * bpp, view.ptr,
+                                      view.ptr_stride, cw * bpp, ch),==,0);
+    for (ix = 0; !ret && ix < ch; ix++)
+    {
+        ret = NOT_I(memcmp(frame + ix * cw * bpp,
+                           (uint8_t *) view.ptr + ix * stride, cw * bpp),==,0);
+    }
+    FREE(frame);
+
+    /* invalid rectangles */
+    ret |= NOT_I(MemMgr_CreateView(ptr, 0, 0, 0, ch, &view),!=,0);
+    ret |= NOT_I(MemMgr_CreateView(ptr, 0, 0, cw, 0, &view),!=,0);
+    ret |= NOT_I(MemMgr_CreateView(ptr, width - cw + 1, 0, cw, ch,
+                                   &view),!=,0);
+    ret |= NOT_I(MemMgr_CreateView(ptr, 0, height - ch + 1, cw, ch,
+                                   &view),!=,0);
+    ret |= NOT_I(MemMgr_CreateView(ptr, 0, 0, width, height, NULL),!=,0);
+    ret |= NOT_I(MemMgr_CreateView(NULL, 0, 0, cw, ch, &view),!=,0);
+
+    ERR_ADD(ret, free_2D(width, height, fmt, 0, val, ptr));
+    return ret;
+}
+
+/**
+ * This method tests the cache maintenance functions on a buffer
+ * with a 2D and a 1D block, and on non-tiler memory.  It
+ * verifies the maintained and skipped byte counts.
+ *
+ * @param width    Width of the 2D block (and length of the 1D
+ *                 block in pages)
+ * @param height   Height of the 2D block
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int cache_test(pixels_t width, pixels_t height)
+{
+    printf("Cache maintenance of %ux%u 2D + %u page 1D buffer\n", width,
+           height, width);
+
+#ifdef STUB_TILER
+    MemAllocBlock blks[2];
+    memset(blks, 0, sizeof(blks));
+    blks[0].pixelFormat = PIXEL_FMT_8BIT;
+    blks[0].dim.area.width = width;
+    blks[0].dim.area.height = height;
+    blks[1].pixelFormat = PIXEL_FMT_PAGE;
+    blks[1].dim.len = width * PAGE_SIZE;
+
+    void *bufPtr = MemMgr_Alloc(blks, 2);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+
+    /* the buffer may start inside the first page of the 2D block */
+    bytes_t size2d = (uint8_t *) blks[1].ptr - (uint8_t *) bufPtr;
+    bytes_t size1d = blks[1].dim.len;
+    uint8_t *mem = malloc(4 * PAGE_SIZE), *line;
+    MemMgr_Range ranges[2];
+    MemMgr_Stats stats;
+    int ret = NOT_P(mem,!=,NULL);
+    if (ret)
+    {
+        MemMgr_Free(bufPtr);
+        return ret;
+    }
+    line = (uint8_t *) (((unsigned long) mem + PAGE_SIZE - 1) &
+                        ~(unsigned long) (PAGE_SIZE - 1));
+
+    /* whole buffer: the 2D block is skipped */
+    ranges[0].ptr = bufPtr;
+    ranges[0].size = size2d + size1d;
+    MemMgr_GetStats(&stats, true);
+    ret |= A_I(MemMgr_CacheFlush(ranges, 1),==,0);
+    MemMgr_GetStats(&stats, true);
+    ret |= NOT_L(stats.cache_flush_bytes,==,size1d);
+    ret |= NOT_L(stats.cache_skipped_bytes,==,size2d);
+
+    /* a single byte is a whole line */
+    ranges[0].ptr = line;
+    ranges[0].size = 1;
+    ret |= A_I(MemMgr_CacheClean(ranges, 1),==,0);
+    MemMgr_GetStats(&stats, true);
+    bytes_t ls = stats.cache_clean_bytes;
+    ret |= NOT_L(ls,>=,16) || NOT_L(ls & (ls - 1),==,0);
+
+    /* batched, unaligned ranges in the 1D block and in other memory
+       are extended to whole lines */
+    ranges[0].ptr = blks[1].ptr + 1;
+    ranges[0].size = ls;
+    ranges[1].ptr = line + ls + 1;
+    ranges[1].size = 2 * PAGE_SIZE;
+    ret |= A_I(MemMgr_CacheClean(ranges, 2),==,0);
+    ret |= A_I(MemMgr_CacheInvalidate(ranges + 1, 1),==,0);
+    MemMgr_GetStats(&stats, true);
+    ret |= NOT_L(stats.cache_clean_bytes,==,2 * ls + 2 * PAGE_SIZE + ls);
+    ret |= NOT_L(stats.cache_invalidate_bytes,==,2 * PAGE_SIZE + ls);
+    ret |= NOT_L(stats.cache_skipped_bytes,==,0);
+
+    /* 2D block only */
+    ranges[0].ptr = bufPtr;
+    ranges[0].size = size2d;
+    ret |= A_I(MemMgr_CacheClean(ranges, 1),==,0);
+    MemMgr_GetStats(&stats, true);
+    ret |= NOT_L(stats.cache_clean_bytes,==,0);
+    ret |= NOT_L(stats.cache_skipped_bytes,==,size2d);
+
+    /* empty and invalid lists */
+    ret |= NOT_I(MemMgr_CacheFlush(NULL, 0),==,0);
+    ret |= NOT_I(MemMgr_CacheFlush(NULL, 1),!=,0);
+    ret |= NOT_I(MemMgr_CacheFlush(ranges, -1),!=,0);
+    ranges[0].ptr = NULL;
+    ret |= NOT_I(MemMgr_CacheFlush(ranges, 1),!=,0);
+
+    FREE(mem);
+    ERR_ADD(ret, MemMgr_Free(bufPtr));
+#else
+    /* cache maintenance is only provided when emulating the tiler */
+    int ret = TESTERR_NOTIMPLEMENTED;
+#endif
+    return ret;
+}
+
+/**
+ * Tests the MemMgr_AllocEx and MemMgr_GetCacheMode methods by
+ * checking that modes other than the default of a block are
+ * rejected, that the default modes can be requested explicitly,
+ * and, when emulating the tiler, that cache maintenance follows
+ * the mode of each block.
+ *
+ * @param width   Width of 2D block
+ * @param height  Height of 2D block
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int cache_mode_test(pixels_t width, pixels_t height)
+{
+    printf("Cache modes of %ux%u 2D + %u page 1D buffer\n", width,
+           height, width);
+
+    MemAllocBlock blks[2];
+    memset(blks, 0, sizeof(blks));
+    blks[0].pixelFormat = PIXEL_FMT_8BIT;
+    blks[0].dim.area.width = width;
+    blks[0].dim.area.height = height;
+    blks[1].pixelFormat = PIXEL_FMT_PAGE;
+    blks[1].dim.len = width * PAGE_SIZE;
+
+    /* invalid modes */
+    int modes[2] = { MEMMGR_CACHE_DEFAULT, MEMMGR_CACHE_UNCACHED + 1 };
+    if (NOT_P(MemMgr_AllocEx(blks, 2, modes),==,NULL)) return 1;
+    modes[1] = -1;
+    if (NOT_P(MemMgr_AllocEx(blks, 2, modes),==,NULL)) return 1;
+
+    /* modes that the blocks cannot be mapped in */
+    modes[0] = MEMMGR_CACHE_CACHED;
+    modes[1] = MEMMGR_CACHE_DEFAULT;
+    if (NOT_P(MemMgr_AllocEx(blks, 2, modes),==,NULL)) return 1;
+    modes[0] = MEMMGR_CACHE_DEFAULT;
+    modes[1] = MEMMGR_CACHE_WC;
+    if (NOT_P(MemMgr_AllocEx(blks, 2, modes),==,NULL)) return 1;
+
+    /* the default modes can be requested explicitly */
+    modes[0] = MEMMGR_CACHE_UNCACHED;
+    modes[1] = MEMMGR_CACHE_CACHED;
+    void *bufPtr = MemMgr_AllocEx(blks, 2, modes);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+
+    int mode2d = MemMgr_GetCacheMode(blks[0].ptr);
+    int mode1d = MemMgr_GetCacheMode(blks[1].ptr + blks[1].dim.len - 1);
+    int ret = NOT_I(mode2d,==,MEMMGR_CACHE_UNCACHED) ||
+              NOT_I(mode1d,==,MEMMGR_CACHE_CACHED);
+    ret |= NOT_I(MemMgr_GetCacheMode(&mode2d),==,MEMMGR_CACHE_CACHED);
+
+#ifdef STUB_TILER
+    /* cache maintenance only covers cacheable blocks */
+    bytes_t size2d = (uint8_t *) blks[1].ptr - (uint8_t *) bufPtr;
+    bytes_t size1d = blks[1].dim.len;
+    MemMgr_Range range;
+    MemMgr_Stats stats;
+    range.ptr = bufPtr;
+    range.size = size2d + size1d;
+    MemMgr_GetStats(&stats, true);
+    ret |= A_I(MemMgr_CacheFlush(&range, 1),==,0);
+    MemMgr_GetStats(&stats, true);
+    ret |= NOT_L(stats.cache_flush_bytes,==,size1d);
+    ret |= NOT_L(stats.cache_skipped_bytes,==,size2d);
+#endif
+
+    /* the blocks hold data */
+    memset(blks[0].ptr, 0x5a, width);
+    memset(blks[1].ptr, 0xa5, PAGE_SIZE);
+    ret |= NOT_I(((uint8_t *) blks[0].ptr)[width - 1],==,0x5a);
+    ret |= NOT_I(((uint8_t *) blks[1].ptr)[PAGE_SIZE - 1],==,0xa5);
+
+    ERR_ADD(ret, MemMgr_Free(bufPtr));
+    return ret;
+}
+
+/**
+ * Tests the MemMgr_SetCheckLevel method by allocating and
+ * mapping buffers at each check level, and that each level
+ * detects the inconsistencies that it checks for.  Restores the
+ * previous check level.
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int check_level_test()
+{
+    printf("Consistency check levels\n");
+
+    int ret = 0, level, interval, saved_interval;
+    int saved = MemMgr_GetCheckLevel(&saved_interval);
+
+    ret |= NOT_I(MemMgr_SetCheckLevel(MEMMGR_CHECK_OFF - 1, 1),!=,0);
+    ret |= NOT_I(MemMgr_SetCheckLevel(MEMMGR_CHECK_FULL + 1, 1),!=,0);
+    ret |= NOT_I(MemMgr_SetCheckLevel(MEMMGR_CHECK_FULL, 0),!=,0);
+    ret |= NOT_I(MemMgr_GetCheckLevel(NULL),==,saved);
+
+    for (level = MEMMGR_CHECK_OFF; !ret && level <= MEMMGR_CHECK_FULL; level++)
+    {
+        ret |= NOT_I(MemMgr_SetCheckLevel(level, 2),==,0);
+        ret |= NOT_I(MemMgr_GetCheckLevel(&interval),==,level);
+        ret |= NOT_I(interval,==,2);
+        ret |= alloc_1D_test(4096, 0);
+        ret |= alloc_2D_test(64, 64, PIXEL_FMT_8BIT);
+        ret |= map_1D_test(4096, 0);
+    }
+
+    /* inconsistencies are detected */
+    ret |= NOT_I(MemMgr_SetCheckLevel(MEMMGR_CHECK_COUNT, 3),==,0);
+    ret |= NOT_I(__test__CacheCheck(),==,0);
+    ret |= NOT_I(MemMgr_GetCheckLevel(&level),==,MEMMGR_CHECK_COUNT);
+    ret |= NOT_I(level,==,3);
+
+    ERR_ADD(ret, MemMgr_SetCheckLevel(saved, saved_interval));
+    return ret;
+}
+
 /**
  * This method tests the allocation and freeing of a number of
  * 1D tiled buffers (up to MAX_ALLOCS)
@@ -1562,7 +2566,7 @@ int neg_map_tests()
         blk->dim.area.height = 16;
     }
 
-    P("/* 2 buffers */");
+    P("/* 2 2D buffers */");
     ret |= NEGM(MemMgr_Map(block, 2));
 
     P("/* 1 2D buffer */");
@@ -1574,16 +2578,7 @@ int neg_map_tests()
     block[0].ptr = NULL;
     ret |= NEGM(MemMgr_Map(block, 1));
 
-    P("/* 1 1D buffer with not aligned start address */");
-    void *buffer = malloc(3 * PAGE_SIZE);
-    void *dataPtr = (void *)(((uint32_t)buffer + PAGE_SIZE - 1) &~ (PAGE_SIZE - 1));
-    block[0].ptr = dataPtr + 3;
-    ret |= NEGM(MemMgr_Map(block, 1));
-
-    P("/* 1 1D buffer with not aligned length */");
-    block[0].ptr = dataPtr;
-    block[0].dim.len -= 5;
-    ret |= NEGM(MemMgr_Map(block, 1));
+    /* not page aligned 1D buffers can be mapped: see map_unaligned_1D_test */
 
 #if 0 /* TODO: it's possible that our va falls within the TILER addr range */
     P("/* Mapping a tiled 1D buffer */");
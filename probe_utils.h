@@ -0,0 +1,114 @@
+/*
+ *  probe_utils.h
+ *
+ *  Static probe (USDT) definitions.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PROBE_UTILS_H_
+#define _PROBE_UTILS_H_
+
+/* ---------- USDT Static Probe Macros ---------- */
+
+/**
+ * Static probes are compiled in only if the library is configured with
+ * --enable-probes (HAVE_PROBES).  Otherwise they expand to nothing, and the
+ * probe arguments are not evaluated.  When compiled in, a probe is a single
+ * nop instruction until a tracer (perf, bpftrace, systemtap) attaches to it.
+ *
+ * Define PROBE_PROVIDER before including this file.  Use as:
+ *
+ *    #define PROBE_PROVIDER memmgr
+ *    #include "probe_utils.h"
+ *
+ *    PROBE2(free, bufPtr, ret);
+ *
+ *    bpftrace -e 'usdt:/system/lib/libtimemmgr.so:memmgr:free
+ *                 { printf("%p %d\n", arg0, arg1); }'
+ *
+ * Each probe has a semaphore, which the tracer increments while it is
+ * attached to the probe.  A source file that uses probes must define the
+ * semaphore of each of its probes at file scope:
+ *
+ *    PROBE_SEMAPHORE(free);
+ *
+ * Driver call latencies are measured using PROBE_NOW(), which returns a
+ * monotonic time stamp in nanoseconds.  Only measure them if the probe is
+ * enabled, so that untraced calls do not pay for reading the clock:
+ *
+ *    if (PROBE_ENABLED(ioctl)) { start = PROBE_NOW(); ... }
+ */
+#ifdef HAVE_PROBES
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#include <time.h>
+
+#define PROBE_SEM__(provider,name) provider##_##name##_semaphore
+#define PROBE_SEM_(provider,name)  PROBE_SEM__(provider,name)
+
+#define PROBE_SEMAPHORE(name) \
+    unsigned short PROBE_SEM_(PROBE_PROVIDER, name) \
+    __attribute__((unused, section(".probes"), visibility("hidden")))
+#define PROBE_ENABLED(name) \
+    __builtin_expect(PROBE_SEM_(PROBE_PROVIDER, name) != 0, 0)
+
+#define PROBE0(name)              STAP_PROBE(PROBE_PROVIDER, name)
+#define PROBE1(name,a)            STAP_PROBE1(PROBE_PROVIDER, name, a)
+#define PROBE2(name,a,b)          STAP_PROBE2(PROBE_PROVIDER, name, a, b)
+#define PROBE3(name,a,b,c)        STAP_PROBE3(PROBE_PROVIDER, name, a, b, c)
+#define PROBE4(name,a,b,c,d)      STAP_PROBE4(PROBE_PROVIDER, name, a, b, c, d)
+#define PROBE5(name,a,b,c,d,e)    STAP_PROBE5(PROBE_PROVIDER, name, a, b, c, d, e)
+
+static __inline__ uint64_t __probe_now__()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#define PROBE_NOW() __probe_now__()
+
+#else
+
+#define PROBE0(name)
+#define PROBE1(name,a)
+#define PROBE2(name,a,b)
+#define PROBE3(name,a,b,c)
+#define PROBE4(name,a,b,c,d)
+#define PROBE5(name,a,b,c,d,e)
+
+#define PROBE_ENABLED(name) 0
+#define PROBE_NOW() 0
+
+#endif
+
+#endif
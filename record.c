@@ -0,0 +1,162 @@
+/*
+ *  record.c
+ *
+ *  Memory Allocator API call recorder.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* for syscall() */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "utils.h"
+#include "debug_utils.h"
+#include "tilermem_utils.h"
+#include <tiler.h>
+#include "record.h"
+
+/* size of the stdio buffer of the trace file */
+#define RECORD_BUF_SIZE (64 * 1024)
+
+int __internal__Record_On = 0;
+
+static FILE *rec_fp = NULL;
+static pthread_mutex_t rec_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t __internal__Record_Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void __internal__Record(int op, void *ptr, uint64_t ret,
+                        MemAllocBlock *blocks, int num_blocks, uint64_t start)
+{
+    struct record_entry e;
+    struct record_block b;
+    int ix;
+
+    ZERO(e);
+    e.ts = start;
+    e.dur_ns = (uint32_t) (__internal__Record_Now() - start);
+    e.ptr = (uintptr_t) ptr;
+    e.ret = ret;
+    e.tid = (uint32_t) syscall(SYS_gettid);
+    e.op = (uint16_t) op;
+    e.num_blocks = blocks && num_blocks > 0 && num_blocks <= TILER_MAX_NUM_BLOCKS ?
+                   (uint16_t) num_blocks : 0;
+
+    pthread_mutex_lock(&rec_mutex);
+    if (rec_fp)
+    {
+        fwrite(&e, sizeof(e), 1, rec_fp);
+        for (ix = 0; ix < e.num_blocks; ix++)
+        {
+            ZERO(b);
+            b.fmt = blocks[ix].pixelFormat;
+            if (blocks[ix].pixelFormat == PIXEL_FMT_PAGE)
+            {
+                b.width = blocks[ix].dim.len;
+            }
+            else
+            {
+                b.width = blocks[ix].dim.area.width;
+                b.height = blocks[ix].dim.area.height;
+            }
+            b.stride = blocks[ix].stride;
+            fwrite(&b, sizeof(b), 1, rec_fp);
+        }
+    }
+    pthread_mutex_unlock(&rec_mutex);
+}
+
+int MemMgr_StartRecording(const char *path)
+{
+    struct record_header hdr;
+    int ret = MEMMGR_ERR_GENERIC;
+
+    if (NOT_P(path,!=,NULL)) return ret;
+
+    pthread_mutex_lock(&rec_mutex);
+    if (!NOT_P(rec_fp,==,NULL))
+    {
+        rec_fp = fopen(path, "wb");
+        if (!NOT_P(rec_fp,!=,NULL))
+        {
+            setvbuf(rec_fp, NULL, _IOFBF, RECORD_BUF_SIZE);
+            ZERO(hdr);
+            memcpy(hdr.magic, RECORD_MAGIC, sizeof(hdr.magic));
+            hdr.endian = RECORD_ENDIAN;
+            hdr.page_size = PAGE_SIZE;
+            fwrite(&hdr, sizeof(hdr), 1, rec_fp);
+            __internal__Record_On = 1;
+            ret = MEMMGR_ERR_NONE;
+        }
+    }
+    pthread_mutex_unlock(&rec_mutex);
+    return ret;
+}
+
+int MemMgr_StopRecording()
+{
+    int ret = MEMMGR_ERR_GENERIC;
+
+    pthread_mutex_lock(&rec_mutex);
+    __internal__Record_On = 0;
+    if (rec_fp)
+    {
+        ret = fclose(rec_fp) ? MEMMGR_ERR_GENERIC : MEMMGR_ERR_NONE;
+        rec_fp = NULL;
+    }
+    pthread_mutex_unlock(&rec_mutex);
+    return ret;
+}
+
+static void stop_at_exit()
+{
+    MemMgr_StopRecording();
+}
+
+/* starts recording when the library is loaded if MEMMGR_RECORD is set */
+static void __attribute__((constructor)) record_init()
+{
+    const char *path = getenv("MEMMGR_RECORD");
+    if (path && *path && !MemMgr_StartRecording(path)) atexit(stop_at_exit);
+}
@@ -0,0 +1,116 @@
+/*
+ *  record.h
+ *
+ *  Memory Allocator API call recording definitions.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+#include <stdint.h>
+#include "utils.h"
+#include "memmgr.h"
+
+/**
+ * The library can record every public MemMgr API call into a binary trace
+ * file.  Recording is started by MemMgr_StartRecording(), or at load time if
+ * the MEMMGR_RECORD environment variable names the trace file.  While it is
+ * not recording, a call costs a single branch.
+ *
+ * A trace file starts with a record_header, followed by records.  Each record
+ * is a record_entry followed by num_blocks record_block-s.  Records are
+ * written when the calls return, so they are ordered by completion; replay
+ * tools should order them by their time stamps.  memmgr_replay replays trace
+ * files, and trace_analyze.py analyzes them.
+ */
+
+#define RECORD_MAGIC   "TMREC001"
+#define RECORD_ENDIAN  0x01020304
+
+/* recorded operations */
+enum record_op {
+    REC_ALLOC = 1,        /* MemMgr_Alloc */
+    REC_FREE,             /* MemMgr_Free */
+    REC_MAP,              /* MemMgr_Map */
+    REC_UNMAP,            /* MemMgr_UnMap */
+    REC_GET_STRIDE,       /* MemMgr_GetStride */
+    REC_IS_1D,            /* MemMgr_Is1DBlock */
+    REC_IS_2D,            /* MemMgr_Is2DBlock */
+    REC_IS_MAPPED,        /* MemMgr_IsMapped */
+    REC_VIRT_TO_PHYS      /* TilerMem_VirtToPhys */
+};
+
+/* trace file header */
+struct record_header {
+    char     magic[8];    /* RECORD_MAGIC */
+    uint32_t endian;      /* RECORD_ENDIAN in the writer's byte order */
+    uint32_t page_size;   /* page size of the recording system */
+};
+
+/* recorded API call */
+struct record_entry {
+    uint64_t ts;          /* monotonic time of the call in ns */
+    uint64_t ptr;         /* buffer pointer: result of alloc/map, argument
+                             of all other calls */
+    uint64_t ret;         /* return value */
+    uint32_t dur_ns;      /* duration of the call */
+    uint32_t tid;         /* calling thread */
+    uint16_t op;          /* enum record_op */
+    uint16_t num_blocks;  /* number of record_block-s that follow */
+    uint32_t reserved;
+};
+
+/* recorded block layout of an alloc or map call */
+struct record_block {
+    uint32_t fmt;         /* pixel_fmt_t */
+    uint32_t width;       /* width of 2D blocks, length of 1D blocks */
+    uint32_t height;      /* height of 2D blocks, 0 for 1D blocks */
+    uint32_t stride;      /* stride after the call */
+};
+
+/* internal variables and function prototypes */
+extern int __internal__Record_On;
+extern uint64_t __internal__Record_Now();
+extern void __internal__Record(int op, void *ptr, uint64_t ret,
+                               MemAllocBlock *blocks, int num_blocks,
+                               uint64_t start);
+
+/* returns the start time of an API call if recording, 0 otherwise */
+#define RECORD_START() (__internal__Record_On ? __internal__Record_Now() : 0)
+
+/* records an API call if recording.  start must come from RECORD_START() */
+#define RECORD(op, ptr, ret, blocks, num_blocks, start) S_ { \
+    if (__internal__Record_On && (start)) \
+        __internal__Record(op, ptr, (uint64_t) (ret), blocks, num_blocks, start); \
+} _S
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ *  rowpool.c
+ *
+ *  Thread pool that processes the rows of large 2D regions in parallel.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+
+#include "rowpool.h"
+
+/*
+ * The caller splits the rows into parts, and processes parts along
+ * with the workers until none are left.
+ */
+static struct {
+    pthread_mutex_t run_mtx;    /* serializes the callers */
+    pthread_mutex_t mtx;        /* protects the fields below */
+    pthread_cond_t work, done;
+    pthread_t workers[ROWPOOL_MAX_THREADS - 1];
+    int num_workers;
+    int quit;                   /* set to stop the workers */
+
+    /* current job */
+    RowPool_Fn fn;
+    void *arg;
+    bytes_t r0[ROWPOOL_MAX_THREADS + 1];
+    int num_parts, next, pending;
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+           PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* takes and processes parts until none are left.  Called with pool.mtx held. */
+static void run_parts()
+{
+    while (pool.next < pool.num_parts)
+    {
+        int ix = pool.next++;
+        pthread_mutex_unlock(&pool.mtx);
+        pool.fn(pool.arg, ix, pool.r0[ix], pool.r0[ix + 1]);
+        pthread_mutex_lock(&pool.mtx);
+        if (!--pool.pending) pthread_cond_signal(&pool.done);
+    }
+}
+
+static void *worker(void *arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&pool.mtx);
+    while (!pool.quit)
+    {
+        if (pool.next < pool.num_parts) run_parts();
+        else pthread_cond_wait(&pool.work, &pool.mtx);
+    }
+    pthread_mutex_unlock(&pool.mtx);
+    return NULL;
+}
+
+/* keeps the pool locks consistent across a fork */
+static void fork_prepare()
+{
+    pthread_mutex_lock(&pool.run_mtx);
+    pthread_mutex_lock(&pool.mtx);
+}
+
+static void fork_parent()
+{
+    pthread_mutex_unlock(&pool.mtx);
+    pthread_mutex_unlock(&pool.run_mtx);
+}
+
+static void fork_child()
+{
+    /* only the forking thread exists in the child */
+    pool.num_workers = 0;
+    pthread_mutex_init(&pool.run_mtx, NULL);
+    pthread_mutex_init(&pool.mtx, NULL);
+    pthread_cond_init(&pool.work, NULL);
+    pthread_cond_init(&pool.done, NULL);
+}
+
+static void init_pool()
+{
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
+
+int RowPool_Run(RowPool_Fn fn, void *arg, bytes_t height, int num_parts)
+{
+    int ix;
+
+    if (num_parts > ROWPOOL_MAX_THREADS) num_parts = ROWPOOL_MAX_THREADS;
+    if (num_parts > height) num_parts = height;
+    pthread_once(&pool_once, init_pool);
+    if (num_parts < 2 || pthread_mutex_trylock(&pool.run_mtx))
+    {
+        /* nothing to split, or the pool is busy */
+        fn(arg, 0, 0, height);
+        return 1;
+    }
+
+    /* start missing workers */
+    while (pool.num_workers < num_parts - 1 &&
+           !pthread_create(pool.workers + pool.num_workers, NULL, worker, NULL))
+    {
+        pool.num_workers++;
+    }
+    if (num_parts > pool.num_workers + 1) num_parts = pool.num_workers + 1;
+
+    pthread_mutex_lock(&pool.mtx);
+    for (ix = 0; ix <= num_parts; ix++)
+    {
+        pool.r0[ix] = height * ix / num_parts;
+    }
+    pool.fn = fn;
+    pool.arg = arg;
+    pool.num_parts = pool.pending = num_parts;
+    pool.next = 0;
+    if (num_parts > 1) pthread_cond_broadcast(&pool.work);
+    run_parts();
+    while (pool.pending)
+        pthread_cond_wait(&pool.done, &pool.mtx);
+    pool.num_parts = pool.next = 0;
+    pthread_mutex_unlock(&pool.mtx);
+    pthread_mutex_unlock(&pool.run_mtx);
+    return num_parts;
+}
+
+/* stops the workers.  Called with pool.run_mtx held. */
+static void stop_workers()
+{
+    int ix;
+
+    pthread_mutex_lock(&pool.mtx);
+    pool.quit = 1;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.mtx);
+
+    for (ix = 0; ix < pool.num_workers; ix++)
+    {
+        pthread_join(pool.workers[ix], NULL);
+    }
+    pool.num_workers = 0;
+    pool.quit = 0;
+}
+
+void RowPool_Stop()
+{
+    pthread_mutex_lock(&pool.run_mtx);
+    stop_workers();
+    pthread_mutex_unlock(&pool.run_mtx);
+}
+
+/* stops the workers before the library is unloaded, unless a caller
+   is still using them (e.g. exit() from another thread) */
+static void __attribute__((destructor)) stop_pool()
+{
+    if (pthread_mutex_trylock(&pool.run_mtx)) return;
+    stop_workers();
+    pthread_mutex_unlock(&pool.run_mtx);
+}
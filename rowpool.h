@@ -0,0 +1,84 @@
+/*
+ *  rowpool.h
+ *
+ *  Thread pool that processes the rows of large 2D regions in parallel.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ROWPOOL_H_
+#define _ROWPOOL_H_
+
+#include "mem_types.h"
+
+#define ROWPOOL_MAX_THREADS 8
+
+/**
+ * Processes the rows of a part of a region.
+ *
+ * @param arg    Argument given to RowPool_Run
+ * @param part   Index of the part
+ * @param r0     First row of the part
+ * @param r1     Row after the last row of the part
+ */
+typedef void (*RowPool_Fn)(void *arg, int part, bytes_t r0, bytes_t r1);
+
+/**
+ * Splits rows [0, height) into at most num_parts consecutive
+ * parts of about equal size, and processes them with fn on the
+ * calling thread and on the worker threads of the pool.  Parts
+ * are numbered in row order.  Returns after all parts are
+ * processed.
+ * <p>
+ * Workers are only started when a caller asks for more than one
+ * part, and the pool never has more than ROWPOOL_MAX_THREADS - 1
+ * workers.  If the pool is busy with another caller, or workers
+ * cannot be started, the rows are processed as one part on the
+ * calling thread.  Workers do not survive a fork; the child
+ * starts new ones when needed.
+ *
+ * @param fn         Function processing a part
+ * @param arg        Argument passed to fn
+ * @param height     Number of rows
+ * @param num_parts  Requested number of parts
+ *
+ * @return number of parts the rows were split into
+ */
+int RowPool_Run(RowPool_Fn fn, void *arg, bytes_t height, int num_parts);
+
+/**
+ * Stops the worker threads of the pool, and waits for them to
+ * exit.  New workers are started by the next RowPool_Run call
+ * that needs them.  This is also done when the library is
+ * unloaded.
+ */
+void RowPool_Stop();
+
+#endif
@@ -33,10 +33,18 @@
  *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* for clock_gettime, fork and friends */
+#define _POSIX_C_SOURCE 200112L
+
 /* retrieve type definitions */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include "testlib.h"
 
 #include <utils.h>
@@ -49,8 +57,40 @@
 #define is_uint(str) \
     E_ { unsigned i; char c; sscanf(str, "%u%c", &i, &c) == 1; } _E
 
+/* maximum number of test processes */
+#define TESTLIB_MAX_JOBS    64
+
 extern int __internal__TestLib_DoList(int id);
 
+/* description and result code of the last test run */
+const char *__internal__TestLib_Name = NULL;
+static int last_code = 0;
+
+/* result of a test case */
+struct test_result {
+    int      id;
+    int      res;          /* summary result */
+    int      code;         /* error code returned by the test */
+    uint64_t wall_ns;      /* wall clock time */
+    uint64_t cpu_ns;       /* CPU time of the process */
+    char     name[128];    /* test description */
+};
+
+/* in-progress forked test */
+struct test_job {
+    pid_t  pid;            /* child process, 0 if done */
+    int    fd;             /* result pipe */
+    FILE  *out;            /* captured output */
+};
+
+/** Returns a clock in nanoseconds */
+static uint64_t clock_ns(clockid_t id)
+{
+    struct timespec ts;
+    if (clock_gettime(id, &ts)) return 0;
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /**
  * Prints test result and returns summary result
  *
@@ -64,6 +104,7 @@ extern int __internal__TestLib_DoList(int id);
  */
 int __internal__TestLib_Report(int res)
 {
+    last_code = res;
     switch (res)
     {
         case TESTLIB_UNAVAILABLE:
@@ -85,10 +126,300 @@ void __internal__TestLib_NullFn(void *ptr)
 {
 }
 
+/**
+ * Runs a test case and prints its wall clock and CPU time.
+ *
+ * @param id     Test case id
+ * @param r      Pointer to where to store the result
+ */
+static void run_test(int id, struct test_result *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->id = id;
+    __internal__TestLib_Name = NULL;
+    last_code = 0;
+
+    uint64_t wall = clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    r->res = __internal__TestLib_DoList(id);
+    r->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+    r->wall_ns = clock_ns(CLOCK_MONOTONIC) - wall;
+    r->code = last_code;
+
+    if (r->res != TESTLIB_INVALID)
+    {
+        if (__internal__TestLib_Name)
+        {
+            strncpy(r->name, __internal__TestLib_Name, sizeof(r->name) - 1);
+        }
+        printf("TEST_TIME - wall %.3f ms, cpu %.3f ms\n", r->wall_ns / 1e6,
+               r->cpu_ns / 1e6);
+        fflush(stdout);
+    }
+}
+
+/**
+ * Starts a test case in a child process.  The output of the
+ * child is captured in a temporary file, and its result is
+ * passed back through a pipe.
+ *
+ * @param id     Test case id
+ * @param job    Pointer to the job
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int start_job(int id, struct test_job *job)
+{
+    struct test_result r;
+    int fds[2];
+
+    job->out = tmpfile();
+    if (NOT_P(job->out,!=,NULL)) return 1;
+    if (NOT_I(pipe(fds),==,0))
+    {
+        fclose(job->out);
+        return 1;
+    }
+
+    /* do not duplicate buffered output in the child */
+    fflush(stdout);
+    fflush(stderr);
+    job->pid = fork();
+    if (job->pid == 0)
+    {
+        close(fds[0]);
+        dup2(fileno(job->out), 1);
+        dup2(fileno(job->out), 2);
+        run_test(id, &r);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(write(fds[1], &r, sizeof(r)) != sizeof(r));
+    }
+    close(fds[1]);
+    if (NOT_I(job->pid,>,0))
+    {
+        close(fds[0]);
+        fclose(job->out);
+        return 1;
+    }
+    job->fd = fds[0];
+    return 0;
+}
+
+/**
+ * Collects the result of a finished test process.  A test that
+ * did not report its result (e.g. it crashed) has failed.
+ *
+ * @param id     Test case id
+ * @param job    Pointer to the job
+ * @param status Exit status of the child
+ * @param r      Pointer to where to store the result
+ */
+static void finish_job(int id, struct test_job *job, int status,
+                       struct test_result *r)
+{
+    if (read(job->fd, r, sizeof(*r)) != sizeof(*r) || r->id != id)
+    {
+        memset(r, 0, sizeof(*r));
+        r->id = id;
+        r->res = TESTLIB_FAIL;
+        r->code = WIFSIGNALED(status) ? -WTERMSIG(status) : TESTLIB_FAIL;
+        /* recover the test description from the output */
+        fflush(job->out);
+        rewind(job->out);
+        if (fscanf(job->out, "TEST #%*d - %127[^\n]", r->name) != 1) r->name[0] = '\0';
+        fseek(job->out, 0, SEEK_END);
+        fprintf(job->out, "\n==> TEST FAIL(%d)\n", r->code);
+    }
+    close(job->fd);
+    job->pid = 0;
+}
+
+/** Copies the captured output of a test to stdout */
+static void print_job(struct test_job *job)
+{
+    char buf[512];
+    size_t len;
+
+    fflush(job->out);
+    rewind(job->out);
+    while ((len = fread(buf, 1, sizeof(buf), job->out)) > 0)
+    {
+        fwrite(buf, 1, len, stdout);
+    }
+    fclose(job->out);
+    job->out = NULL;
+}
+
+/** Prints the running totals */
+static void print_totals(struct test_result *r, int num, int so_far)
+{
+    int ix, failed = 0, succeeded = 0, unavailable = 0;
+    for (ix = 0; ix < num; ix++)
+    {
+        if (r[ix].res == TESTLIB_FAIL) failed++;
+        else if (r[ix].res == TESTLIB_OK) succeeded++;
+        else if (r[ix].res == TESTLIB_UNAVAILABLE) unavailable++;
+    }
+    printf("%sFAILED: %d, SUCCEEDED: %d, UNAVAILABLE: %d\n",
+           so_far ? "so far " : "", failed, succeeded, unavailable);
+    fflush(stdout);
+}
+
+/**
+ * Runs a range of test cases in up to jobs child processes.
+ * Output and results are printed in test id order.
+ *
+ * @param start  First test case id
+ * @param num    Number of test cases
+ * @param jobs   Maximum number of concurrent test processes
+ * @param r      Result array
+ *
+ * @return number of test cases run
+ */
+static int run_parallel(int start, int num, int jobs, struct test_result *r)
+{
+    struct test_job *job = NEWN(struct test_job, num);
+    int next = 0, printed = 0, running = 0, ix, status;
+    pid_t pid;
+
+    if (NOT_P(job,!=,NULL)) return 0;
+
+    while (printed < num)
+    {
+        /* keep jobs processes busy */
+        while (running < jobs && next < num)
+        {
+            if (start_job(start + next, job + next))
+            {
+                r[next].id = start + next;
+                r[next].res = TESTLIB_FAIL;
+                job[next].out = NULL;
+            }
+            else running++;
+            next++;
+        }
+
+        if (running)
+        {
+            pid = waitpid(-1, &status, 0);
+            for (ix = 0; ix < next; ix++)
+            {
+                if (pid > 0 && job[ix].pid == pid)
+                {
+                    finish_job(start + ix, job + ix, status, r + ix);
+                    running--;
+                }
+            }
+            if (pid < 0) break;
+        }
+
+        /* print completed tests in order */
+        while (printed < next && (!job[printed].pid || !job[printed].out))
+        {
+            if (job[printed].out) print_job(job + printed);
+            printed++;
+            print_totals(r, printed, 1);
+        }
+    }
+    FREE(job);
+    return printed;
+}
+
+/** Prints a string as a JSON string */
+static void json_str(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\') fprintf(fp, "\\%c", *str);
+        else if ((unsigned char) *str < ' ') fprintf(fp, "\\u%04x", *str);
+        else fputc(*str, fp);
+    }
+    fputc('"', fp);
+}
+
+/**
+ * Writes a TAP or JSON report of the test results.
+ *
+ * @param path     Path to the report, or "-" for stdout
+ * @param fmt      Report format: "tap" or "json"
+ * @param prog     Program name
+ * @param jobs     Number of test processes used
+ * @param r        Result array
+ * @param num      Number of results
+ * @param wall_ns  Wall clock time of the test run
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int write_report(const char *path, const char *fmt, const char *prog,
+                        int jobs, struct test_result *r, int num,
+                        uint64_t wall_ns)
+{
+    static const char *res_names[] = { "ok", "fail" };
+    FILE *fp = strcmp(path, "-") ? fopen(path, "w") : stdout;
+    int ix;
+
+    if (NOT_P(fp,!=,NULL)) return 1;
+
+    if (!strcmp(fmt, "tap"))
+    {
+        fprintf(fp, "TAP version 13\n1..%d\n", num);
+        for (ix = 0; ix < num; ix++)
+        {
+            fprintf(fp, "%sok %d - %s", r[ix].res == TESTLIB_FAIL ? "not " : "",
+                    r[ix].id, r[ix].name);
+            if (r[ix].res == TESTLIB_UNAVAILABLE) fprintf(fp, " # SKIP not available");
+            fprintf(fp, "\n  ---\n  code: %d\n  wall_ms: %.3f\n  cpu_ms: %.3f\n  ...\n",
+                    r[ix].code, r[ix].wall_ns / 1e6, r[ix].cpu_ns / 1e6);
+        }
+    }
+    else
+    {
+        fprintf(fp, "{\n  \"program\": ");
+        json_str(fp, prog);
+        fprintf(fp, ",\n  \"jobs\": %d,\n  \"wall_ns\": %llu,\n  \"tests\": [\n",
+                jobs, (unsigned long long) wall_ns);
+        for (ix = 0; ix < num; ix++)
+        {
+            fprintf(fp, "    { \"id\": %d, \"name\": ", r[ix].id);
+            json_str(fp, r[ix].name);
+            fprintf(fp, ", \"result\": \"%s\", \"code\": %d, \"wall_ns\": %llu, "
+                    "\"cpu_ns\": %llu }%s\n",
+                    r[ix].res == TESTLIB_UNAVAILABLE ? "unavailable" :
+                    res_names[r[ix].res == TESTLIB_FAIL], r[ix].code,
+                    (unsigned long long) r[ix].wall_ns,
+                    (unsigned long long) r[ix].cpu_ns, ix + 1 < num ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+    }
+
+    if (fp != stdout) fclose(fp);
+    else fflush(fp);
+    return 0;
+}
+
 int TestLib_Run(int argc, char **argv, void(*init_fn)(void *),
                 void(*exit_fn)(void *), void *ptr)
 {
-    int start, end, res, failed = 0, succeeded = 0, unavailable = 0;
+    const char *prog = argv[0], *fmt = NULL, *path = "-";
+    int start, end, num, ix, jobs = 0, failed = 0, arg = 1;
+    struct test_result *r;
+
+    /* options */
+    while (arg + 1 < argc && argv[arg][0] == '-' && argv[arg][1] != '\0')
+    {
+        if (!strcmp(argv[arg], "-j") && is_uint(argv[arg + 1])) jobs = atoi(argv[arg + 1]);
+        else if (!strcmp(argv[arg], "-f") && (!strcmp(argv[arg + 1], "tap") ||
+                                              !strcmp(argv[arg + 1], "json")))
+            fmt = argv[arg + 1];
+        else if (!strcmp(argv[arg], "-o")) path = argv[arg + 1];
+        else break;
+        arg += 2;
+    }
+    argc -= arg - 1;
+    argv += arg - 1;
+    if (jobs > TESTLIB_MAX_JOBS) jobs = TESTLIB_MAX_JOBS;
 
     /* all tests */
     if (argc == 1)
@@ -125,38 +456,60 @@ int TestLib_Run(int argc, char **argv, void(*init_fn)(void *),
     }
     else
     {
-        fprintf(stderr, "Usage: %s [<range>], where <range> is\n"
+        fprintf(stderr, "Usage: %s [<options>] [<range>], where <range> is\n"
           "   empty:   run all tests\n"
           "   list:    list tests\n"
           "   ix:      run test #ix\n"
           "   a ..:    run tests #a, #a+1, ...\n"
           "   .. b:    run tests #1, #2, .. #b\n"
-          "   a .. b:  run tests #a, #a+1, .. #b\n", argv[0]);
+          "   a .. b:  run tests #a, #a+1, .. #b\n"
+          "and <options> are\n"
+          "   -j N:    run tests in N parallel processes\n"
+          "   -f fmt:  write a tap or json report\n"
+          "   -o file: write the report into file (default: stdout)\n", prog);
         fflush(stderr);
         return -1;
     }
 
+    /* determine the test cases to run */
+    num = __internal__TestLib_DoList(-1);
+    if (end < 0 || end > num) end = num;
+    num = start > 0 && start <= end ? end - start + 1 : 1;
+    r = NEWN(struct test_result, num);
+    if (NOT_P(r,!=,NULL)) return -1;
+
     /* execute tests  */
     init_fn(ptr);
 
-    do
+    uint64_t wall = clock_ns(CLOCK_MONOTONIC);
+    if (jobs > 1 && num > 1)
     {
-        res = __internal__TestLib_DoList(start++);
-        if (res == TESTLIB_FAIL) failed++;
-        else if (res == TESTLIB_OK) succeeded++;
-        else if (res == TESTLIB_UNAVAILABLE) unavailable++;
-        printf("so far FAILED: %d, SUCCEEDED: %d, UNAVAILABLE: %d\n", failed, succeeded,
-           unavailable);
-        fflush(stdout);
-    } while (res != TESTLIB_INVALID && (end < 0 || start <= end));
+        num = run_parallel(start, num, jobs, r);
+    }
+    else
+    {
+        for (ix = 0; ix < num; ix++)
+        {
+            run_test(start + ix, r + ix);
+            print_totals(r, ix + 1, 1);
+        }
+    }
+    wall = clock_ns(CLOCK_MONOTONIC) - wall;
 
-    printf("FAILED: %d, SUCCEEDED: %d, UNAVAILABLE: %d\n", failed, succeeded,
-           unavailable);
+    print_totals(r, num, 0);
+    printf("TOTAL_TIME - wall %.3f s\n", wall / 1e9);
     fflush(stdout);
+    for (ix = 0; ix < num; ix++)
+    {
+        if (r[ix].res == TESTLIB_FAIL) failed++;
+    }
 
     /* also execute internal unit tests - this also verifies that we did not
        keep any references */
     exit_fn(ptr);
 
+    if (fmt && write_report(path, fmt, prog, jobs > 1 ? jobs : 1, r, num, wall)) failed++;
+    FREE(r);
+
     return failed;
 }
@@ -43,6 +43,7 @@
 #define T(test) ++i; \
     if (!id || i == id) printf("TEST #% 3d - %s\n", i, #test); \
     if (i == id) { \
+        __internal__TestLib_Name = #test; \
         printf("TEST_DESC - "); \
         fflush(stdout); \
         return __internal__TestLib_Report(test); \
@@ -57,28 +58,37 @@
  *
  * @author a0194118 (9/7/2009)
  *
- * @param id   Test case id, or 0 if only listing test cases
+ * @param id   Test case id, 0 if only listing test cases, or -1
+ *             if only counting test cases
  *
  * @return Summary result: TEST_RESULT_OK, FAIL, INVALID or
- *         UNAVAILABLE.
+ *         UNAVAILABLE, or the number of test cases if id is -1.
  */
 #define TESTS_ \
     int __internal__TestLib_DoList(int id) { int i = 0;
 
 #define _TESTS \
-    return TESTLIB_INVALID; }
+    return id < 0 ? i : TESTLIB_INVALID; }
 
 #define DEFINE_TESTS(TESTS) TESTS_ TESTS _TESTS
 
 /* internal function prototypes and defines */
 extern int __internal__TestLib_Report(int res);
 extern void __internal__TestLib_NullFn(void *ptr);
+extern const char *__internal__TestLib_Name;
 
 #define nullfn __internal__TestLib_NullFn
 
 /**
  * Parses argument list, prints usage on error, lists test
  * cases, runs tests and reports results.
+ * <p>
+ * The wall clock and CPU time of each test is printed after its
+ * result.  Options before the test range can write a TAP or
+ * JSON report of the results (-f tap|json, -o file), and run
+ * the tests in N forked child processes (-j N).  In that case
+ * the output of each test is printed once it completes, in test
+ * id order, and a crashing test is reported as failed.
  *
  * @author a0194118 (9/12/2009)
  *
@@ -58,6 +58,7 @@
 #include <tilermem.h>
 #include <tilermem_utils.h>
 #include <testlib.h>
+#include <fill_utils.h>
 
 #define FALSE 0
 
@@ -145,6 +146,10 @@ static void dump_slot(struct ptr_info* buf, char* prefix)
  * such.  This series only repeats after 704189 values, so the
  * probability of a match for a range of at least 2 values is
  * less than 2*10^-11.
+ * <p>
+ * If MEMMGR_FILL=hash, the hash pattern of fill_utils.h is used
+ * instead, which is filled a vector at a time and does not touch
+ * the stride padding.
  *
  * V(i + 1) - V(i) = { 1, 2, 3, ..., 65535, 2, 4, 6, 8 ...,
  * 65534, 3, 6, 9, 12, ..., 4, 8, 12, 16, ... }
@@ -176,6 +181,12 @@ void fill_mem(uint16_t start, MemAllocBlock *block)
     P("(%p,0x%x*0x%x,s=0x%x)=0x%x", block->ptr, width, height, stride, start);
 
     CHK_I(width,<=,stride);
+    if (FillUtils_Mode() == FILL_MODE_HASH)
+    {
+        FillUtils_Fill(start, block->ptr, width, height, stride);
+        OUT;
+        return;
+    }
     uint32_t *ptr32 = (uint32_t *)ptr;
     while (height--)
     {
@@ -261,6 +272,15 @@ int check_mem(uint16_t start, MemAllocBlock *block)
     width *= def_bpp(block->pixelFormat);
 
     CHK_I(width,<=,stride);
+    if (FillUtils_Mode() == FILL_MODE_HASH)
+    {
+        if (FillUtils_Check(start, block->ptr, width, height, stride, &r, &i))
+        {
+            DP("assert: hash pattern mismatch at [%u,%u]", r, i);
+            return R_I(MEMMGR_ERR_GENERIC);
+        }
+        return R_I(MEMMGR_ERR_NONE);
+    }
     uint32_t *ptr32 = (uint32_t *)ptr;
     for (r = 0; r < height; r++)
     {
@@ -0,0 +1,873 @@
+/*
+ *  tiler_sim.c
+ *
+ *  TILER container placement simulator.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* retrieve type definitions */
+#define __DEBUG__
+#undef __DEBUG_ENTRY__
+#define __DEBUG_ASSERT__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include <utils.h>
+#include <debug_utils.h>
+#include <tiler.h>
+#include <benchlib.h>
+#include "record.h"
+
+/**
+ * The simulator models the TILER container as a grid of
+ * TILER_WIDTH x TILER_HEIGHT slots, each backed by one page.
+ * 2D blocks occupy a rectangle of slots (a slot is 64x64 8-bit,
+ * 32x64 16-bit or 32x32 32-bit pixels), while 1D blocks occupy
+ * a run of slots in raster order.  Placement policies only
+ * differ in where they put the blocks.
+ */
+#define CONT_W     TILER_WIDTH
+#define CONT_H     TILER_HEIGHT
+#define CONT_SLOTS (CONT_W * CONT_H)
+#define MAX_BLOCKS TILER_MAX_NUM_BLOCKS
+
+/* star workload defaults (see star_test in memmgr_test) */
+#define STAR_SEED  0x4B72316A
+#define STAR_OPS   100000
+#define STAR_SLOTS 16
+
+/* 2D blocks of at least this many slots are large for the split policy */
+#define SPLIT_SLOTS 256
+
+#define DEF_INTERVAL 100
+#define PLOT_COLS    60
+
+/* simulated operations */
+enum sim_kind {
+    SIM_ALLOC,      /* allocate a buffer */
+    SIM_FREE,       /* free a buffer */
+    SIM_PROBE,      /* allocate and immediately free (failed in recording) */
+    SIM_TOGGLE      /* free the buffer if it is live, allocate otherwise */
+};
+
+/* block request: rectangle in slots for 2D, number of slots for 1D */
+struct sim_block {
+    int      is_1d;
+    uint16_t w, h;
+    uint32_t len;
+};
+
+/* simulated call */
+struct sim_op {
+    uint64_t          ts;          /* time stamp (for ordering traces) */
+    uint64_t          id;          /* buffer id */
+    int               kind;        /* enum sim_kind */
+    int               num_blocks;
+    struct sim_block *blocks;
+};
+
+/* placement of a block in the container */
+struct sim_area {
+    int      is_1d;
+    uint16_t x, y, w, h;           /* 2D slot rectangle */
+    uint32_t start, len;           /* 1D slot range */
+};
+
+/* live buffer */
+struct sim_buf {
+    uint64_t        id;
+    int             num_areas;
+    struct sim_area areas[MAX_BLOCKS];
+};
+
+struct sim;
+
+/* placement policy */
+struct sim_policy {
+    const char *name;
+    const char *desc;
+    int (*place_2d)(struct sim *s, int w, int h, struct sim_area *a);
+    int (*place_1d)(struct sim *s, uint32_t len, struct sim_area *a);
+};
+
+/* simulator state and statistics for one policy */
+struct sim {
+    const struct sim_policy *pol;
+    uint8_t          map[CONT_H][CONT_W];   /* non-0 for used slots */
+    struct sim_buf  *bufs;
+    int              num_bufs, max_bufs;
+    uint32_t         allocs, failed;
+    BenchLib_Samples alloc_ns, free_ns;
+    uint32_t         samples, fits;
+    double           frag_sum, frag_max;
+    uint32_t         min_largest, last_largest;
+    uint32_t         plot[PLOT_COLS];       /* min largest free rectangle */
+};
+
+/* 2D block alignment in slots */
+static int align = 1;
+
+/**
+ * Checks if a rectangle of the container is free.
+ *
+ * @param s      Pointer to the simulator
+ * @param x      Left column
+ * @param y      Top row
+ * @param w      Width in slots
+ * @param h      Height in slots
+ * @param r2l    TRUE if the caller scans right to left
+ *
+ * @return -1 if the rectangle is free.  Otherwise the column of
+ *         a used slot, the rightmost (leftmost for r2l) one of
+ *         the first row that has used slots, so that the caller
+ *         can skip the columns that cannot fit.
+ */
+static int rect_busy(struct sim *s, int x, int y, int w, int h, int r2l)
+{
+    int r, c;
+    for (r = y; r < y + h; r++)
+    {
+        if (r2l)
+        {
+            for (c = x; c < x + w; c++) if (s->map[r][c]) return c;
+        }
+        else
+        {
+            for (c = x + w - 1; c >= x; c--) if (s->map[r][c]) return c;
+        }
+    }
+    return -1;
+}
+
+/* sets up a 2D area */
+static int set_2d(struct sim_area *a, int x, int y, int w, int h)
+{
+    ZERO(*a);
+    a->x = x;
+    a->y = y;
+    a->w = w;
+    a->h = h;
+    return 0;
+}
+
+/**
+ * First fit scanning rows in the given direction, each row left
+ * to right or right to left.
+ *
+ * @param s      Pointer to the simulator
+ * @param w      Width in slots
+ * @param h      Height in slots
+ * @param a      Pointer to where to store the area
+ * @param b2t    TRUE to scan bottom to top
+ * @param r2l    TRUE to scan right to left
+ *
+ * @return 0 on success, non-0 if the block does not fit
+ */
+static int scan_2d(struct sim *s, int w, int h, struct sim_area *a, int b2t, int r2l)
+{
+    int ix, x, y, c;
+    for (ix = 0; ix + h <= CONT_H; ix++)
+    {
+        y = b2t ? CONT_H - h - ix : ix;
+        if (r2l)
+        {
+            for (x = (CONT_W - w) & ~(align - 1); x >= 0; x = (c - w) & ~(align - 1))
+            {
+                if ((c = rect_busy(s, x, y, w, h, 1)) < 0) return set_2d(a, x, y, w, h);
+            }
+        }
+        else
+        {
+            for (x = 0; x + w <= CONT_W; x = ROUND_UP_TO2POW(c + 1, align))
+            {
+                if ((c = rect_busy(s, x, y, w, h, 0)) < 0) return set_2d(a, x, y, w, h);
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Finds a run of free slots in raster order.
+ *
+ * @param s      Pointer to the simulator
+ * @param len    Number of slots
+ * @param a      Pointer to where to store the area
+ * @param back   TRUE to search from the end of the container
+ *
+ * @return 0 on success, non-0 if the block does not fit
+ */
+static int scan_1d(struct sim *s, uint32_t len, struct sim_area *a, int back)
+{
+    uint8_t *m = &s->map[0][0];
+    uint32_t ix, run = 0;
+
+    for (ix = 0; ix < CONT_SLOTS; ix++)
+    {
+        uint32_t slot = back ? CONT_SLOTS - 1 - ix : ix;
+        run = m[slot] ? 0 : run + 1;
+        if (run == len)
+        {
+            ZERO(*a);
+            a->is_1d = 1;
+            a->start = back ? slot : slot + 1 - len;
+            a->len = len;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int first_2d(struct sim *s, int w, int h, struct sim_area *a)
+{
+    return scan_2d(s, w, h, a, 0, 0);
+}
+
+static int first_1d(struct sim *s, uint32_t len, struct sim_area *a)
+{
+    return scan_1d(s, len, a, 0);
+}
+
+static int sita_2d(struct sim *s, int w, int h, struct sim_area *a)
+{
+    return scan_2d(s, w, h, a, 0, 1);
+}
+
+static int sita_1d(struct sim *s, uint32_t len, struct sim_area *a)
+{
+    return scan_1d(s, len, a, 1);
+}
+
+/* returns TRUE if a slot is outside of the container or used */
+static int is_wall(struct sim *s, int x, int y)
+{
+    return x < 0 || y < 0 || x >= CONT_W || y >= CONT_H || s->map[y][x];
+}
+
+/**
+ * Best fit by contact: of the positions that fit with a left or
+ * right side corner against a used slot or container edge, picks
+ * the one whose perimeter touches the most used slots or edges,
+ * preferring the topmost, then leftmost one on ties.
+ *
+ * @param s      Pointer to the simulator
+ * @param w      Width in slots
+ * @param h      Height in slots
+ * @param a      Pointer to where to store the area
+ *
+ * @return 0 on success, non-0 if the block does not fit
+ */
+static int best_2d(struct sim *s, int w, int h, struct sim_area *a)
+{
+    int x, y, c, i, contact, best = -1;
+
+    for (y = 0; y + h <= CONT_H; y++)
+    {
+        for (x = 0; x + w <= CONT_W; x += align)
+        {
+            /* only consider positions with a vertical side against a wall */
+            if (!is_wall(s, x - 1, y) && !is_wall(s, x - 1, y + h - 1) &&
+                !is_wall(s, x + w, y) && !is_wall(s, x + w, y + h - 1)) continue;
+            if ((c = rect_busy(s, x, y, w, h, 0)) >= 0)
+            {
+                x = ROUND_UP_TO2POW(c + 1, align) - align;
+                continue;
+            }
+            contact = 0;
+            for (i = 0; i < w; i++)
+            {
+                contact += is_wall(s, x + i, y - 1) + is_wall(s, x + i, y + h);
+            }
+            for (i = 0; i < h; i++)
+            {
+                contact += is_wall(s, x - 1, y + i) + is_wall(s, x + w, y + i);
+            }
+            if (contact > best)
+            {
+                best = contact;
+                set_2d(a, x, y, w, h);
+                if (contact == 2 * (w + h)) return 0;
+            }
+        }
+    }
+    return best < 0;
+}
+
+/**
+ * Split placement: large blocks are placed from the top right
+ * corner, small blocks from the bottom left corner, so that
+ * small short lived buffers do not fragment the space that
+ * large buffers need.
+ */
+static int split_2d(struct sim *s, int w, int h, struct sim_area *a)
+{
+    return w * h >= SPLIT_SLOTS ? scan_2d(s, w, h, a, 0, 1) :
+                                  scan_2d(s, w, h, a, 1, 0);
+}
+
+static const struct sim_policy policies[] = {
+    { "first", "2D top-down left to right, 1D from the start", first_2d, first_1d },
+    { "sita",  "2D top-down right to left, 1D from the end (as the kernel's SiTA)", sita_2d, sita_1d },
+    { "best",  "2D best contact fit, 1D from the end", best_2d, sita_1d },
+    { "split", "large 2D from top right, small 2D from bottom left, 1D from the end", split_2d, sita_1d },
+    { NULL, NULL, NULL, NULL }
+};
+
+/* marks an area as used or free */
+static void mark(struct sim *s, struct sim_area *a, int used)
+{
+    uint32_t ix;
+    int r;
+
+    if (a->is_1d)
+    {
+        for (ix = a->start; ix < a->start + a->len; ix++) (&s->map[0][0])[ix] = used;
+    }
+    else
+    {
+        for (r = a->y; r < a->y + a->h; r++) memset(&s->map[r][a->x], used, a->w);
+    }
+}
+
+/**
+ * Places the blocks of a buffer.  Already placed blocks are
+ * released if a block does not fit.
+ *
+ * @param s          Pointer to the simulator
+ * @param blocks     Block requests
+ * @param num_blocks Number of blocks
+ * @param areas      Pointer to where to store the areas
+ *
+ * @return 0 on success, non-0 if the buffer does not fit
+ */
+static int place(struct sim *s, struct sim_block *blocks, int num_blocks,
+                 struct sim_area *areas)
+{
+    int ix, ret = 0;
+    for (ix = 0; ix < num_blocks && !ret; ix++)
+    {
+        ret = blocks[ix].is_1d ? s->pol->place_1d(s, blocks[ix].len, areas + ix) :
+                                 s->pol->place_2d(s, blocks[ix].w, blocks[ix].h, areas + ix);
+        if (!ret) mark(s, areas + ix, 1);
+    }
+    if (ret)
+    {
+        for (ix -= 2; ix >= 0; ix--) mark(s, areas + ix, 0);
+    }
+    return ret;
+}
+
+/* returns the live buffer with an id, or NULL */
+static struct sim_buf *find_buf(struct sim *s, uint64_t id)
+{
+    int ix;
+    for (ix = 0; ix < s->num_bufs; ix++)
+    {
+        if (s->bufs[ix].id == id) return s->bufs + ix;
+    }
+    return NULL;
+}
+
+/**
+ * Allocates a buffer in the simulated container.
+ *
+ * @param s      Pointer to the simulator
+ * @param op     Pointer to the operation
+ * @param keep   TRUE to keep the buffer live, FALSE to release
+ *               it right away
+ *
+ * @return 0 on success, non-0 if the buffer did not fit
+ */
+static int sim_alloc(struct sim *s, struct sim_op *op, int keep)
+{
+    struct sim_area areas[MAX_BLOCKS];
+    int ix, ret;
+
+    if (keep && s->num_bufs == s->max_bufs)
+    {
+        struct sim_buf *b = realloc(s->bufs, sizeof(*b) * (s->max_bufs += 64));
+        if (NOT_P(b,!=,NULL)) return 1;
+        s->bufs = b;
+    }
+
+    uint64_t t = BenchLib_Now();
+    ret = place(s, op->blocks, op->num_blocks, areas);
+    BenchLib_AddSample(&s->alloc_ns, BenchLib_Now() - t);
+
+    s->allocs++;
+    if (ret)
+    {
+        s->failed++;
+    }
+    else if (keep)
+    {
+        struct sim_buf *b = s->bufs + s->num_bufs++;
+        b->id = op->id;
+        b->num_areas = op->num_blocks;
+        memcpy(b->areas, areas, sizeof(*areas) * op->num_blocks);
+    }
+    else
+    {
+        for (ix = 0; ix < op->num_blocks; ix++) mark(s, areas + ix, 0);
+    }
+    return ret;
+}
+
+/* frees a live buffer in the simulated container */
+static void sim_free(struct sim *s, struct sim_buf *b)
+{
+    int ix;
+
+    uint64_t t = BenchLib_Now();
+    for (ix = 0; ix < b->num_areas; ix++) mark(s, b->areas + ix, 0);
+    BenchLib_AddSample(&s->free_ns, BenchLib_Now() - t);
+
+    *b = s->bufs[--s->num_bufs];
+}
+
+/**
+ * Returns the area of the largest free rectangle of the
+ * container using the maximal rectangle in histogram method.
+ *
+ * @param s      Pointer to the simulator
+ *
+ * @return area in slots
+ */
+static uint32_t largest_free(struct sim *s)
+{
+    uint16_t hist[CONT_W];
+    int stack[CONT_W], top, x, y;
+    uint32_t best = 0, area;
+
+    memset(hist, 0, sizeof(hist));
+    for (y = 0; y < CONT_H; y++)
+    {
+        for (x = 0; x < CONT_W; x++) hist[x] = s->map[y][x] ? 0 : hist[x] + 1;
+
+        for (top = 0, x = 0; x <= CONT_W; x++)
+        {
+            int hh = x < CONT_W ? hist[x] : 0;
+            while (top && hist[stack[top - 1]] >= hh)
+            {
+                int height = hist[stack[--top]];
+                area = height * (x - (top ? stack[top - 1] + 1 : 0));
+                if (area > best) best = area;
+            }
+            if (x < CONT_W) stack[top++] = x;
+        }
+    }
+    return best;
+}
+
+/* NV12 1080p buffer used to probe whether a stream would still fit */
+static struct sim_block nv12_1080p[2] = {
+    { 0, 30, 17, 0 },   /* 1920x1080 8-bit */
+    { 0, 30,  9, 0 },   /*  960x540 16-bit */
+};
+
+/**
+ * Samples the fragmentation state of the container.
+ *
+ * @param s      Pointer to the simulator
+ * @param col    Plot column
+ */
+static void sample(struct sim *s, int col)
+{
+    struct sim_area areas[2];
+    uint32_t used = 0, ix, largest = largest_free(s);
+
+    for (ix = 0; ix < CONT_SLOTS; ix++) used += (&s->map[0][0])[ix] != 0;
+    double frag = used < CONT_SLOTS ? 1 - (double) largest / (CONT_SLOTS - used) : 0;
+
+    s->samples++;
+    s->frag_sum += frag;
+    if (frag > s->frag_max) s->frag_max = frag;
+    if (largest < s->min_largest) s->min_largest = largest;
+    if (largest < s->plot[col]) s->plot[col] = largest;
+    s->last_largest = largest;
+
+    if (!place(s, nv12_1080p, 2, areas))
+    {
+        s->fits++;
+        mark(s, areas, 0);
+        mark(s, areas + 1, 0);
+    }
+}
+
+/**
+ * Runs a workload through a placement policy.
+ *
+ * @param s         Pointer to the simulator
+ * @param ops       Operations
+ * @param num_ops   Number of operations
+ * @param repeat    Number of times to run the operations.  Buffers
+ *                  live at the end of a pass are freed.
+ * @param interval  Sampling interval in operations
+ */
+static void simulate(struct sim *s, struct sim_op *ops, uint32_t num_ops,
+                     int repeat, uint32_t interval)
+{
+    uint64_t total = (uint64_t) num_ops * repeat, n = 0;
+    struct sim_buf *b;
+    uint32_t ix;
+    int pass;
+
+    s->min_largest = CONT_SLOTS;
+    for (ix = 0; ix < PLOT_COLS; ix++) s->plot[ix] = CONT_SLOTS;
+
+    for (pass = 0; pass < repeat; pass++)
+    {
+        for (ix = 0; ix < num_ops; ix++, n++)
+        {
+            struct sim_op *op = ops + ix;
+            b = op->kind == SIM_PROBE ? NULL : find_buf(s, op->id);
+            if (b && op->kind != SIM_ALLOC) sim_free(s, b);
+            else if (op->kind != SIM_FREE) sim_alloc(s, op, op->kind != SIM_PROBE && !b);
+
+            if (n % interval == 0) sample(s, n * PLOT_COLS / total);
+        }
+        while (s->num_bufs) sim_free(s, s->bufs);
+    }
+}
+
+/* container slot geometry of the 2D pixel formats */
+static const int slot_w[] = { 0, 64, 32, 32 };
+static const int slot_h[] = { 0, 64, 64, 32 };
+
+/* orders ops by time stamp */
+static int cmp_ops(const void *a, const void *b)
+{
+    const struct sim_op *x = (const struct sim_op *) a, *y = (const struct sim_op *) b;
+    return x->ts < y->ts ? -1 : x->ts > y->ts;
+}
+
+/**
+ * Reads the allocs, maps, frees and unmaps of a recorded trace.
+ *
+ * @param path     Path to the trace file
+ * @param ops      Pointer to where to store the op array
+ * @param blocks   Pointer to where to store the block array
+ *
+ * @return number of ops read, or -1 on failure
+ */
+static int read_trace(const char *path, struct sim_op **ops,
+                      struct sim_block **blocks)
+{
+    struct record_header hdr;
+    struct record_entry e;
+    struct record_block rb[MAX_BLOCKS];
+    int num = 0, max = 0, num_blks = 0, max_blks = 0, ix;
+    FILE *fp = fopen(path, "rb");
+
+    *ops = NULL;
+    *blocks = NULL;
+    if (!fp || fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        memcmp(hdr.magic, RECORD_MAGIC, sizeof(hdr.magic)) ||
+        hdr.endian != RECORD_ENDIAN || !hdr.page_size)
+    {
+        fprintf(stderr, "%s is not a trace file of this byte order\n", path);
+        if (fp) fclose(fp);
+        return -1;
+    }
+
+    while (fread(&e, sizeof(e), 1, fp) == 1)
+    {
+        if (e.num_blocks > MAX_BLOCKS ||
+            fread(rb, sizeof(*rb), e.num_blocks, fp) != e.num_blocks)
+        {
+            fprintf(stderr, "%s is truncated\n", path);
+            break;
+        }
+        if (e.op < REC_ALLOC || e.op > REC_UNMAP) continue;
+        if (num == max)
+        {
+            struct sim_op *o = realloc(*ops, sizeof(*o) * (max += 4096));
+            if (NOT_P(o,!=,NULL)) break;
+            *ops = o;
+        }
+        if (num_blks + e.num_blocks > max_blks)
+        {
+            struct sim_block *b = realloc(*blocks, sizeof(*b) * (max_blks += 4096));
+            if (NOT_P(b,!=,NULL)) break;
+            *blocks = b;
+        }
+
+        struct sim_op *op = *ops + num++;
+        op->ts = e.ts;
+        op->id = e.ptr;
+        op->num_blocks = e.num_blocks;
+        /* store block index for now, as the array may move */
+        op->blocks = (struct sim_block *) (uintptr_t) num_blks;
+        if (e.op == REC_FREE || e.op == REC_UNMAP)
+        {
+            op->kind = SIM_FREE;
+            op->num_blocks = 0;
+            if (e.ret) num--;   /* failed frees do not change the container */
+            continue;
+        }
+        op->kind = e.ret ? SIM_ALLOC : SIM_PROBE;
+        for (ix = 0; ix < e.num_blocks; ix++)
+        {
+            struct sim_block *b = *blocks + num_blks++;
+            ZERO(*b);
+            if (rb[ix].fmt == PIXEL_FMT_PAGE || rb[ix].fmt >= sizeof(slot_w) / sizeof(*slot_w))
+            {
+                b->is_1d = 1;
+                b->len = (rb[ix].width + hdr.page_size - 1) / hdr.page_size;
+            }
+            else
+            {
+                b->w = (rb[ix].width + slot_w[rb[ix].fmt] - 1) / slot_w[rb[ix].fmt];
+                b->h = (rb[ix].height + slot_h[rb[ix].fmt] - 1) / slot_h[rb[ix].fmt];
+            }
+        }
+    }
+    fclose(fp);
+
+    for (ix = 0; ix < num; ix++)
+    {
+        (*ops)[ix].blocks = *blocks + (uintptr_t) (*ops)[ix].blocks;
+    }
+    qsort(*ops, num, sizeof(**ops), cmp_ops);
+    return num;
+}
+
+/* returns the next value of an xorshift PRNG */
+static uint32_t star_rand(uint32_t *seed)
+{
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *seed = x;
+}
+
+/**
+ * Generates a synthetic workload with the operation mix of
+ * star_test in memmgr_test: each operation picks a random slot,
+ * and frees its buffer, or if it is empty, allocates a random
+ * 1D or 2D buffer of a random resolution into it.
+ *
+ * @param num_ops    Number of operations
+ * @param num_slots  Number of slots
+ * @param seed       PRNG seed
+ * @param ops        Pointer to where to store the op array
+ * @param blocks     Pointer to where to store the block array
+ *
+ * @return number of ops generated, or -1 on failure
+ */
+static int gen_star(uint32_t num_ops, uint32_t num_slots, uint32_t seed,
+                    struct sim_op **ops, struct sim_block **blocks)
+{
+    uint32_t ix;
+
+    *ops = NEWN(struct sim_op, num_ops);
+    *blocks = NEWN(struct sim_block, num_ops);
+    if (NOT_P(*ops,!=,NULL) || NOT_P(*blocks,!=,NULL)) return -1;
+
+    for (ix = 0; ix < num_ops; ix++)
+    {
+        struct sim_op *op = *ops + ix;
+        struct sim_block *b = *blocks + ix;
+        uint32_t r = star_rand(&seed), width = 64, height = 64, fmt;
+
+        op->id = star_rand(&seed) % num_slots;
+        op->kind = SIM_TOGGLE;
+        op->num_blocks = 1;
+        op->blocks = b;
+
+        switch ("AAAABBBBCCCDDEEF"[r & 15]) {
+        case 'F': width = 1920; height = 1080; break;
+        case 'E': width = 1280; height = 720; break;
+        case 'D': width = 640; height = 480; break;
+        case 'C': width = 848; height = 480; break;
+        case 'B': width = 176; height = 144; break;
+        }
+        /* maps and 1D allocs both take 1D slots */
+        fmt = "AAABBBBCCCCDDDDE"[(r >> 4) & 15] - 'A';
+        if (fmt < 2)
+        {
+            b->is_1d = 1;
+            b->len = (width * height + TILER_PAGE - 1) / TILER_PAGE;
+        }
+        else
+        {
+            fmt -= 1;
+            b->w = (width + slot_w[fmt] - 1) / slot_w[fmt];
+            b->h = (height + slot_h[fmt] - 1) / slot_h[fmt];
+        }
+    }
+    return num_ops;
+}
+
+/* prints the minimum largest free rectangle over time for a policy */
+static void plot(struct sim *s)
+{
+    static const char levels[] = " .:-=+*#%@";
+    char line[PLOT_COLS + 1];
+    int ix;
+
+    for (ix = 0; ix < PLOT_COLS; ix++)
+    {
+        line[ix] = levels[s->plot[ix] * (sizeof(levels) - 2) / CONT_SLOTS];
+    }
+    line[PLOT_COLS] = '\0';
+    printf("%-6s |%s| min %u\n", s->pol->name, line, s->min_largest);
+}
+
+static void usage(const char *prog)
+{
+    int ix;
+    fprintf(stderr, "Usage: %s [options] <trace>\n"
+            "       %s [options] -s <ops>[,<slots>[,<seed>]]\n"
+            "   -p:      comma separated list of placement policies (default: all)\n"
+            "   -a:      2D block alignment in slots (power of 2, default: 1)\n"
+            "   -i:      sampling interval in operations (default: %d)\n"
+            "   -r:      run the trace this many times\n"
+            "   -s:      run a synthetic star_test workload (default: %d,%d)\n"
+            "   -o:      write JSON report into file (- for stdout)\n"
+            "Policies:\n", prog, prog, DEF_INTERVAL, STAR_OPS, STAR_SLOTS);
+    for (ix = 0; policies[ix].name; ix++)
+    {
+        fprintf(stderr, "   %-8s %s\n", policies[ix].name, policies[ix].desc);
+    }
+    fflush(stderr);
+}
+
+/**
+ * Main simulator function.  Builds the workload, runs it through
+ * each selected placement policy and reports the allocation
+ * failure rate, fragmentation, largest free rectangle and the
+ * CPU cost of the operations.
+ *
+ * @param argc   Number of arguments
+ * @param argv   Arguments
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int main(int argc, char **argv)
+{
+    const char *json = NULL, *sel = NULL, *star = NULL;
+    uint32_t interval = DEF_INTERVAL, ops_n = STAR_OPS, slots_n = STAR_SLOTS, seed = STAR_SEED;
+    struct sim_op *ops = NULL;
+    struct sim_block *blocks = NULL;
+    int repeat = 1, arg, num, ix, ret = 0;
+    char name[64];
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-' && arg + 1 < argc; arg += 2)
+    {
+        if (!strcmp(argv[arg], "-p")) sel = argv[arg + 1];
+        else if (!strcmp(argv[arg], "-a")) align = atoi(argv[arg + 1]);
+        else if (!strcmp(argv[arg], "-i")) interval = atoi(argv[arg + 1]);
+        else if (!strcmp(argv[arg], "-r")) repeat = atoi(argv[arg + 1]);
+        else if (!strcmp(argv[arg], "-s")) star = argv[arg + 1];
+        else if (!strcmp(argv[arg], "-o")) json = argv[arg + 1];
+        else break;
+    }
+    if (arg + !star != argc || align < 1 || align > CONT_W || (align & (align - 1)) ||
+        !interval || repeat < 1 ||
+        (star && (sscanf(star, "%u,%u,%u", &ops_n, &slots_n, &seed) < 1 || !slots_n)))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    num = star ? gen_star(ops_n, slots_n, seed, &ops, &blocks) :
+                 read_trace(argv[arg], &ops, &blocks);
+    if (num < 0)
+    {
+        FREE(ops);
+        FREE(blocks);
+        return 1;
+    }
+    if (star) printf("star workload: %u ops on %u slots, seed 0x%x\n", ops_n, slots_n, seed);
+    else printf("trace %s: %d allocs/frees x %d\n", argv[arg], num, repeat);
+    printf("container: %dx%d slots, 2D alignment %d\n\n", CONT_W, CONT_H, align);
+
+    struct sim *s = NEW(struct sim);
+    struct sim *runs = NEWN(struct sim, sizeof(policies) / sizeof(*policies));
+    int num_runs = 0;
+    if (NOT_P(s,!=,NULL) || NOT_P(runs,!=,NULL)) ret = 1;
+
+    for (ix = 0; policies[ix].name && !ret; ix++)
+    {
+        if (sel && !strstr(sel, policies[ix].name)) continue;
+
+        ZERO(*s);
+        s->pol = policies + ix;
+        if (BenchLib_InitSamples(&s->alloc_ns, num * repeat) ||
+            BenchLib_InitSamples(&s->free_ns, num * repeat))
+        {
+            ret = 1;
+        }
+        else
+        {
+            uint64_t t = BenchLib_Now();
+            simulate(s, ops, num, repeat, interval);
+            uint64_t elapsed = BenchLib_Now() - t;
+
+            sprintf(name, "%s alloc", s->pol->name);
+            BenchLib_Result *r = BenchLib_Report("sim", name, 1, &s->alloc_ns, elapsed);
+            BenchLib_AddMetric(r, "fail_rate_pct", s->allocs ? 100.0 * s->failed / s->allocs : 0);
+            BenchLib_AddMetric(r, "frag_avg_pct", s->samples ? 100 * s->frag_sum / s->samples : 0);
+            BenchLib_AddMetric(r, "frag_max_pct", 100 * s->frag_max);
+            BenchLib_AddMetric(r, "min_largest_free", s->min_largest);
+            BenchLib_AddMetric(r, "fit_1080p_pct", s->samples ? 100.0 * s->fits / s->samples : 0);
+            sprintf(name, "%s free", s->pol->name);
+            BenchLib_Report("sim", name, 1, &s->free_ns, elapsed);
+            printf("\n");
+            runs[num_runs++] = *s;
+        }
+        BenchLib_FreeSamples(&s->alloc_ns);
+        BenchLib_FreeSamples(&s->free_ns);
+        FREE(s->bufs);
+    }
+
+    if (num_runs)
+    {
+        printf("largest free rectangle over time (0 to %d slots)\n", CONT_SLOTS);
+        for (ix = 0; ix < num_runs; ix++) plot(runs + ix);
+    }
+
+    if (!ret && json) ret = BenchLib_WriteReport(json, argv[0], "sim");
+
+    FREE(runs);
+    FREE(s);
+    FREE(ops);
+    FREE(blocks);
+    return ret;
+}
@@ -37,6 +37,7 @@
 #ifndef _TILERMEM_UTILS_H_
 #define _TILERMEM_UTILS_H_
 
+#include "mem_types.h"
 #include <tiler.h>
 
 #define TILER_PAGE_WIDTH   64
@@ -48,4 +49,210 @@
 
 #define PAGE_SIZE           TILER_PAGE
 
+/*
+ * Address translation between system space addresses (SSPtr) and
+ * tiler container coordinates.  Each container is a TILER_LENGTH
+ * sized range of system space starting at TILER_MEM_<fmt>.  2D
+ * containers are addressed as rows of TILER_STRIDE_<fmt> bytes,
+ * and the page mode container as rows of PAGE_SIZE bytes.
+ * Coordinates are in pixels (bytes for the page mode container).
+ *
+ * As the container strides are powers of 2, translation is done
+ * with shifts and masks.  The batched forms have no branches in
+ * their loops, so that compilers can vectorize them.
+ *
+ * NOTE: these work on tiler addresses.  When emulating the tiler,
+ * system space addresses are virtual addresses, and do not
+ * belong to any container.
+ */
+
+/**
+ * Returns the tiler format of a system space address, based on
+ * its container.
+ *
+ * @param ssptr  System space address
+ *
+ * @return The tiler format, TILFMT_NONE for non-tiler addresses,
+ *         or TILFMT_INVALID for 0.
+ */
+static __inline__ enum tiler_fmt TilerMem_GetFmt(SSPtr ssptr)
+{
+    return (ssptr == 0              ? TILFMT_INVALID :
+            ssptr < TILER_MEM_8BIT  ? TILFMT_NONE :
+            ssptr < TILER_MEM_16BIT ? TILFMT_8BIT :
+            ssptr < TILER_MEM_32BIT ? TILFMT_16BIT :
+            ssptr < TILER_MEM_PAGED ? TILFMT_32BIT :
+            ssptr < TILER_MEM_END   ? TILFMT_PAGE : TILFMT_NONE);
+}
+
+/**
+ * Returns the log2 of the container stride of a tiler format.
+ *
+ * @param fmt    Tiler format
+ *
+ * @return log2 of TILER_STRIDE_<fmt> (or of PAGE_SIZE), or 0 for
+ *         non-tiler formats.
+ */
+static __inline__ uint32_t TilerMem_StrideShift(enum tiler_fmt fmt)
+{
+    return fmt == TILFMT_8BIT ? 14 :
+           fmt == TILFMT_16BIT || fmt == TILFMT_32BIT ? 15 :
+           fmt == TILFMT_PAGE ? 12 : 0;
+}
+
+/**
+ * Returns the log2 of the bytes per pixel of a tiler format.
+ *
+ * @param fmt    Tiler format
+ *
+ * @return log2 of the bytes per pixel (0 for page mode and
+ *         non-tiler formats).
+ */
+static __inline__ uint32_t TilerMem_BppShift(enum tiler_fmt fmt)
+{
+    return fmt == TILFMT_16BIT ? 1 : fmt == TILFMT_32BIT ? 2 : 0;
+}
+
+/**
+ * Returns the start of the container of a tiler format.
+ *
+ * @param fmt    Tiler format
+ *
+ * @return The system space address of the container, or 0 for
+ *         non-tiler formats.
+ */
+static __inline__ SSPtr TilerMem_ContainerBase(enum tiler_fmt fmt)
+{
+    return fmt >= TILFMT_8BIT && fmt <= TILFMT_PAGE ?
+           TILER_MEM_8BIT + (SSPtr) (fmt - TILFMT_8BIT) * TILER_LENGTH : 0;
+}
+
+/**
+ * Decodes a system space address into container coordinates.
+ *
+ * @param ssptr  System space address
+ * @param x      Pointer to where to store the column
+ * @param y      Pointer to where to store the row
+ *
+ * @return The tiler format of the address.  x and y are only set
+ *         for tiler addresses (TILFMT_8BIT..TILFMT_PAGE).
+ */
+static __inline__ enum tiler_fmt TilerMem_SSPtrToXY(SSPtr ssptr, pixels_t *x,
+                                                    pixels_t *y)
+{
+    enum tiler_fmt fmt = TilerMem_GetFmt(ssptr);
+    if (fmt >= TILFMT_8BIT && fmt <= TILFMT_PAGE)
+    {
+        uint32_t shift = TilerMem_StrideShift(fmt);
+        uint32_t offs = ssptr & (TILER_LENGTH - 1);
+        *x = (pixels_t) ((offs & ((1u << shift) - 1)) >>
+                         TilerMem_BppShift(fmt));
+        *y = (pixels_t) (offs >> shift);
+    }
+    return fmt;
+}
+
+/**
+ * Encodes container coordinates into a system space address.
+ *
+ * @param fmt    Tiler format of the container
+ * @param x      Column
+ * @param y      Row
+ *
+ * @return The system space address, or 0 if fmt is not a tiler
+ *         format or (x, y) is outside the container.
+ */
+static __inline__ SSPtr TilerMem_XYToSSPtr(enum tiler_fmt fmt, pixels_t x,
+                                          pixels_t y)
+{
+    uint32_t shift = TilerMem_StrideShift(fmt), bpp = TilerMem_BppShift(fmt);
+    if (!shift || ((uint32_t) x << bpp) >> shift ||
+        (uint32_t) y >= (uint32_t) TILER_LENGTH >> shift)
+        return 0;
+    return TilerMem_ContainerBase(fmt) + ((uint32_t) y << shift) +
+           ((uint32_t) x << bpp);
+}
+
+/**
+ * Returns the system space address of each row of a rectangle,
+ * e.g. for building DMA descriptors of a (sub-)block.
+ *
+ * @param ssptr   System space address of the top-left pixel of
+ *                the rectangle
+ * @param height  Number of rows
+ * @param rows    Array of height elements where to store the
+ *                address of each row
+ *
+ * @return 0 on success, non-0 if ssptr is not a tiler address or
+ *         the rectangle extends beyond the container.  rows is
+ *         not set on failure.
+ */
+static __inline__ int TilerMem_RectRows(SSPtr ssptr, pixels_t height,
+                                        SSPtr *rows)
+{
+    pixels_t x, y;
+    enum tiler_fmt fmt = TilerMem_SSPtrToXY(ssptr, &x, &y);
+    uint32_t shift = TilerMem_StrideShift(fmt), ix;
+    if (!shift || (uint32_t) y + height > (uint32_t) TILER_LENGTH >> shift)
+        return 1;
+    for (ix = 0; ix < height; ix++)
+    {
+        rows[ix] = ssptr + (ix << shift);
+    }
+    return 0;
+}
+
+/**
+ * Decodes an array of system space addresses in the same
+ * container into container coordinates.  This is the batched
+ * form of TilerMem_SSPtrToXY().
+ *
+ * @param fmt     Tiler format of the container
+ * @param ssptrs  Array of n system space addresses
+ * @param x       Array of n elements where to store the columns
+ * @param y       Array of n elements where to store the rows
+ * @param n       Number of addresses
+ */
+static __inline__ void TilerMem_SSPtrsToXY(enum tiler_fmt fmt,
+                                           const SSPtr *ssptrs, pixels_t *x,
+                                           pixels_t *y, uint32_t n)
+{
+    uint32_t shift = TilerMem_StrideShift(fmt), bpp = TilerMem_BppShift(fmt);
+    uint32_t mask = (1u << shift) - 1, ix;
+    for (ix = 0; ix < n; ix++)
+    {
+        uint32_t offs = ssptrs[ix] & (TILER_LENGTH - 1);
+        x[ix] = (pixels_t) ((offs & mask) >> bpp);
+        y[ix] = (pixels_t) (offs >> shift);
+    }
+}
+
+/**
+ * Encodes arrays of container coordinates into system space
+ * addresses.  This is the batched form of TilerMem_XYToSSPtr(),
+ * except that the coordinates are not checked: they must be
+ * inside the container.
+ *
+ * @param fmt     Tiler format of the container
+ * @param x       Array of n columns
+ * @param y       Array of n rows
+ * @param ssptrs  Array of n elements where to store the
+ *                addresses
+ * @param n       Number of addresses
+ */
+static __inline__ void TilerMem_XYToSSPtrs(enum tiler_fmt fmt,
+                                           const pixels_t *x,
+                                           const pixels_t *y, SSPtr *ssptrs,
+                                           uint32_t n)
+{
+    uint32_t shift = TilerMem_StrideShift(fmt), bpp = TilerMem_BppShift(fmt);
+    SSPtr base = TilerMem_ContainerBase(fmt);
+    uint32_t ix;
+    for (ix = 0; ix < n; ix++)
+    {
+        ssptrs[ix] = base + ((uint32_t) y[ix] << shift) +
+                     ((uint32_t) x[ix] << bpp);
+    }
+}
+
 #endif
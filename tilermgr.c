@@ -33,6 +33,9 @@
  *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -42,8 +45,26 @@
 #include <errno.h>
 #include <sys/ioctl.h>
 #include <tiler.h>
+
+#define PROBE_PROVIDER tilermgr
+
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
 #include "tilermgr.h"
 #include "mem_types.h"
+#include "probe_utils.h"
+
+#ifdef HAVE_PROBES
+/* probe semaphores, set while a tracer is attached */
+PROBE_SEMAPHORE(alloc);
+PROBE_SEMAPHORE(free);
+PROBE_SEMAPHORE(map);
+PROBE_SEMAPHORE(unmap);
+PROBE_SEMAPHORE(pagemode_alloc);
+PROBE_SEMAPHORE(pagemode_free);
+PROBE_SEMAPHORE(ioctl);
+#endif
 
 
 #define TILERMGR_ERROR() \
@@ -53,6 +74,21 @@
 
 static int fd;
 
+/* issues a tiler driver call, and reports its result and latency */
+static int tilermgr_ioctl(unsigned long cmd, unsigned long arg)
+{
+#ifdef HAVE_PROBES
+    if (PROBE_ENABLED(ioctl))
+    {
+        uint64_t start = PROBE_NOW();
+        int ret = ioctl(fd, cmd, arg);
+        PROBE4(ioctl, cmd, arg, ret, PROBE_NOW() - start);
+        return ret;
+    }
+#endif
+    return ioctl(fd, cmd, arg);
+}
+
 int TilerMgr_Close()
 {
     close(fd);
@@ -86,11 +122,12 @@ SSPtr TilerMgr_Alloc(enum pixel_fmt_t pixfmt, pixels_t width, pixels_t height)
     block.dim.area.width = width;
     block.dim.area.height = height;
 
-    ret = ioctl(fd, TILIOC_GBUF, (unsigned long)(&block));
+    ret = tilermgr_ioctl(TILIOC_GBUF, (unsigned long)(&block));
     if (ret < 0) {
         TILERMGR_ERROR();
         return 0x0;
     }
+    PROBE4(alloc, block.ssptr, pixfmt, width, height);
     return block.ssptr;
 }
 
@@ -104,11 +141,12 @@ int TilerMgr_Free(SSPtr addr)
 
     block.ssptr = addr;
 
-    ret = ioctl(fd, TILIOC_FBUF, (unsigned long)(&block));
+    ret = tilermgr_ioctl(TILIOC_FBUF, (unsigned long)(&block));
     if (ret < 0) {
         TILERMGR_ERROR();
         return TILERMGR_ERR_GENERIC;
     }
+    PROBE1(free, addr);
     return TILERMGR_ERR_NONE;
 }
 
@@ -123,11 +161,12 @@ SSPtr TilerMgr_PageModeAlloc(bytes_t len)
     block.fmt = TILFMT_PAGE;
     block.dim.len = len;
 
-    ret = ioctl(fd, TILIOC_GBUF, (unsigned long)(&block));
+    ret = tilermgr_ioctl(TILIOC_GBUF, (unsigned long)(&block));
     if (ret < 0) {
         TILERMGR_ERROR();
         return 0x0;
     }
+    PROBE2(pagemode_alloc, block.ssptr, len);
     return block.ssptr;
 }
 
@@ -141,11 +180,12 @@ int TilerMgr_PageModeFree(SSPtr addr)
 
     block.ssptr = addr;
 
-    ret = ioctl(fd, TILIOC_FBUF, (unsigned long)(&block));
+    ret = tilermgr_ioctl(TILIOC_FBUF, (unsigned long)(&block));
     if (ret < 0) {
         TILERMGR_ERROR();
         return TILERMGR_ERR_GENERIC;
     }
+    PROBE1(pagemode_free, addr);
     return TILERMGR_ERR_NONE;
 }
 
@@ -158,7 +198,7 @@ SSPtr TilerMgr_VirtToPhys(void *ptr)
         return 0x0;
 
     tmp = (unsigned long)ptr;
-    ret = ioctl(fd, TILIOC_GSSP, tmp);
+    ret = tilermgr_ioctl(TILIOC_GSSP, tmp);
 
     return (SSPtr)ret;
 }
@@ -175,11 +215,12 @@ SSPtr TilerMgr_Map(void *ptr, bytes_t len)
     block.dim.len = len;
     block.ptr = ptr;
 
-    ret = ioctl(fd, TILIOC_MBUF, (unsigned long)(&block));
+    ret = tilermgr_ioctl(TILIOC_MBUF, (unsigned long)(&block));
     if (ret < 0) {
         TILERMGR_ERROR();
         return 0x0;
     }
+    PROBE3(map, block.ssptr, ptr, len);
     return block.ssptr;
 }
 
@@ -193,10 +234,11 @@ int TilerMgr_Unmap(SSPtr addr)
 
     block.ssptr = addr;
 
-    ret = ioctl(fd, TILIOC_UMBUF, (unsigned long)(&block));
+    ret = tilermgr_ioctl(TILIOC_UMBUF, (unsigned long)(&block));
     if (ret < 0) {
         TILERMGR_ERROR();
         return TILERMGR_ERR_GENERIC;
     }
+    PROBE1(unmap, addr);
     return TILERMGR_ERR_NONE;
 }
@@ -0,0 +1,466 @@
+/*
+ *  trace.c
+ *
+ *  Runtime switchable trace facility.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* for syscall() */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "utils.h"
+#include "list_utils.h"
+#include "trace_utils.h"
+
+#define TRACE_MAGIC   "TMTRACE1"
+#define TRACE_ENDIAN  0x01020304
+
+/* trace record as saved in the ring */
+struct trace_rec {
+    uint64_t    ts;       /* monotonic time stamp in ns */
+    const char *fmt;      /* format string */
+    uint32_t    tid;      /* thread id */
+    uint16_t    cat;      /* category */
+    uint8_t     nargs;    /* number of arguments saved */
+    uint8_t     smask;    /* bit N is set iff args[N] is a string */
+    uint64_t    args[TRACE_MAX_ARGS];
+};
+
+/* trace record as saved in the trace file */
+struct trace_file_rec {
+    uint64_t    ts;
+    uint32_t    tid;
+    uint16_t    cat;
+    uint8_t     nargs;
+    uint8_t     smask;
+    uint32_t    fmt;      /* string id of format string */
+    uint32_t    reserved;
+    uint64_t    args[TRACE_MAX_ARGS];  /* string id for string arguments */
+};
+
+/* trace ring list info */
+struct trace_list {
+    struct trace_ring *me;
+    struct trace_list *next, *last;
+};
+
+/* per-thread ring buffer.  Only the owner thread writes into a ring. */
+struct trace_ring {
+    struct trace_rec   recs[TRACE_RING_SIZE];
+    volatile uint32_t  head;   /* number of records ever written */
+    int                used;   /* whether ring is owned by a live thread */
+    struct trace_list  link;
+};
+
+typedef struct trace_ring trace_ring;
+
+uint32_t __internal__Trace_Mask = TRACE_DEFAULT;
+
+static struct trace_list rings;
+static pthread_mutex_t ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t ring_key;
+static const char *dump_path = NULL;
+
+/**
+ * Releases the ring of an exiting thread.  The ring is kept
+ * with its content, and is reused by the next new thread.
+ *
+ * @param ptr    Pointer to the ring
+ */
+static void release_ring(void *ptr)
+{
+    pthread_mutex_lock(&ring_mutex);
+    ((trace_ring *) ptr)->used = 0;
+    pthread_mutex_unlock(&ring_mutex);
+}
+
+/**
+ * Returns the ring of the current thread.  On the first call in
+ * a thread, it claims a released ring or allocates a new one.
+ *
+ * @return pointer to the ring, or NULL on memory allocation
+ *         failure.
+ */
+static trace_ring *get_ring()
+{
+    trace_ring *ring = (trace_ring *) pthread_getspecific(ring_key);
+    if (ring) return ring;
+
+    pthread_mutex_lock(&ring_mutex);
+    DLIST_MLOOP(rings, ring, link) {
+        if (!ring->used) break;
+    }
+    if (!ring && (ring = NEW(trace_ring)) != NULL)
+    {
+        DLIST_MADD_BEFORE(rings, ring, link);
+    }
+    if (ring)
+    {
+        ring->used = 1;
+        pthread_setspecific(ring_key, ring);
+    }
+    pthread_mutex_unlock(&ring_mutex);
+    return ring;
+}
+
+static uint64_t now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * Saves the arguments of a trace point into a record.  The
+ * format string is scanned to determine the type of each
+ * argument.
+ *
+ * @param rec    Pointer to the record
+ * @param ap     Argument list
+ */
+static void save_args(struct trace_rec *rec, va_list ap)
+{
+    const char *p = rec->fmt;
+    rec->nargs = rec->smask = 0;
+
+    while ((p = strchr(p, '%')) && rec->nargs < TRACE_MAX_ARGS)
+    {
+        int longs = 0;
+        uint64_t *arg;
+
+        /* skip flags, width and precision */
+        for (p++; *p && strchr("-+ #0123456789.*", *p); p++)
+        {
+            if (*p != '*') continue;
+            rec->args[rec->nargs++] = va_arg(ap, int);
+            if (rec->nargs == TRACE_MAX_ARGS) return;
+        }
+        for (; *p == 'l' || *p == 'h' || *p == 'z'; p++)
+        {
+            longs += *p == 'l';
+        }
+
+        arg = rec->args + rec->nargs;
+        switch (*p)
+        {
+        case '%':
+            p++;
+            continue;
+        case 'd': case 'i': case 'c':
+            *arg = longs > 1 ? (uint64_t) va_arg(ap, long long) :
+                   longs ? (uint64_t) va_arg(ap, long) :
+                   (uint64_t) va_arg(ap, int);
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            *arg = longs > 1 ? (uint64_t) va_arg(ap, unsigned long long) :
+                   longs ? (uint64_t) va_arg(ap, unsigned long) :
+                   (uint64_t) va_arg(ap, unsigned);
+            break;
+        case 'p':
+            *arg = (uint64_t) (uintptr_t) va_arg(ap, void *);
+            break;
+        case 's':
+            *arg = (uint64_t) (uintptr_t) va_arg(ap, const char *);
+            rec->smask |= 1 << rec->nargs;
+            break;
+        case 'e': case 'f': case 'g': case 'E': case 'G':
+        {
+            double d = va_arg(ap, double);
+            memcpy(arg, &d, sizeof(*arg));
+            break;
+        }
+        default:
+            /* unknown conversion: we cannot tell the argument size */
+            return;
+        }
+        rec->nargs++;
+        p++;
+    }
+}
+
+void __internal__Trace_Log(uint32_t cat, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (__internal__Trace_Mask & TRACE_ECHO)
+    {
+        va_start(ap, fmt);
+        vfprintf(stdout, fmt, ap);
+        va_end(ap);
+        fputc('\n', stdout);
+        fflush(stdout);
+    }
+
+    if (__internal__Trace_Mask & TRACE_RING)
+    {
+        trace_ring *ring = get_ring();
+        if (!ring) return;
+
+        struct trace_rec *rec = ring->recs + (ring->head & (TRACE_RING_SIZE - 1));
+        rec->ts = now();
+        rec->fmt = fmt;
+        rec->tid = (uint32_t) syscall(SYS_gettid);
+        rec->cat = (uint16_t) cat;
+        va_start(ap, fmt);
+        save_args(rec, ap);
+        va_end(ap);
+
+        /* publish record */
+        __sync_synchronize();
+        ring->head++;
+    }
+}
+
+uint32_t Trace_SetMask(uint32_t mask)
+{
+    uint32_t old = __internal__Trace_Mask;
+    __internal__Trace_Mask = mask;
+    return old;
+}
+
+uint32_t Trace_GetMask()
+{
+    return __internal__Trace_Mask;
+}
+
+/* string table used while dumping */
+struct str_table {
+    const char **strs;
+    uint32_t num, max;
+};
+
+/**
+ * Returns the id of a string in the string table.  Adds the
+ * string to the table if it is not yet there.  Strings are
+ * identified by their address.
+ *
+ * @param tab    Pointer to the string table
+ * @param str    String
+ *
+ * @return string id, or ~0 on memory allocation failure.
+ */
+static uint32_t str_id(struct str_table *tab, const char *str)
+{
+    uint32_t ix;
+    if (!str) str = "(null)";
+    for (ix = 0; ix < tab->num; ix++)
+    {
+        if (tab->strs[ix] == str) return ix;
+    }
+    if (tab->num == tab->max)
+    {
+        const char **strs = realloc(tab->strs, sizeof(*strs) * (tab->max + 256));
+        if (!strs) return ~0;
+        tab->strs = strs;
+        tab->max += 256;
+    }
+    tab->strs[tab->num] = str;
+    return tab->num++;
+}
+
+/**
+ * Copies the valid records of a ring into the output array,
+ * converting them into the file format.
+ *
+ * @param ring   Pointer to the ring
+ * @param tmp    Temporary buffer of TRACE_RING_SIZE records
+ * @param out    Pointer to the output records
+ * @param tab    Pointer to the string table
+ *
+ * @return number of records copied, or -1 on memory allocation
+ *         failure.
+ */
+static int dump_ring(trace_ring *ring, struct trace_rec *tmp,
+                     struct trace_file_rec *out, struct str_table *tab)
+{
+    uint32_t head, first, ix, i;
+    int num = 0;
+
+    head = ring->head;
+    __sync_synchronize();
+    first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    for (ix = first; ix < head; ix++)
+    {
+        tmp[ix - first] = ring->recs[ix & (TRACE_RING_SIZE - 1)];
+    }
+    __sync_synchronize();
+
+    /* skip records that the owner thread overwrote meanwhile, including
+       the slot it may be writing now */
+    ix = ring->head;
+    ix = ix >= TRACE_RING_SIZE ? ix - TRACE_RING_SIZE + 1 : 0;
+    if (ix < first) ix = first;
+    for (; ix < head; ix++, num++)
+    {
+        struct trace_rec *rec = tmp + ix - first;
+        ZERO(out[num]);
+        out[num].ts = rec->ts;
+        out[num].tid = rec->tid;
+        out[num].cat = rec->cat;
+        out[num].nargs = rec->nargs;
+        out[num].smask = rec->smask;
+        out[num].fmt = str_id(tab, rec->fmt);
+        if (out[num].fmt == ~0u) return -1;
+        for (i = 0; i < rec->nargs; i++)
+        {
+            if (rec->smask & (1 << i))
+            {
+                out[num].args[i] = str_id(tab, (const char *) (uintptr_t) rec->args[i]);
+                if (out[num].args[i] == ~0u) return -1;
+            }
+            else
+            {
+                out[num].args[i] = rec->args[i];
+            }
+        }
+    }
+    return num;
+}
+
+int Trace_Dump(const char *path)
+{
+    struct str_table tab;
+    struct trace_file_rec *out = NULL;
+    struct trace_rec *tmp = NULL;
+    uint32_t num_recs = 0, ix, hdr[3];
+    trace_ring *ring;
+    int ret = 1, n = 0;
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return ret;
+    ZERO(tab);
+
+    pthread_mutex_lock(&ring_mutex);
+
+    /* gather records from all rings */
+    DLIST_MLOOP(rings, ring, link) { n++; }
+    ALLOCN(out, n * TRACE_RING_SIZE + 1);
+    ALLOCN(tmp, TRACE_RING_SIZE);
+    if (!out || !tmp) goto DONE;
+
+    DLIST_MLOOP(rings, ring, link) {
+        n = dump_ring(ring, tmp, out + num_recs, &tab);
+        if (n < 0) goto DONE;
+        num_recs += n;
+    }
+
+    /* write header, string table and records */
+    hdr[0] = TRACE_ENDIAN;
+    hdr[1] = tab.num;
+    hdr[2] = num_recs;
+    ret = fwrite(TRACE_MAGIC, 8, 1, fp) != 1 ||
+          fwrite(hdr, sizeof(hdr), 1, fp) != 1;
+    for (ix = 0; !ret && ix < tab.num; ix++)
+    {
+        uint32_t len = strlen(tab.strs[ix]);
+        ret = fwrite(&len, sizeof(len), 1, fp) != 1 ||
+              (len && fwrite(tab.strs[ix], len, 1, fp) != 1);
+    }
+    if (!ret && num_recs)
+    {
+        ret = fwrite(out, sizeof(*out), num_recs, fp) != num_recs;
+    }
+
+DONE:
+    pthread_mutex_unlock(&ring_mutex);
+    FREE(tmp);
+    FREE(out);
+    FREE(tab.strs);
+    if (fclose(fp)) ret = 1;
+    return ret;
+}
+
+static void dump_at_exit()
+{
+    Trace_Dump(dump_path);
+}
+
+/**
+ * Parses a trace mask specification: a number, or a comma
+ * separated list of category and output names.
+ *
+ * @param spec   Trace mask specification
+ *
+ * @return trace mask
+ */
+static uint32_t parse_mask(const char *spec)
+{
+    static const struct { const char *name; uint32_t mask; } names[] = {
+        { "flow", TRACE_FLOW }, { "print", TRACE_PRINT },
+        { "assert", TRACE_ASSERT }, { "all", TRACE_ALL },
+        { "echo", TRACE_ECHO }, { "ring", TRACE_RING },
+        { "default", TRACE_DEFAULT },
+    };
+    uint32_t mask = 0, ix;
+    char *end;
+
+    mask = strtoul(spec, &end, 0);
+    if (end != spec && !*end) return mask;
+
+    for (mask = 0; *spec; spec += *spec == ',')
+    {
+        size_t len = strcspn(spec, ",");
+        for (ix = 0; ix < sizeof(names) / sizeof(*names); ix++)
+        {
+            if (strlen(names[ix].name) == len &&
+                !strncmp(spec, names[ix].name, len))
+            {
+                mask |= names[ix].mask;
+            }
+        }
+        spec += len;
+    }
+    return mask;
+}
+
+/* sets up tracing when the library is loaded */
+static void __attribute__((constructor)) trace_init()
+{
+    const char *spec = getenv("MEMMGR_TRACE");
+
+    DLIST_INIT(rings);
+    pthread_key_create(&ring_key, release_ring);
+
+    if (spec) __internal__Trace_Mask = parse_mask(spec);
+
+    dump_path = getenv("MEMMGR_TRACE_FILE");
+    if (dump_path && *dump_path) atexit(dump_at_exit);
+}
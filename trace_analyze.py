@@ -0,0 +1,337 @@
+# Use this script to analyze MemMgr allocation traces and to size buffer
+# recycling pools.  You can use either Python 2.6 or 3.1
+#
+# Allocation traces are recorded by the library if the MEMMGR_RECORD
+# environment variable is set, or between MemMgr_StartRecording() and
+# MemMgr_StopRecording() calls, e.g.
+#
+#     MEMMGR_RECORD=camera.rec app
+#
+# Usage:
+#     python trace_analyze.py [options] camera.rec
+#
+# Options:
+#     -e <percent>     recommend pool caps that eliminate this percentage of
+#                      the driver calls (default: 90)
+#     -p <config>      simulate a pool configuration (can be repeated).  A
+#                      configuration is a comma separated list of
+#                      <layout>=<cap>[:<size>] items, where layout is a layout
+#                      number from the report (e.g. L2) or "all", cap is the
+#                      number of freed buffers kept in the pool, and size is
+#                      the number of buffers preallocated at start
+#     -w <width>       width of the occupancy plot (default: 64)
+#
+# A pool of a layout keeps up to cap freed buffers of that layout instead of
+# freeing them, and satisfies allocations of the same layout from the kept
+# buffers.  A pool hit saves the driver alloc call, and a kept buffer saves
+# the driver free call.  Buffers still pooled at the end are counted as freed.
+
+import sys, struct, getopt
+
+PAGE_FMT = 4
+BITS = { 1: 8, 2: 16, 3: 32 }
+# container slot geometry for each 2D format (each slot is one 4KB page)
+SLOT = { 1: (64, 64), 2: (32, 64), 3: (32, 32) }
+CONTAINER_SLOTS = 256 * 128
+OPS = { 1: 'alloc', 2: 'free', 3: 'map', 4: 'unmap' }
+
+def usage():
+    print('usage: python trace_analyze.py [-e percent] [-p config]... '
+          '[-w width] file')
+    sys.exit(1)
+
+def read_trace(path):
+    """Returns the page size and the calls of a trace file ordered by time.
+
+    Each call is a (ts, op, ptr, ret, dur_ns, tid, blocks) tuple, where blocks
+    is a tuple of (fmt, width, height, stride) tuples."""
+    data = open(path, 'rb').read()
+    if data[:8] != b'TMREC001':
+        print('%s is not a MemMgr allocation trace' % path)
+        sys.exit(1)
+
+    # determine byte order
+    for endian in '<>':
+        marker, page_size = struct.unpack_from(endian + 'II', data, 8)
+        if marker == 0x01020304:
+            break
+    else:
+        print('%s has an unknown byte order' % path)
+        sys.exit(1)
+
+    ent_fmt, blk_fmt = endian + 'QQQIIHHI', endian + 'IIII'
+    ent_size, blk_size = struct.calcsize(ent_fmt), struct.calcsize(blk_fmt)
+    ofs, calls = 16, []
+    while ofs + ent_size <= len(data):
+        ts, ptr, ret, dur, tid, op, num_blocks, _ = \
+            struct.unpack_from(ent_fmt, data, ofs)
+        ofs += ent_size
+        if ofs + num_blocks * blk_size > len(data):
+            print('%s is truncated' % path)
+            break
+        blocks = tuple([struct.unpack_from(blk_fmt, data, ofs + i * blk_size)
+                        for i in range(num_blocks)])
+        ofs += num_blocks * blk_size
+        calls.append((ts, op, ptr, ret, dur, tid, blocks))
+    calls.sort(key=lambda c: c[0])
+    return page_size, calls
+
+def layout_key(blocks):
+    """Returns the layout of a buffer.  Strides are not part of the layout,
+    as they are set by the allocator."""
+    return tuple([(b[0], b[1], b[2]) for b in blocks])
+
+def layout_name(key):
+    """Returns a layout in tiler_ptest notation."""
+    out = []
+    for fmt, w, h in key:
+        if fmt == PAGE_FMT:
+            out.append('%d' % w)
+        else:
+            out.append('%d*%d*%d' % (w, h, BITS.get(fmt, 0)))
+    return ','.join(out)
+
+def slots(key, page_size):
+    """Returns the number of container slots used by a layout."""
+    n = 0
+    for fmt, w, h in key:
+        if fmt == PAGE_FMT:
+            n += (w + page_size - 1) // page_size
+        elif fmt in SLOT:
+            sw, sh = SLOT[fmt]
+            n += ((w + sw - 1) // sw) * ((h + sh - 1) // sh)
+    return n
+
+def percentile(vals, p):
+    if not vals:
+        return 0
+    return vals[min(len(vals) - 1, int(len(vals) * p / 100.0))]
+
+def fmt_ns(ns):
+    for unit, div in (('s', 1e9), ('ms', 1e6), ('us', 1e3)):
+        if ns >= div:
+            return '%.1f%s' % (ns / div, unit)
+    return '%dns' % ns
+
+class Layout:
+    def __init__(self, key, page_size):
+        self.key, self.name = key, layout_name(key)
+        self.slots = slots(key, page_size)
+        self.allocs = self.frees = self.maps = 0
+        self.live = self.peak = 0
+        self.lifetimes = []
+        self.events = []    # +1 for allocs, -1 for frees, in time order
+
+def analyze(page_size, calls):
+    """Tracks the buffers of a trace.  Returns the layouts in order of
+    frequency, the container occupancy over time as (ts, slots) pairs, and
+    the number of successful driver calls."""
+    layouts, live, occupancy = {}, {}, []
+    used = driver_calls = 0
+    for ts, op, ptr, ret, dur, tid, blocks in calls:
+        if op in (1, 3) and ret:
+            key = layout_key(blocks)
+            l = layouts.get(key)
+            if not l:
+                l = layouts[key] = Layout(key, page_size)
+            if op == 1:
+                l.allocs += 1
+                l.events.append(1)
+            else:
+                l.maps += 1
+            l.live += 1
+            l.peak = max(l.peak, l.live)
+            live[ptr] = (l, ts, op)
+            used += l.slots
+        elif op in (2, 4) and not ret and ptr in live:
+            l, start, aop = live.pop(ptr)
+            l.live -= 1
+            l.lifetimes.append(ts - start)
+            if aop == 1:
+                l.frees += 1
+                l.events.append(-1)
+            used -= l.slots
+        else:
+            continue
+        driver_calls += 1
+        occupancy.append((ts, used))
+    layouts = list(layouts.values())
+    layouts.sort(key=lambda l: (-(l.allocs + l.maps), l.name))
+    for l in layouts:
+        l.lifetimes.sort()
+    return layouts, occupancy, driver_calls
+
+def simulate(l, cap, size=0):
+    """Simulates a pool for the allocations of a layout.  Returns the number
+    of pool hits and the number of driver calls saved."""
+    pooled, hits, kept = min(size, cap), 0, 0
+    for ev in l.events:
+        if ev > 0:
+            if pooled:
+                pooled -= 1
+                hits += 1
+        elif pooled < cap:
+            pooled += 1
+            kept += 1
+    # preallocated and finally pooled buffers still need driver calls
+    saved = hits + kept - min(size, cap) - pooled
+    return hits, max(saved, 0)
+
+def recommend(layouts, driver_calls, percent):
+    """Greedily raises the pool caps that save the most driver calls per
+    container slot until percent of the driver calls are saved.  Returns the
+    caps and the number of calls saved."""
+    caps = dict([(l.key, 0) for l in layouts])
+    saved = dict([(l.key, 0) for l in layouts])
+    target = driver_calls * percent / 100.0
+    total = 0
+    while total < target:
+        best = None
+        for l in layouts:
+            if caps[l.key] >= l.peak:
+                continue
+            gain = simulate(l, caps[l.key] + 1)[1] - saved[l.key]
+            score = float(gain) / max(l.slots, 1)
+            if gain > 0 and (not best or score > best[0]):
+                best = (score, l, gain)
+        if not best:
+            break
+        score, l, gain = best
+        caps[l.key] += 1
+        saved[l.key] += gain
+        total += gain
+    return caps, total
+
+def parse_config(spec, layouts):
+    caps = {}
+    for item in spec.split(','):
+        try:
+            name, val = item.split('=')
+            cap, size = (val.split(':') + ['0'])[:2]
+            cap, size = int(cap), int(size)
+        except ValueError:
+            usage()
+        if name == 'all':
+            for l in layouts:
+                caps[l.key] = (cap, size)
+        elif name.startswith('L') and name[1:].isdigit() and \
+             0 < int(name[1:]) <= len(layouts):
+            caps[layouts[int(name[1:]) - 1].key] = (cap, size)
+        else:
+            print('unknown layout %s' % name)
+            sys.exit(1)
+    return caps
+
+def print_layouts(layouts):
+    print('Layouts by frequency:')
+    print('%-4s %-28s %6s %6s %6s %5s %9s %9s %9s' %
+          ('', 'layout', 'slots', 'allocs', 'maps', 'peak',
+           'life p50', 'life p90', 'life max'))
+    for i, l in enumerate(layouts):
+        lt = l.lifetimes
+        print('L%-3d %-28s %6d %6d %6d %5d %9s %9s %9s' %
+              (i + 1, l.name, l.slots, l.allocs, l.maps, l.peak,
+               fmt_ns(percentile(lt, 50)), fmt_ns(percentile(lt, 90)),
+               lt and fmt_ns(lt[-1]) or '-'))
+
+def print_lifetimes(layouts):
+    # log10 histogram of all buffer lifetimes
+    buckets = [0] * 11
+    for l in layouts:
+        for t in l.lifetimes:
+            b = 0
+            while t >= 10 and b < 10:
+                t //= 10
+                b += 1
+            buckets[b] += 1
+    total = sum(buckets)
+    if not total:
+        return
+    print('\nBuffer lifetimes:')
+    for b in range(len(buckets)):
+        if buckets[b]:
+            print('  < %-7s %6d %s' % (fmt_ns(10 ** (b + 1)), buckets[b],
+                                      '#' * (50 * buckets[b] // total)))
+
+def print_occupancy(occupancy, width):
+    if not occupancy:
+        return
+    start, end = occupancy[0][0], occupancy[-1][0]
+    peak = max([u for t, u in occupancy])
+    # time weighted average
+    area = 0
+    for i in range(1, len(occupancy)):
+        area += occupancy[i - 1][1] * (occupancy[i][0] - occupancy[i - 1][0])
+    avg = end > start and float(area) / (end - start) or occupancy[-1][1]
+    print('\nContainer occupancy: peak %d slots (%.1f%%), average %.1f slots '
+          '(%.1f%%) over %s' % (peak, 100.0 * peak / CONTAINER_SLOTS, avg,
+                                100.0 * avg / CONTAINER_SLOTS,
+                                fmt_ns(end - start)))
+    # maximum occupancy in each time column
+    cols = [0] * width
+    for t, u in occupancy:
+        c = end > start and (t - start) * (width - 1) // (end - start) or 0
+        cols[c] = max(cols[c], u)
+    for c in range(1, width):
+        if not cols[c] and cols[c - 1]:
+            cols[c] = cols[c - 1]
+    rows = 8
+    for r in range(rows, 0, -1):
+        line = ''.join([c * rows >= r * peak and '#' or ' ' for c in cols])
+        print('%6d |%s' % (peak * r // rows, line))
+    print('       +%s' % ('-' * width))
+
+def print_pools(layouts, caps, driver_calls, title):
+    print('\n%s:' % title)
+    print('%-4s %-28s %5s %5s %8s %7s %7s' %
+          ('', 'layout', 'cap', 'size', 'hit rate', 'saved', 'slots'))
+    total = held = 0
+    for i, l in enumerate(layouts):
+        cap, size = caps.get(l.key, (0, 0))
+        if not cap:
+            continue
+        hits, saved = simulate(l, cap, size)
+        total += saved
+        held += cap * l.slots
+        print('L%-3d %-28s %5d %5d %7.1f%% %7d %7d' %
+              (i + 1, l.name, cap, size,
+               l.allocs and 100.0 * hits / l.allocs or 0, saved,
+               cap * l.slots))
+    print('eliminates %d of %d driver calls (%.1f%%), holding up to %d '
+          'container slots' % (total, driver_calls,
+                               driver_calls and 100.0 * total / driver_calls,
+                               held))
+
+try:
+    opts, files = getopt.getopt(sys.argv[1:], 'e:p:w:')
+except getopt.GetoptError:
+    usage()
+if len(files) != 1:
+    usage()
+
+percent, configs, width = 90.0, [], 64
+for opt, val in opts:
+    if opt == '-e':
+        percent = float(val)
+    elif opt == '-p':
+        configs.append(val)
+    elif opt == '-w':
+        width = max(int(val), 8)
+
+page_size, calls = read_trace(files[0])
+layouts, occupancy, driver_calls = analyze(page_size, calls)
+print('%d calls, %d successful alloc/free/map/unmap driver calls, '
+      '%d layouts\n' % (len(calls), driver_calls, len(layouts)))
+print_layouts(layouts)
+print_lifetimes(layouts)
+print_occupancy(occupancy, width)
+
+caps, saved = recommend(layouts, driver_calls, percent)
+print_pools(layouts, dict([(k, (c, 0)) for k, c in caps.items()]),
+            driver_calls, 'Recommended pools for %g%% fewer driver calls' %
+            percent)
+if driver_calls and saved < driver_calls * percent / 100.0:
+    print('(%g%% is not reachable by pooling allocations)' % percent)
+for spec in configs:
+    print_pools(layouts, parse_config(spec, layouts), driver_calls,
+                'Simulated pools %s' % spec)
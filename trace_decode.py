@@ -0,0 +1,131 @@
+# Use this script to decode MemMgr trace files.  You can use either Python 2.6
+# or 3.1
+#
+# Trace files are written by Trace_Dump(), or at exit if the MEMMGR_TRACE_FILE
+# environment variable is set, e.g.
+#
+#     MEMMGR_TRACE=ring,flow,print,assert MEMMGR_TRACE_FILE=memmgr.trc app
+#
+# Usage:
+#     python trace_decode.py [options] memmgr.trc
+#
+# Options:
+#     -c <categories>  only show these categories (comma separated list of
+#                      flow, print, assert, or a number)
+#     -t <tids>        only show these threads (comma separated list)
+#     -r               show time stamps relative to the first record
+
+import sys, re, struct, getopt
+
+CATEGORIES = { 'flow': 0x1, 'print': 0x2, 'assert': 0x4, 'all': 0xff }
+CAT_NAMES = { 0x1: 'F', 0x2: 'P', 0x4: 'A' }
+MAX_ARGS = 8
+
+def usage():
+    print('usage: python trace_decode.py [-c categories] [-t tids] [-r] file')
+    sys.exit(1)
+
+def read_trace(path):
+    """Returns the string table and the records of a trace file."""
+    data = open(path, 'rb').read()
+    if data[:8] != b'TMTRACE1':
+        print('%s is not a MemMgr trace file' % path)
+        sys.exit(1)
+
+    # determine byte order
+    for endian in '<>':
+        marker, num_strs, num_recs = struct.unpack_from(endian + 'III', data, 8)
+        if marker == 0x01020304:
+            break
+    else:
+        print('%s has an unknown byte order' % path)
+        sys.exit(1)
+
+    ofs, strs = 20, []
+    for i in range(num_strs):
+        length, = struct.unpack_from(endian + 'I', data, ofs)
+        strs.append(data[ofs + 4:ofs + 4 + length].decode('latin-1'))
+        ofs += 4 + length
+
+    rec_fmt = endian + 'QIHBBII%dQ' % MAX_ARGS
+    rec_size = struct.calcsize(rec_fmt)
+    recs = []
+    for i in range(num_recs):
+        f = struct.unpack_from(rec_fmt, data, ofs + i * rec_size)
+        ts, tid, cat, nargs, smask, fmt = f[:6]
+        args = list(f[7:7 + nargs])
+        for a in range(nargs):
+            if smask & (1 << a):
+                args[a] = strs[args[a]]
+        recs.append((ts, tid, cat, strs[fmt], args))
+    return recs
+
+def convert(fmt, args):
+    """Formats a record using its C format string."""
+    out, a = [], 0
+    for piece in re.split('(%[-+ #0-9.*]*[lhz]*[a-zA-Z%])', fmt):
+        m = re.match('%([-+ #0-9.*]*)[lhz]*([a-zA-Z%])$', piece)
+        if not m:
+            out.append(piece)
+            continue
+        flags, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        n = flags.count('*') + 1
+        vals = args[a:a + n]
+        a += n
+        if len(vals) < n:
+            out.append(piece)
+            continue
+        if conv == 'p':
+            flags, conv = '#' + flags, 'x'
+        elif conv in 'diouxXc':
+            # sign extend saved signed values
+            if conv in 'di' and vals[-1] >= 1 << 63:
+                vals[-1] -= 1 << 64
+        elif conv in 'eEfgG':
+            vals[-1] = struct.unpack('d', struct.pack('Q', vals[-1]))[0]
+        try:
+            out.append(('%' + flags + conv) % tuple(vals))
+        except (TypeError, ValueError, OverflowError):
+            out.append(piece)
+    return ''.join(out)
+
+def parse_cats(spec):
+    try:
+        return int(spec, 0)
+    except ValueError:
+        mask = 0
+        for name in spec.split(','):
+            if name not in CATEGORIES:
+                usage()
+            mask |= CATEGORIES[name]
+        return mask
+
+try:
+    opts, files = getopt.getopt(sys.argv[1:], 'c:t:r')
+except getopt.GetoptError:
+    usage()
+if len(files) != 1:
+    usage()
+
+cats, tids, relative = 0xff, None, False
+for opt, val in opts:
+    if opt == '-c':
+        cats = parse_cats(val)
+    elif opt == '-t':
+        tids = [int(t) for t in val.split(',')]
+    elif opt == '-r':
+        relative = True
+
+recs = read_trace(files[0])
+recs.sort(key=lambda r: r[0])
+start = recs and relative and recs[0][0] or 0
+
+for ts, tid, cat, fmt, args in recs:
+    if not cat & cats or (tids and tid not in tids):
+        continue
+    ts -= start
+    print('%6d.%09d %5d %s %s' % (ts // 1000000000, ts % 1000000000, tid,
+                                  CAT_NAMES.get(cat, '?'), convert(fmt, args)))
@@ -0,0 +1,120 @@
+/*
+ *  trace_utils.h
+ *
+ *  Runtime switchable trace definitions.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TRACE_UTILS_H_
+#define _TRACE_UTILS_H_
+
+#include <stdint.h>
+
+/**
+ * The trace facility replaces the synchronous stdout printing of the debug
+ * macros if __DEBUG_TRACE__ is defined before including debug_utils.h.  Each
+ * trace point belongs to a category, and costs a single branch on the
+ * global trace mask while its category is disabled.
+ *
+ * Enabled trace points can be echoed to stdout (TRACE_ECHO), which is what
+ * __DEBUG__ builds do, and/or recorded in binary form into a per-thread
+ * ring buffer (TRACE_RING).  Recording takes no locks and does no
+ * formatting: only the format string pointer, the time stamp and the raw
+ * arguments are saved.  The rings are written to a file by Trace_Dump(),
+ * and the file is decoded offline by trace_decode.py.
+ *
+ * The mask can be set by Trace_SetMask(), or at load time using the
+ * MEMMGR_TRACE environment variable, which is a number, or a comma separated
+ * list of category and output names, e.g.
+ *
+ *    MEMMGR_TRACE=ring,flow,assert MEMMGR_TRACE_FILE=/data/memmgr.trc app
+ *
+ * If MEMMGR_TRACE_FILE is set, the rings are dumped into it at exit.
+ *
+ * :NOTE: %s arguments are saved as pointers and are only dereferenced by
+ * Trace_Dump, so they must point to string literals (e.g. __FUNCTION__).
+ */
+
+/* categories */
+#define TRACE_FLOW    0x0001  /* function entry and exit: IN, OUT, RET, R_* */
+#define TRACE_PRINT   0x0002  /* debug prints: P, DP */
+#define TRACE_ASSERT  0x0004  /* failed assertions: A_*, CHK_*, NOT_* */
+#define TRACE_ALL     0x00FF
+
+/* outputs */
+#define TRACE_ECHO    0x0100  /* print trace points on stdout */
+#define TRACE_RING    0x0200  /* record trace points in the per-thread ring */
+
+/* same output as a __DEBUG__ and __DEBUG_ASSERT__ build */
+#define TRACE_DEFAULT (TRACE_PRINT | TRACE_ASSERT | TRACE_ECHO)
+
+/* number of records kept for each thread (must be a power of 2) */
+#define TRACE_RING_SIZE 4096
+
+/* maximum number of arguments saved for a trace point */
+#define TRACE_MAX_ARGS  8
+
+/* returns TRUE (non-0) iff trace points of a category are enabled */
+#define TRACE_ON(cat) (__internal__Trace_Mask & (cat))
+
+/* internal variables and function prototypes */
+extern uint32_t __internal__Trace_Mask;
+extern void __internal__Trace_Log(uint32_t cat, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Sets the trace mask: the enabled categories and outputs.
+ *
+ * @param mask   Bitwise OR of TRACE_* values
+ *
+ * @return the previous trace mask
+ */
+uint32_t Trace_SetMask(uint32_t mask);
+
+/**
+ * Returns the current trace mask.
+ *
+ * @return Bitwise OR of TRACE_* values
+ */
+uint32_t Trace_GetMask();
+
+/**
+ * Writes the content of all trace rings into a binary trace
+ * file.  Records that are being overwritten while the rings are
+ * dumped are skipped.  The rings are not cleared.
+ *
+ * @param path   Path to the trace file
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int Trace_Dump(const char *path);
+
+#endif